@@ -28,18 +28,16 @@ AT3File::~AT3File() {
 
 void AT3File::load(const std::string &filename, Archive &archive) {
 	filename_ = filename;
-	data_ = archive.read(filename);
+	input_ = archive.openStream(filename);
 
-	avData_ = (unsigned char *)av_malloc(data_.size());
-	dataOffset_ = 0;
-	dataRemaining_ = static_cast<uint32_t>(data_.size());
+	avData_ = (unsigned char *)av_malloc(AvioBufferSize);
 
 	format_ = avformat_alloc_context();
 	if (!format_) {
 		throw std::runtime_error("Cannot allocate format context.");
 	}
 
-	avio_ = avio_alloc_context(avData_, static_cast<int>(data_.size()), 0, (void *)this, &AT3File::readBuffer, NULL, NULL);
+	avio_ = avio_alloc_context(avData_, AvioBufferSize, 0, (void *)this, &AT3File::readBuffer, NULL, &AT3File::seekBuffer);
 	if (!avio_) {
 		throw std::runtime_error("Cannot allocate AVIO context.");
 	}
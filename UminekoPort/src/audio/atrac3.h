@@ -1,8 +1,11 @@
 #pragma once
 
+#include <iostream>
 #include <string>
 #include <vector>
 
+#include "../data/archivestream.h"
+
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavformat/avformat.h>
@@ -43,26 +46,62 @@ public:
 private:
 	friend class AudioManager;
 
+	static constexpr int AvioBufferSize = 32 * 1024;
+
+	// Both callbacks are called from inside FFmpeg's C frames, which an exception must not unwind through, so read
+	// errors from the stream are reported to FFmpeg as EIO instead.
 	static int readBuffer(void *opaque, uint8_t *buf, int bufSize) {
 		AT3File *at3 = (AT3File *)opaque;
 
-		bufSize = FFMIN(bufSize, static_cast<int>(at3->dataRemaining_));
-		if (!bufSize) {
-			return AVERROR_EOF;
+		try {
+			auto bytesRead = at3->input_.read(buf, bufSize);
+			if (!bytesRead) {
+				return AVERROR_EOF;
+			}
+
+			return static_cast<int>(bytesRead);
+		} catch (const std::exception &e) {
+			std::cerr << "Reading '" << at3->filename_ << "' failed: " << e.what() << "\n";
+			return AVERROR(EIO);
 		}
+	}
 
-		memcpy(buf, at3->data_.data() + at3->dataOffset_, bufSize);
-		at3->dataOffset_ += bufSize;
-		at3->dataRemaining_ -= bufSize;
+	static int64_t seekBuffer(void *opaque, int64_t offset, int whence) {
+		AT3File *at3 = (AT3File *)opaque;
 
-		return bufSize;
+		try {
+			int64_t position;
+			switch (whence & ~AVSEEK_FORCE) {
+			case AVSEEK_SIZE:
+				return static_cast<int64_t>(at3->input_.size());
+			case SEEK_SET:
+				position = offset;
+				break;
+			case SEEK_CUR:
+				position = static_cast<int64_t>(at3->input_.tell()) + offset;
+				break;
+			case SEEK_END:
+				position = static_cast<int64_t>(at3->input_.size()) + offset;
+				break;
+			default:
+				return AVERROR(EINVAL);
+			}
+			if (position < 0 || static_cast<uint64_t>(position) > at3->input_.size()) {
+				return AVERROR(EINVAL);
+			}
+
+			at3->input_.seek(static_cast<uint64_t>(position));
+			return position;
+		} catch (const std::exception &e) {
+			std::cerr << "Seeking in '" << at3->filename_ << "' failed: " << e.what() << "\n";
+			return AVERROR(EIO);
+		}
 	}
 
 	std::string filename_;
 	unsigned char *avData_;
-	uint32_t dataOffset_ = 0, dataRemaining_ = 0;
 
-	std::vector<unsigned char> data_;
+	ArchiveStream input_;
 
 	int channels_ = 0;
 	int sampleRate_ = 0;
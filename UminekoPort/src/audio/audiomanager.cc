@@ -1,5 +1,6 @@
 #include "audiomanager.h"
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -8,6 +9,7 @@
 
 #include "audiostream.h"
 #include "atrac3.h"
+#include "../engine/savestate.h"
 
 AudioManager::AudioManager(Archive &archive) : log_(Log::create("audio")), archive_(archive) {
 	bgm_ = std::make_unique<AudioStream>();
@@ -15,6 +17,7 @@ AudioManager::AudioManager(Archive &archive) : log_(Log::create("audio")), archi
 	voice_ = std::make_unique<AudioStream>();
 	voice_->manager_ = this;
 	ses_.resize(0x20);
+	playingSes_.resize(ses_.size());
 	for (auto &se : ses_) {
 		se = std::make_unique<AudioStream>();
 		se->manager_ = this;
@@ -111,10 +114,12 @@ void AudioManager::playBGM(const std::string &filename, float volume) {
 
 	bgm_->setVolume(volume);
 	bgm_->play();
+	playingBgm_ = { filename, volume };
 }
 
 void AudioManager::stopBGM(int frames) {
 	bgm_->fadeOut(frames / 60.0);
+	playingBgm_ = PlayingStream();
 }
 
 void AudioManager::playSE(int channel, const std::string &filename, float volume) {
@@ -126,10 +131,12 @@ void AudioManager::playSE(int channel, const std::string &filename, float volume
 
 	ses_[channel]->setVolume(volume);
 	ses_[channel]->play();
+	playingSes_[channel] = { filename, volume };
 }
 
 void AudioManager::stopSE(int channel, int frames) {
 	ses_[channel]->fadeOut(frames / 60.0);
+	playingSes_[channel] = PlayingStream();
 }
 
 void AudioManager::stopAllSE(int frames) {
@@ -137,6 +144,7 @@ void AudioManager::stopAllSE(int frames) {
 	for (auto &se : ses_) {
 		se->fadeOut(time);
 	}
+	std::fill(playingSes_.begin(), playingSes_.end(), PlayingStream());
 }
 
 void AudioManager::playVoice(const std::string &filename) {
@@ -147,4 +155,38 @@ void AudioManager::playVoice(const std::string &filename) {
 	voice_->load(at3file);
 	voice_->setVolume(1.0f);
 	voice_->play();
+}
+
+void AudioManager::saveState(BinaryWriter &writer) const {
+	writer.writeString(playingBgm_.filename);
+	writer.write(playingBgm_.volume);
+	writer.write(static_cast<uint32_t>(playingSes_.size()));
+	for (const auto &se : playingSes_) {
+		writer.writeString(se.filename);
+		writer.write(se.volume);
+	}
+}
+
+void AudioManager::restoreState(BinaryReader &br) {
+	PlayingStream bgm;
+	bgm.filename = br.readString(br.read<uint32_t>());
+	bgm.volume = br.read<float>();
+	std::vector<PlayingStream> ses(readSaveCount(br, sizeof(uint32_t) + sizeof(float)));
+	for (auto &se : ses) {
+		se.filename = br.readString(br.read<uint32_t>());
+		se.volume = br.read<float>();
+	}
+
+	if (!bgm.filename.empty()) {
+		playBGM(bgm.filename, bgm.volume);
+	} else {
+		stopBGM(0);
+	}
+	for (int channel = 0; channel < static_cast<int>(std::min(ses.size(), ses_.size())); ++channel) {
+		if (!ses[channel].filename.empty()) {
+			playSE(channel, ses[channel].filename, ses[channel].volume);
+		} else {
+			stopSE(channel, 0);
+		}
+	}
 }
\ No newline at end of file
@@ -1,16 +1,20 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include <vector>
 
+#include "../util/binaryreader.h"
+#include "../util/binarywriter.h"
 #include "../util/log.h"
+#include "audiosink.h"
 
 struct SoundIo;
 struct SoundIoDevice;
 
 class Archive;
 
-class AudioManager {
+class AudioManager : public AudioSink {
 public:
 	AudioManager(Archive &archive);
 	~AudioManager();
@@ -18,17 +22,26 @@ public:
 	void drawDebug();
 
 	void setBGMVolume(float volume);
-	void setSEVolume(int channel, float volume);
+	void setSEVolume(int channel, float volume) override;
 
-	void playBGM(const std::string &filename, float volume);
-	void stopBGM(int frames);
+	void playBGM(const std::string &filename, float volume) override;
+	void stopBGM(int frames) override;
 
-	void playSE(int channel, const std::string &filename, float volume);
-	void stopSE(int channel, int frames);
-	void stopAllSE(int frames);
+	void playSE(int channel, const std::string &filename, float volume) override;
+	void stopSE(int channel, int frames) override;
+	void stopAllSE(int frames) override;
 
 	void playVoice(const std::string &filename);
+
+	// The BGM and sound effects the script started and has not stopped yet. Restoring starts them again from the top.
+	void saveState(BinaryWriter &writer) const override;
+	void restoreState(BinaryReader &br) override;
 private:
+	struct PlayingStream {
+		std::string filename;
+		float volume = 0;
+	};
+
 	friend class AT3File;
 	friend class AudioStream;
 
@@ -39,6 +52,9 @@ private:
 	std::unique_ptr<AudioStream> bgm_;
 	std::unique_ptr<AudioStream> voice_;
 	std::vector<std::unique_ptr<AudioStream>> ses_;
+	// Empty filenames for streams that are not playing.
+	PlayingStream playingBgm_;
+	std::vector<PlayingStream> playingSes_;
 
 	SoundIo *soundio_;
 	SoundIoDevice *device_;
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+
+#include "../util/binaryreader.h"
+#include "../util/binarywriter.h"
+
+// What the script plays sound through. AudioManager outputs it; the headless runner only keeps count.
+class AudioSink {
+public:
+	virtual ~AudioSink() = default;
+
+	virtual void setSEVolume(int channel, float volume) = 0;
+
+	virtual void playBGM(const std::string &filename, float volume) = 0;
+	virtual void stopBGM(int frames) = 0;
+
+	virtual void playSE(int channel, const std::string &filename, float volume) = 0;
+	virtual void stopSE(int channel, int frames) = 0;
+	virtual void stopAllSE(int frames) = 0;
+
+	virtual void saveState(BinaryWriter &writer) const = 0;
+	virtual void restoreState(BinaryReader &br) = 0;
+};
\ No newline at end of file
@@ -1,30 +1,162 @@
 #include "archive.h"
 
+#include <filesystem>
 #include <iostream>
 #include <iomanip>
 #include <sstream>
 
 #include "compression.h"
+#include "pixelops.h"
+#include "../math/clock.h"
 #include "../util/binaryreader.h"
 #include "../util/string.h"
 
 #include "../stb/stb_image.h"
 #include "../stb/stb_image_write.h"
 
-void Archive::open(const std::string &path) {
-	ifs_.open(path, std::ios_base::binary);
-	BinaryReader br(ifs_);
-	if (br.readString(4) != "ROM ") {
+void Archive::open(const std::string &path, ArchiveBackend backend) {
+	backend_ = backend;
+	if (backend_ == ArchiveBackend::Mapped) {
+		try {
+			map_.open(path);
+		} catch (const std::exception &e) {
+			std::cerr << e.what() << " Falling back to stream reads.\n";
+			backend_ = ArchiveBackend::Stream;
+		}
+	}
+
+	Clock clock;
+	if (backend_ == ArchiveBackend::Stream) {
+		file_.open(path);
+	}
+
+	char signature[4] = {};
+	if (backend_ == ArchiveBackend::Mapped) {
+		memcpy(signature, map_.view(0, sizeof(signature)).data(), sizeof(signature));
+	} else {
+		file_.readAt(0, signature, sizeof(signature));
+	}
+	if (std::string(signature, sizeof(signature)) != "ROM ") {
 		throw std::runtime_error("Archive signature does not match the expected 'ROM '.");
 	}
 
-	scan(0x10, root_, br);
+	root_ = ArchiveEntry();
+	treeBuilt_ = false;
+
+	// The scanned directory tree is cached next to the ROM and mapped back in on later runs.
+	auto key = indexKey(path);
+	romKey_ = key;
+	auto indexPath = path + ".idx";
+	bool warm = index_.load(indexPath, key);
+	if (!warm) {
+		index_.clear();
+		scan(0x10, "");
+		index_.build();
+		try {
+			index_.save(indexPath, key);
+		} catch (const std::exception &e) {
+			std::cerr << e.what() << "\n";
+		}
+	}
+
+	std::cout << "Opened archive '" << path << "' with " << index_.count() << " files in " << clock.reset() * 1000.0 << " ms (" << (warm ? "warm, cached index" : "cold, scanned directory tables") << ").\n";
+}
+
+ArchiveIndexKey Archive::indexKey(const std::string &path) {
+	// Hashing the start of the ROM catches repacks that keep the size and timestamp; the root directory table lives
+	// there.
+	const uint64_t hashedSize = 0x10000;
+
+	ArchiveIndexKey key;
+	key.romModified = fileModifiedTime(path);
+	key.romSize = backend_ == ArchiveBackend::Mapped ? map_.size() : file_.size();
+
+	auto size = static_cast<size_t>(std::min(hashedSize, key.romSize));
+	std::vector<unsigned char> header;
+	const unsigned char *data;
+	if (backend_ == ArchiveBackend::Mapped) {
+		data = map_.data();
+	} else {
+		header.resize(size);
+		file_.readAt(0, header.data(), size);
+		data = header.data();
+	}
+
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= data[i];
+		hash *= 1099511628211ull;
+	}
+	key.headerHash = hash;
+	return key;
 }
 
 void Archive::explore() {
+	if (!treeBuilt_) {
+		buildTree();
+	}
 	explore(root_);
 }
 
+void Archive::buildTree() {
+	std::vector<ArchiveHandle> handles(index_.count());
+	for (uint32_t i = 0; i < handles.size(); ++i) {
+		handles[i].index = i;
+	}
+	std::sort(handles.begin(), handles.end(), [this](ArchiveHandle a, ArchiveHandle b) {
+		return index_.path(a) < index_.path(b);
+	});
+
+	// Children are collected before being added so each children vector is sized once and the parent pointers handed
+	// out to grandchildren stay valid.
+	static void (*fill)(Archive &, ArchiveEntry &, const ArchiveHandle *, const ArchiveHandle *) = [](Archive &archive, ArchiveEntry &folder, const ArchiveHandle *begin, const ArchiveHandle *end) {
+		struct Child {
+			std::string_view name;
+			const ArchiveHandle *begin, *end;
+			bool isFolder;
+		};
+		std::vector<Child> children;
+		auto prefix = folder.path.size();
+		for (auto iter = begin; iter != end;) {
+			auto rest = archive.index_.path(*iter).substr(prefix);
+			auto slash = rest.find('/');
+			if (slash == std::string_view::npos) {
+				children.push_back({ rest, iter, iter + 1, false });
+				++iter;
+				continue;
+			}
+			auto name = rest.substr(0, slash + 1);
+			auto last = iter + 1;
+			while (last != end && archive.index_.path(*last).substr(prefix, name.size()) == name) {
+				++last;
+			}
+			children.push_back({ name.substr(0, slash), iter, last, true });
+			iter = last;
+		}
+
+		folder.children.reserve(children.size());
+		for (const auto &child : children) {
+			auto &entry = folder.children.emplace_back();
+			entry.parent = &folder;
+			entry.name = child.name;
+			entry.isFolder = child.isFolder;
+			folder.childrenNames.insert({ entry.name, static_cast<int>(folder.children.size() - 1) });
+			if (child.isFolder) {
+				entry.path = folder.path + entry.name + "/";
+				fill(archive, entry, child.begin, child.end);
+			} else {
+				entry.path = archive.index_.path(*child.begin);
+				entry.offset = archive.index_.offset(*child.begin);
+				entry.size = archive.index_.size(*child.begin);
+			}
+		}
+	};
+
+	root_ = ArchiveEntry();
+	fill(*this, root_, handles.data(), handles.data() + handles.size());
+	treeBuilt_ = true;
+}
+
 void Archive::explore(ArchiveEntry &folder) {
 	static void (*cascade)(ArchiveEntry &) = [](ArchiveEntry &current) {
 		if (current.parent) {
@@ -82,133 +214,361 @@ void Archive::explore(ArchiveEntry &folder) {
 					extractMsk(child.path);
 				} else {
 					std::ofstream ofs("export/" + child.name, std::ios_base::binary);
-					BinaryReader br(ifs_);
-					br.seekg(child.offset);
-					char *data = new char[child.size];
-					br.read(data, child.size);
-					ofs.write(data, child.size);
+					auto data = fetch(resolve(child.path));
+					ofs.write((const char *)data.data(), data.size());
 					ofs.close();
-					delete[] data;
 				}
 			} else {
 				std::ofstream ofs(child.name, std::ios_base::binary);
-				BinaryReader br(ifs_);
-				br.seekg(child.offset);
-				char *data = new char[child.size];
-				br.read(data, child.size);
-				ofs.write(data, child.size);
+				auto data = fetch(resolve(child.path));
+				ofs.write((const char *)data.data(), data.size());
 				ofs.close();
-				delete[] data;
 			}
 		}
 	}
 	explore(folder);
 }
 
+ArchiveHandle Archive::resolve(const std::string &path) const {
+	auto handle = find(path);
+	if (!handle.valid()) {
+		throw std::runtime_error("File '" + path + "' not found in archive.");
+	}
+	return handle;
+}
+
+bool Archive::exists(const std::string &path) const {
+	return find(path).valid();
+}
+
+ArchiveHandle Archive::find(std::string_view path) const {
+	auto handle = overlay_.find(path);
+	if (handle.valid()) {
+		handle.index += static_cast<uint32_t>(index_.count());
+		return handle;
+	}
+	return index_.find(path);
+}
+
+std::string_view Archive::entryPath(ArchiveHandle handle) const {
+	return isOverlay(handle) ? overlay_.path(overlayHandle(handle)) : index_.path(handle);
+}
+
+std::string_view Archive::entryName(ArchiveHandle handle) const {
+	return isOverlay(handle) ? overlay_.name(overlayHandle(handle)) : index_.name(handle);
+}
+
+void Archive::addOverlay(const std::string &directory) {
+	Clock clock;
+	overlay_.add(directory);
+	dropCachedAssets();
+	std::cout << "Added overlay '" << directory << "', " << overlay_.count() << " overlay files in " << clock.reset() * 1000.0 << " ms.\n";
+}
+
+void Archive::clearOverlays() {
+	overlay_.clear();
+	dropCachedAssets();
+}
+
+void Archive::dropCachedAssets() {
+	cancelPrefetches();
+	memoryCache_.clear();
+	std::lock_guard<std::mutex> lock(bupMutex_);
+	bupBases_.clear();
+}
+
+namespace {
+
+// Number of traced calls the current thread is inside of.
+thread_local unsigned traceDepth = 0;
+
+}
+
+Archive::TraceScope::TraceScope(Archive &archive, ArchiveHandle handle, ArchiveTraceOp op, std::string_view variant) : archive_(archive), handle_(handle), op_(op), variant_(variant) {
+	if (!archive.tracing_.load(std::memory_order_relaxed)) {
+		return;
+	}
+	counted_ = true;
+	if (traceDepth++ != 0) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(archive.traceMutex_);
+		trace_ = archive.trace_;
+	}
+	start_ = std::chrono::steady_clock::now();
+}
+
+Archive::TraceScope::~TraceScope() {
+	if (!counted_) {
+		return;
+	}
+	--traceDepth;
+	if (!trace_) {
+		return;
+	}
+	auto end = std::chrono::steady_clock::now();
+	uint64_t offset = ~0ull;
+	uint32_t size = 0;
+	if (archive_.isOverlay(handle_)) {
+		std::error_code error;
+		auto fileSize = std::filesystem::file_size(archive_.overlay_.file(archive_.overlayHandle(handle_)), error);
+		size = error ? 0 : static_cast<uint32_t>(fileSize);
+	} else {
+		offset = archive_.index_.offset(handle_);
+		size = archive_.index_.size(handle_);
+	}
+	trace_->record(op_, archive_.entryPath(handle_), variant_, offset, size, start_, end);
+}
+
+void Archive::startTrace() {
+	std::lock_guard<std::mutex> lock(traceMutex_);
+	trace_ = std::make_shared<ArchiveTrace>();
+	tracing_ = true;
+}
+
+size_t Archive::stopTrace(const std::string &path) {
+	std::shared_ptr<ArchiveTrace> trace;
+	{
+		std::lock_guard<std::mutex> lock(traceMutex_);
+		tracing_ = false;
+		trace = std::move(trace_);
+	}
+	if (!trace) {
+		return 0;
+	}
+	// Calls still in flight on other threads hold their own reference and may add events after this save.
+	auto count = trace->save(path);
+	std::cout << "Saved archive trace '" << path << "' with " << count << " events.\n";
+	return count;
+}
+
 std::vector<unsigned char> Archive::read(const std::string &path) {
-	auto &entry = get(path);
+	return read(resolve(path));
+}
 
-	std::lock_guard<std::mutex> lock(mutex_);
-	BinaryReader br(ifs_);
-	br.seekg(entry.offset);
-	std::vector<unsigned char> output(entry.size);
-	br.read((char *)&output[0], entry.size);
-	return output;
-}
-
-ArchiveEntry &Archive::get(const std::string &path) {
-	auto lpath = path;
-	StringUtil::toLower(lpath);
-	auto tokens = StringUtil::splitRef(lpath, { '/' });
-	ArchiveEntry *current = &root_;
-
-	std::lock_guard<std::mutex> lock(mutex_);
-	for (const auto &token : tokens) {
-		auto iter = current->childrenNames.find(token);
-		if (iter != current->childrenNames.end()) {
-			current = &current->children[iter->second];
-		} else {
-			throw std::runtime_error("File '" + lpath + "' not found in archive.");
-		}
+std::vector<unsigned char> Archive::read(ArchiveHandle handle) {
+	TraceScope trace(*this, handle, ArchiveTraceOp::Read);
+	if (auto asset = takePrefetched(handle, ArchiveAssetKind::Raw)) {
+		return std::move(std::get<std::vector<unsigned char>>(*asset));
 	}
-	return *current;
+	auto data = fetch(handle);
+	return std::vector<unsigned char>(data.data(), data.data() + data.size());
 }
 
-uint32_t Archive::decode(const unsigned char *buffer, size_t bufferSize, unsigned char *output) {
-	/*int p = 0;
-	int marker = 1;
-	char *res = output;
+ArchiveBuffer Archive::fetch(const std::string &path) {
+	return fetch(resolve(path));
+}
 
-	while (p < bufferSize) {
-		if (marker == 1)
-			marker = 0x100 | buffer[p++];
+ArchiveBuffer Archive::fetch(ArchiveHandle handle) {
+	TraceScope trace(*this, handle, ArchiveTraceOp::Fetch);
+	if (isOverlay(handle)) {
+		return ArchiveBuffer(overlay_.open(overlayHandle(handle)));
+	}
 
-		if (marker & 1) {
-			uint16_t v = (buffer[p + 0] << 8) | buffer[p + 1];
-			int count, offset;
-			char *pos;
+	auto offset = index_.offset(handle);
+	auto size = index_.size(handle);
+	if (backend_ == ArchiveBackend::Mapped) {
+		return ArchiveBuffer(map_.view(offset, size));
+	}
 
-			if (v & 0x8000) {
-				count = ((v >> 5) & 0x3ff) + 3;
-				offset = v & 0x1f;
-			} else {
-				count = (v >> 11) + 3;
-				offset = (v & 0x7ff) + 32;
-			}
+	std::vector<unsigned char> output(size);
+	file_.readAt(offset, output.data(), output.size());
+	return ArchiveBuffer(std::move(output));
+}
 
-			pos = res - (offset + 1) * 4;
+ArchiveStream Archive::openStream(const std::string &path) {
+	return openStream(resolve(path));
+}
 
-			for (int i = 0; i < count; ++i) {
-				*res++ = *pos++;
-			}
+ArchiveStream Archive::openStream(ArchiveHandle handle) {
+	TraceScope trace(*this, handle, ArchiveTraceOp::Stream);
+	if (isOverlay(handle)) {
+		return ArchiveStream(overlay_.open(overlayHandle(handle)));
+	}
 
-			p += 2;
-		} else {
-			*res++ = buffer[p++];
+	auto offset = index_.offset(handle);
+	auto size = index_.size(handle);
+	if (backend_ == ArchiveBackend::Mapped) {
+		return ArchiveStream(map_.view(offset, size));
+	}
+	return ArchiveStream(file_, offset, size);
+}
+
+ThreadPool &Archive::pool() {
+	std::call_once(poolOnce_, [this]() {
+		pool_ = std::make_unique<ThreadPool>(decodeThreads_ > 1 ? decodeThreads_ - 1 : 0);
+	});
+	return *pool_;
+}
+
+void Archive::decodeChunks(size_t count, const std::function<void(size_t)> &fn) {
+	if (decodeThreads_ == 1) {
+		for (size_t i = 0; i < count; ++i) {
+			fn(i);
 		}
+		return;
+	}
+	pool().parallelFor(count, fn);
+}
 
-		marker >>= 1;
-	}*/
-	unsigned char *res = output;
-	int p = 0;
-	int marker = 1;
-	int j;
-
-	while (p<bufferSize) {
-		if (marker == 1) marker = 0x100 | buffer[p++];
-
-		if (marker & 1) {
-			unsigned int v = (buffer[p + 0] << 8) | buffer[p + 1];
-			int count, offset;
-			unsigned char *pos;
-
-			if (v & 0x8000) {
-				count = ((v >> 5) & 0x3ff) + 3;
-				offset = v & 0x1f;
-			} else {
-				count = (v >> 11) + 3;
-				offset = (v & 0x7ff) + 32;
-			}
+ArchiveRequest Archive::loadAsync(const std::string &path, ArchiveAssetKind kind) {
+	return startRequest(resolve(path), kind, true);
+}
 
-			pos = res - (offset + 1) * 4;
+void Archive::prefetch(const std::string &path, ArchiveAssetKind kind) {
+	auto handle = find(path);
+	if (!handle.valid()) {
+		return;
+	}
+	// Nothing to warm if the getter would be served from memory anyway.
+	if (memoryCache_.enabled() && memoryCache_.contains({ handle.index, static_cast<uint32_t>(kind), std::string() })) {
+		return;
+	}
+	// Nor if the texture will be mapped from the disk cache, which never takes the decoded Pic.
+	if (kind == ArchiveAssetKind::Pic && imageCache_.isOpen() && imageCache_.contains(imageCacheKey(handle), std::string())) {
+		return;
+	}
+	uint64_t key = (uint64_t(handle.index) << 8) | static_cast<uint64_t>(kind);
+	{
+		std::lock_guard<std::mutex> lock(prefetchMutex_);
+		if (prefetches_.count(key)) {
+			return;
+		}
+	}
+	auto request = startRequest(handle, kind, false);
+	if (!request.valid()) {
+		return;
+	}
 
-			for (j = 0; j<count; j++)
-				*res++ = *pos++;
+	std::lock_guard<std::mutex> lock(prefetchMutex_);
+	auto sequence = prefetchSequence_++;
+	if (!prefetches_.insert({ key, { request, sequence } }).second) {
+		request.cancel();
+		return;
+	}
+	prefetchOrder_.push_back({ key, sequence });
+	// Prefetches nobody picked up are dropped oldest first so they cannot pin memory forever.
+	while (prefetchOrder_.size() > MaxPrefetches) {
+		auto oldest = prefetchOrder_.front();
+		prefetchOrder_.pop_front();
+		auto iter = prefetches_.find(oldest.first);
+		if (iter != prefetches_.end() && iter->second.sequence == oldest.second) {
+			iter->second.request.cancel();
+			prefetches_.erase(iter);
+		}
+	}
+}
 
-			p += 2;
+void Archive::prefetch(const std::vector<std::string> &paths) {
+	for (const auto &path : paths) {
+		auto dot = path.rfind('.');
+		auto ext = dot == std::string::npos ? std::string() : path.substr(dot);
+		StringUtil::toLower(ext);
+		if (ext == ".pic") {
+			prefetch(path, ArchiveAssetKind::Pic);
+		} else if (ext == ".bup") {
+			prefetch(path, ArchiveAssetKind::Bup);
+		} else if (ext == ".txa") {
+			prefetch(path, ArchiveAssetKind::Txa);
+		} else if (ext == ".msk") {
+			prefetch(path, ArchiveAssetKind::Msk);
 		} else {
-			*res++ = buffer[p++];
+			prefetch(path, ArchiveAssetKind::Raw);
+		}
+	}
+}
+
+void Archive::cancelPrefetch(const std::string &path, ArchiveAssetKind kind) {
+	auto handle = find(path);
+	if (!handle.valid()) {
+		return;
+	}
+	uint64_t key = (uint64_t(handle.index) << 8) | static_cast<uint64_t>(kind);
+	std::lock_guard<std::mutex> lock(prefetchMutex_);
+	auto iter = prefetches_.find(key);
+	if (iter != prefetches_.end()) {
+		iter->second.request.cancel();
+		prefetches_.erase(iter);
+	}
+}
+
+void Archive::cancelPrefetches() {
+	std::lock_guard<std::mutex> lock(prefetchMutex_);
+	for (auto &prefetch : prefetches_) {
+		prefetch.second.request.cancel();
+	}
+	prefetches_.clear();
+	prefetchOrder_.clear();
+}
+
+ArchiveRequest Archive::startRequest(ArchiveHandle handle, ArchiveAssetKind kind, bool required) {
+	ArchiveRequest request;
+	request.state_ = std::make_shared<ArchiveRequest::State>();
+	auto promise = std::make_shared<std::promise<std::shared_ptr<ArchiveAsset>>>();
+	request.state_->future = promise->get_future().share();
+
+	std::weak_ptr<ArchiveRequest::State> weakState = request.state_;
+	auto job = [this, handle, kind, promise, weakState]() {
+		auto state = weakState.lock();
+		// Every copy of the request being dropped counts as a cancellation too.
+		if (!state || state->cancelled) {
+			promise->set_exception(std::make_exception_ptr(std::runtime_error("Archive request was cancelled.")));
+			return;
+		}
+		try {
+			promise->set_value(std::make_shared<ArchiveAsset>(loadAsset(handle, kind)));
+		} catch (...) {
+			promise->set_exception(std::current_exception());
 		}
+	};
 
-		marker >>= 1;
+	if (required) {
+		pool().submit(std::move(job));
+	} else if (!pool().trySubmit(std::move(job))) {
+		return ArchiveRequest();
 	}
+	return request;
+}
 
-	return res - output;
+ArchiveAsset Archive::loadAsset(ArchiveHandle handle, ArchiveAssetKind kind) {
+	static const ArchiveTraceOp traceOps[] = { ArchiveTraceOp::Read, ArchiveTraceOp::Pic, ArchiveTraceOp::Bup, ArchiveTraceOp::Txa, ArchiveTraceOp::Msk };
+	TraceScope trace(*this, handle, traceOps[static_cast<size_t>(kind)]);
+	switch (kind) {
+	case ArchiveAssetKind::Pic:
+		return decodePic(handle);
+	case ArchiveAssetKind::Bup:
+		return decodeBup(handle);
+	case ArchiveAssetKind::Txa:
+		return decodeTxa(handle);
+	case ArchiveAssetKind::Msk:
+		return decodeMsk(handle);
+	default: {
+		auto data = fetch(handle);
+		return std::vector<unsigned char>(data.data(), data.data() + data.size());
+	}
+	}
 }
 
-void Archive::dpcm(unsigned char *source, unsigned char *destination, int width, int height, int scanline) {
-	for (int i = scanline; i < scanline * height; ++i) {
-		destination[i] += source[i - scanline];
+std::shared_ptr<ArchiveAsset> Archive::takePrefetched(ArchiveHandle handle, ArchiveAssetKind kind) {
+	ArchiveRequest request;
+	{
+		std::lock_guard<std::mutex> lock(prefetchMutex_);
+		if (prefetches_.empty()) {
+			return nullptr;
+		}
+		auto iter = prefetches_.find((uint64_t(handle.index) << 8) | static_cast<uint64_t>(kind));
+		if (iter == prefetches_.end()) {
+			return nullptr;
+		}
+		request = std::move(iter->second.request);
+		prefetches_.erase(iter);
+	}
+	// A failed prefetch falls back to decoding on the caller's thread, which reports the error properly.
+	try {
+		return request.state_->future.get();
+	} catch (const std::exception &) {
+		return nullptr;
 	}
 }
 
@@ -232,7 +592,7 @@ struct BMPHeader {
 };
 #pragma pack(pop)
 
-void Archive::writeImage(const std::string &path, const unsigned char *data, int width, int height, int scanline, int bpp) {
+bool Archive::writeImage(const std::string &path, const unsigned char *data, int width, int height, int scanline, int bpp) {
 	/*std::ofstream ofs(path, std::ios_base::binary);
 	BMPHeader header;
 
@@ -265,20 +625,16 @@ void Archive::writeImage(const std::string &path, const unsigned char *data, int
 	}*/
 
 	if (bpp == 4) {
-		unsigned char *transformed = new unsigned char[scanline * height];
-		for (int i = 0; i < width * height; ++i) {
-			transformed[i * 4 + 0] = data[i * 4 + 2];
-			transformed[i * 4 + 1] = data[i * 4 + 1];
-			transformed[i * 4 + 2] = data[i * 4 + 0];
-			transformed[i * 4 + 3] = data[i * 4 + 3];
+		// Converted a row at a time, so any padding at the end of the source scanline is skipped.
+		std::vector<unsigned char> transformed(size_t(width) * height * 4);
+		for (int y = 0; y < height; ++y) {
+			PixelOps::swapRedBlue(transformed.data() + size_t(y) * width * 4, data + size_t(y) * scanline, width);
 		}
-
-		stbi_write_png(path.c_str(), width, height, 4, transformed, scanline);
-
-		delete[] transformed;
+		return stbi_write_png(path.c_str(), width, height, 4, transformed.data(), width * 4) != 0;
 	} else if (bpp == 1) {
-		stbi_write_png(path.c_str(), width, height, 1, data, scanline);
+		return stbi_write_png(path.c_str(), width, height, 1, data, scanline) != 0;
 	}
+	return false;
 }
 
 struct TxaHeader {
@@ -323,8 +679,8 @@ struct Txa4Chunk {
 void Archive::extractTxa(ArchiveEntry &txa) {
 	auto img = getTxa(txa.path);
 	std::stringstream pngName;
-	for (const auto &se : img.subentries) {
-		pngName << img.name << "_" << se.name << ".png";
+	for (const auto &se : img->subentries) {
+		pngName << img->name << "_" << se.name << ".png";
 		std::cout << "PNG: " << pngName.str() << "\n";
 		writeImage(pngName.str(), se.pixels.data(), se.width, se.height, se.scanline);
 		pngName.clear();
@@ -353,7 +709,7 @@ void Archive::extractTxa(ArchiveEntry &txa) {
 	unsigned char *buffer = new unsigned char[header.encodedSize];
 	br.seekg(txa.offset + header.offset);
 	br.read((char *)buffer, header.encodedSize);
-	decode(buffer, header.encodedSize, data);
+	DataCompression::decompressPicture(buffer, header.encodedSize, data, header.decodedSize);
 
 	std::stringstream bmpName;
 	for (uint32_t i = 0; i < header.chunks; ++i) {
@@ -454,16 +810,73 @@ struct MskHeader {
 	uint32_t unknown;
 };
 
-Txa Archive::getTxa(const std::string &path) {
-	auto &entry = get(path);
+void Archive::setMemoryCacheBudget(uint64_t budget) {
+	memoryCache_.setBudget(budget);
+}
 
-	std::lock_guard<std::mutex> lock(mutex_);
+ImageCacheStats Archive::memoryCacheStats() {
+	return memoryCache_.stats();
+}
+
+static uint64_t imageBytes(const Pic &pic) {
+	return pic.pixels.size();
+}
+
+static uint64_t imageBytes(const Msk &msk) {
+	return msk.pixels.size();
+}
+
+static uint64_t imageBytes(const Bup::SubEntry &pose) {
+	return pose.pixels.size();
+}
+
+static uint64_t imageBytes(const Bup &bup) {
+	uint64_t bytes = bup.pixels.size();
+	for (const auto &pose : bup.subentries) {
+		bytes += pose.pixels.size();
+	}
+	return bytes;
+}
+
+static uint64_t imageBytes(const Txa &txa) {
+	return txa.data ? txa.data->size() : 0;
+}
+
+template <typename T, typename Decode>
+std::shared_ptr<const T> Archive::cached(ArchiveHandle handle, ArchiveAssetKind kind, const std::string &variant, Decode decode) {
+	if (!memoryCache_.enabled()) {
+		return std::make_shared<const T>(decode());
+	}
+	ImageCache::Key key { handle.index, static_cast<uint32_t>(kind), variant };
+	if (auto hit = memoryCache_.find(key)) {
+		return std::static_pointer_cast<const T>(hit);
+	}
+	auto value = std::make_shared<const T>(decode());
+	memoryCache_.insert(key, value, imageBytes(*value));
+	return value;
+}
+
+std::shared_ptr<const Txa> Archive::getTxa(const std::string &path) {
+	return getTxa(resolve(path));
+}
+
+std::shared_ptr<const Txa> Archive::getTxa(ArchiveHandle handle) {
+	TraceScope trace(*this, handle, ArchiveTraceOp::Txa);
+	return cached<Txa>(handle, ArchiveAssetKind::Txa, std::string(), [&]() {
+		if (auto asset = takePrefetched(handle, ArchiveAssetKind::Txa)) {
+			return std::move(std::get<Txa>(*asset));
+		}
+		return decodeTxa(handle);
+	});
+}
+
+Txa Archive::decodeTxa(ArchiveHandle handle) {
+	auto file = fetch(handle);
 
 	Txa txa;
 	std::vector<std::string> names;
 
-	BinaryReader br(ifs_);
-	br.seekg(entry.offset);
+	BinaryReader br((const char *)file.data(), file.size());
 	auto magic = br.read<uint32_t>();
 	//if ((magic & 0xffffff) != 0x434950) {
 	if ((magic & 0xffffff) != 0x415854) {
@@ -474,7 +887,6 @@ Txa Archive::getTxa(const std::string &path) {
 	char magicVer = ((magic >> 24) & 0xff);
 	if (magicVer == '4') {
 		auto header = br.read<Txa4Header>();
-		std::cout << "Magic = " << std::hex << header.magic << std::dec << "\n";
 
 		std::vector<Txa4Chunk> chunks;
 		chunks.reserve(header.chunks);
@@ -483,35 +895,42 @@ Txa Archive::getTxa(const std::string &path) {
 			auto chunk = br.read<Txa4Chunk>();
 			auto name = br.readString();
 			br.seekg(chunkStart + chunk.length);
-			std::cout << "W = " << chunk.width << ", H = " << chunk.height << "\n";
 			chunks.push_back(chunk);
 			names.push_back(name);
 		}
 
-		txa.name = entry.name;
-		txa.subentries.reserve(header.chunks);
+		// Lay the chunks out back to back in one block, checking every chunk before any decoding starts so the workers
+		// only ever see valid ranges.
+		std::vector<Span<const unsigned char>> encoded;
+		std::vector<size_t> offsets;
+		encoded.reserve(header.chunks);
+		offsets.reserve(header.chunks);
+		size_t decodedSize = 0;
+		for (const auto &chunk : chunks) {
+			encoded.push_back(file.view().subspan(chunk.offset, chunk.encodedSize));
+			offsets.push_back(decodedSize);
+			decodedSize += size_t(chunk.width) * chunk.height * 4;
+		}
 
-		uint32_t decodeOffset = 0;
-		for (uint32_t i = 0; i < header.chunks; ++i) {
-			const auto &chunk = chunks[i];
-			unsigned char *buffer = new unsigned char[chunk.encodedSize];
-			br.seekg(entry.offset + chunk.offset);
-			br.read((char *)buffer, chunk.encodedSize);
+		auto data = std::make_shared<std::vector<unsigned char>>(decodedSize);
+		decodeChunks(header.chunks, [&](size_t i) {
+			auto size = size_t(chunks[i].width) * chunks[i].height * 4;
+			DataCompression::decompressPicture(encoded[i].data(), encoded[i].size(), data->data() + offsets[i], size);
+		});
 
+		txa.name = entryName(handle);
+		txa.subentries.reserve(header.chunks);
+		for (uint32_t i = 0; i < header.chunks; ++i) {
 			auto &subEntry = txa.subentries.emplace_back();
 			subEntry.name = names[i];
 			subEntry.width = chunks[i].width;
 			subEntry.height = chunks[i].height;
 			subEntry.scanline = chunks[i].width * 4;
-			subEntry.pixels.resize(subEntry.width * subEntry.height * 4);
-
-			decodeOffset += decode(buffer + decodeOffset, chunk.encodedSize, subEntry.pixels.data());
-
-			delete[] buffer;
+			subEntry.pixels = Span<const unsigned char>(data->data() + offsets[i], size_t(subEntry.width) * subEntry.height * 4);
 		}
+		txa.data = std::move(data);
 	} else if (magicVer == '3') {
 		auto header = br.read<TxaHeader>();
-		std::cout << "Magic = " << std::hex << header.magic << std::dec << "\n";
 		//char *metadata = new char[header.offset - sizeof(header)];
 		//br.read(metadata, header.offset - sizeof(header));
 
@@ -522,35 +941,27 @@ Txa Archive::getTxa(const std::string &path) {
 			auto chunk = br.read<TxaChunk>();
 			auto name = br.readString();
 			br.seekg(chunkStart + chunk.length);
-			std::cout << "W = " << chunk.width << ", H = " << chunk.height << "\n";
 			chunks.push_back(chunk);
 			names.push_back(name);
 		}
 
-		unsigned char *data = new unsigned char[header.decodedSize];
-		unsigned char *buffer = new unsigned char[header.encodedSize];
-		br.seekg(entry.offset + header.offset);
-		br.read((char *)buffer, header.encodedSize);
-		decode(buffer, header.encodedSize, data);
+		auto data = std::make_shared<std::vector<unsigned char>>(header.decodedSize);
+		auto encoded = file.view().subspan(header.offset, header.encodedSize);
+		DataCompression::decompressPicture(encoded.data(), encoded.size(), data->data(), data->size());
 
-		txa.name = entry.name;
+		txa.name = entryName(handle);
 		txa.subentries.reserve(header.chunks);
 		for (uint32_t i = 0; i < header.chunks; ++i) {
-			//std::stringstream bmpName;
-			//bmpName << txa.name << "_" << names[i] << ".png";
-			//std::cout << "PNG: " << bmpName.str() << "\n";
-			//writeImage(bmpName.str(), data + chunks[i].offset, chunks[i].width, chunks[i].height, chunks[i].scanline);
 			auto &subEntry = txa.subentries.emplace_back();
 			subEntry.name = names[i];
 			subEntry.width = chunks[i].width;
 			subEntry.height = chunks[i].height;
-			subEntry.scanline = chunks[i].scanline;
-			subEntry.pixels.resize(subEntry.width * subEntry.height * 4);
-			memcpy(subEntry.pixels.data(), data + chunks[i].offset, subEntry.width * subEntry.height * 4);
+			subEntry.scanline = std::max<uint32_t>(chunks[i].scanline, subEntry.width * 4);
+			// The last row only needs its visible pixels, the rest of its scanline may be cut off by the block.
+			auto size = subEntry.height ? size_t(subEntry.scanline) * (subEntry.height - 1) + size_t(subEntry.width) * 4 : 0;
+			subEntry.pixels = Span<const unsigned char>(*data).subspan(chunks[i].offset, size);
 		}
-
-		delete[] data;
-		delete[] buffer;
+		txa.data = std::move(data);
 	} else {
 		throw std::runtime_error("Unsupported TXA version.");
 	}
@@ -558,16 +969,135 @@ Txa Archive::getTxa(const std::string &path) {
 	return txa;
 }
 
-Pic Archive::getPic(const std::string &path) {
-	auto &entry = get(path);
+void Archive::enableImageCache(const std::string &directory, uint64_t budget) {
+	imageCache_.open(directory, budget);
+}
 
-	std::lock_guard<std::mutex> lock(mutex_);
+ImageCacheKey Archive::imageCacheKey(ArchiveHandle handle) {
+	ImageCacheKey key;
+	if (isOverlay(handle)) {
+		// Loose files are small and edited in place, so hash all of them; the offset keeps them apart from ROM entries.
+		auto file = fetch(handle);
+		key.offset = ~0ull;
+		key.size = static_cast<uint32_t>(file.size());
+		key.contentHash = ImageDiskCache::hash(file.view());
+		return key;
+	}
+	key.offset = index_.offset(handle);
+	key.size = index_.size(handle);
+	// Only the head, which holds the dimensions and chunk table, and the tail are hashed, so the ROM's size and
+	// timestamp are mixed in as for the index sidecar: a patch that rewrites the middle of an entry in place still
+	// changes the ROM's timestamp, without reading all of the entry on every lookup.
+	const uint32_t sample = 4096;
+	std::vector<unsigned char> hashed;
+	if (key.size <= sample * 2) {
+		auto file = fetch(handle);
+		hashed.assign(file.data(), file.data() + file.size());
+	} else {
+		hashed.resize(sample * 2);
+		if (backend_ == ArchiveBackend::Mapped) {
+			memcpy(hashed.data(), map_.view(key.offset, sample).data(), sample);
+			memcpy(hashed.data() + sample, map_.view(key.offset + key.size - sample, sample).data(), sample);
+		} else {
+			file_.readAt(key.offset, hashed.data(), sample);
+			file_.readAt(key.offset + key.size - sample, hashed.data() + sample, sample);
+		}
+	}
+	auto stamp = hashed.size();
+	hashed.resize(stamp + sizeof(romKey_.romSize) + sizeof(romKey_.romModified));
+	memcpy(hashed.data() + stamp, &romKey_.romSize, sizeof(romKey_.romSize));
+	memcpy(hashed.data() + stamp + sizeof(romKey_.romSize), &romKey_.romModified, sizeof(romKey_.romModified));
+	key.contentHash = ImageDiskCache::hash(Span<const unsigned char>(hashed.data(), hashed.size()));
+	return key;
+}
 
+CachedImage Archive::findCachedImage(const std::string &path, const std::string &variant) {
+	if (!imageCache_.isOpen()) {
+		return CachedImage();
+	}
+	auto handle = find(path);
+	if (!handle.valid()) {
+		return CachedImage();
+	}
+	return imageCache_.find(imageCacheKey(handle), variant);
+}
+
+void Archive::storeCachedImage(const std::string &path, const std::string &variant, uint32_t width, uint32_t height, std::shared_ptr<const std::vector<unsigned char>> pixels) {
+	auto handle = find(path);
+	if (!imageCache_.isOpen() || !handle.valid() || !pixels || pixels->size() != size_t(width) * height * 4) {
+		return;
+	}
+	pool().trySubmit([this, handle, variant, width, height, pixels]() {
+		try {
+			imageCache_.store(imageCacheKey(handle), variant, width, height, pixels->data());
+		} catch (const std::exception &) {
+			// The cache is only an optimization.
+		}
+	});
+}
+
+static void copyPic(const Pic &pic, const Archive::PicSurface &surface) {
+	size_t stride;
+	auto *destination = surface(pic.width, pic.height, stride);
+	for (uint32_t y = 0; y < pic.height; ++y) {
+		memcpy(destination + y * stride, pic.pixels.data() + y * pic.width * 4, pic.width * 4);
+	}
+}
+
+std::shared_ptr<const Pic> Archive::getPic(const std::string &path) {
+	return getPic(resolve(path));
+}
+
+std::shared_ptr<const Pic> Archive::getPic(ArchiveHandle handle) {
+	TraceScope trace(*this, handle, ArchiveTraceOp::Pic);
+	return cached<Pic>(handle, ArchiveAssetKind::Pic, std::string(), [&]() {
+		if (auto asset = takePrefetched(handle, ArchiveAssetKind::Pic)) {
+			return std::move(std::get<Pic>(*asset));
+		}
+		return decodePic(handle);
+	});
+}
+
+void Archive::getPic(const std::string &path, const PicSurface &surface) {
+	getPic(resolve(path), surface);
+}
+
+void Archive::getPic(ArchiveHandle handle, const PicSurface &surface) {
+	TraceScope trace(*this, handle, ArchiveTraceOp::Pic);
+	// A Pic that is already in memory, cached or prefetched, is copied out. Anything else is decoded straight into the
+	// surface and not added to the memory cache, which would take a second decode or a copy back out of the surface.
+	std::shared_ptr<const void> hit;
+	if (memoryCache_.enabled()) {
+		hit = memoryCache_.find({ handle.index, static_cast<uint32_t>(ArchiveAssetKind::Pic), std::string() });
+	}
+	if (hit) {
+		copyPic(*static_cast<const Pic *>(hit.get()), surface);
+		return;
+	}
+	if (auto asset = takePrefetched(handle, ArchiveAssetKind::Pic)) {
+		copyPic(std::get<Pic>(*asset), surface);
+		return;
+	}
+	decodePic(handle, surface);
+}
+
+Pic Archive::decodePic(ArchiveHandle handle) {
 	Pic pic;
-	pic.name = path;
+	pic.name = entryPath(handle);
+	decodePic(handle, [&](uint32_t width, uint32_t height, size_t &stride) {
+		pic.width = width;
+		pic.height = height;
+		pic.pixels.resize(4 * width * height);
+		stride = 4 * width;
+		return pic.pixels.data();
+	});
+	return pic;
+}
 
-	BinaryReader br(ifs_);
-	br.seekg(entry.offset);
+void Archive::decodePic(ArchiveHandle handle, const PicSurface &surface) {
+	auto file = fetch(handle);
+
+	BinaryReader br((const char *)file.data(), file.size());
 
 	auto magic = br.read<uint32_t>();
 	br.skip(-4);
@@ -578,112 +1108,128 @@ Pic Archive::getPic(const std::string &path) {
 		std::vector<Pic4Entry> entries(header.chunks);
 		br.read((char *)entries.data(), header.chunks * sizeof(Pic4Entry));
 
-		pic.pixels.resize(4 * header.width * header.height);
-		pic.width = header.width;
-		pic.height = header.height;
-
+		// Headers are parsed up front; the chunks cover disjoint rectangles, so each is then decoded straight into the
+		// output image on its own thread.
 		std::vector<Pic4Chunk> chunks;
+		std::vector<Span<const unsigned char>> data;
 		chunks.reserve(header.chunks);
+		data.reserve(header.chunks);
 		for (uint32_t i = 0; i < header.chunks; ++i) {
 			const auto &e = entries[i];
 
-			br.seekg(entry.offset + e.offset);
+			br.seekg(e.offset);
 
 			chunks.push_back(br.read<Pic4Chunk>());
-			auto &chunk = chunks.back();
-			//unsigned char *data = new unsigned char[chunk.encodedSize];
-			unsigned char *data = new unsigned char[chunk.height * chunk.width * 4];
-
-			//unsigned char *result = new unsigned char[chunk.height * chunk.widthPlus2];
-			br.read((char *)data, chunk.encodedSize);
-			//decode(data, chunk.encodedSize, result);
-			//dpcm(result, result, chunk.width, chunk.height, chunk.widthPlus2);
-			dpcm(data, data, chunk.width, chunk.height, chunk.width * 4);
-
-			for (int y = 0; y < chunk.height; ++y) {
-				std::copy(data + y * chunk.width * 4, data + (y + 1) * chunk.width * 4, pic.pixels.data() + e.left * 4 + (e.top + y) * header.width * 4);
+			const auto &chunk = chunks.back();
+			if (e.left + chunk.width > header.width || e.top + chunk.height > header.height) {
+				throw std::runtime_error("PIC chunk lies outside the image.");
 			}
-
-			delete[] data;
+			data.push_back(file.view().subspan(static_cast<size_t>(br.tellg()), size_t(chunk.width) * chunk.height * 4));
 		}
 
+		size_t stride;
+		auto *pixels = surface(header.width, header.height, stride);
+		decodeChunks(header.chunks, [&](size_t i) {
+			const auto &e = entries[i];
+			const auto &chunk = chunks[i];
+			auto rowSize = chunk.width * 4;
+			auto *output = pixels + e.left * 4 + e.top * stride;
+			// The surface may be write-only mapped memory, so rows are rebuilt in scratch rows as in decodeRows and
+			// only copied out.
+			std::vector<unsigned char> rows(rowSize * 2);
+			auto *previous = rows.data(), *current = rows.data() + rowSize;
+			for (int y = 0; y < chunk.height; ++y) {
+				PixelOps::dpcmRow(current, data[i].data() + y * rowSize, y ? previous : nullptr, rowSize);
+				memcpy(output + y * stride, current, rowSize);
+				std::swap(previous, current);
+			}
+		});
 	} else {
 		auto header = br.read<PicHeader>();
 
 		std::vector<PicChunk> chunks(header.chunks);
 		br.read((char *)chunks.data(), header.chunks * sizeof(PicChunk));
 
-		pic.pixels.resize(4 * header.width * header.height);
-		pic.width = header.width;
-		pic.height = header.height;
-
-		for (uint32_t i = 0; i < header.chunks; ++i) {
-			PicChunk &chunk = chunks[i];
-
-			auto size = chunk.size;
-			unsigned char *buffer = new unsigned char[size];
-			auto chunkStride = 4 * ((chunk.width + 3) & 0xfffc);
-			unsigned char *result = new unsigned char[chunk.height * chunkStride];
-
-			br.seekg(entry.offset + chunk.offset);
-			br.read((char *)buffer, size);
-
-			decode(buffer, size, result);
-			dpcm(result, result, chunk.width, chunk.height, chunkStride);
-			for (int y = 0; y < chunk.height; ++y) {
-				/*for (int x = 0; x < chunk.width * 4; ++x) {
-				pic.pixels[chunk.left * 4 + x + (chunk.top + y) * header.width * 4] = result[x + y * chunkStride];
-				}*/
-				memcpy(&pic.pixels[chunk.left * 4 + (chunk.top + y) * header.width * 4], result + y * chunkStride, chunkStride);
+		for (const auto &chunk : chunks) {
+			if (chunk.left + chunk.width > header.width || chunk.top + chunk.height > header.height) {
+				throw std::runtime_error("PIC chunk lies outside the image.");
 			}
-			delete[] buffer;
-			delete[] result;
 		}
+
+		// Only width * 4 bytes of each decoded row are written; the padding would otherwise spill into a neighbouring
+		// chunk that another thread is writing.
+		size_t stride;
+		auto *pixels = surface(header.width, header.height, stride);
+		decodeChunks(header.chunks, [&](size_t i) {
+			const PicChunk &chunk = chunks[i];
+			auto encoded = file.view().subspan(chunk.offset, chunk.size);
+			decodeRows(encoded, chunk.width, chunk.height, pixels + chunk.left * 4 + chunk.top * stride, stride, chunk.width * 4);
+		});
 	}
-	
+}
 
-	return pic;
+void Archive::decodeRows(Span<const unsigned char> encoded, uint32_t width, uint32_t height, unsigned char *destination, size_t stride, size_t rowSize) {
+	PictureDecompressor decompressor(encoded.data(), encoded.size());
+	size_t encodedStride = 4 * ((width + 3) & 0xfffc);
+	// Two scratch rows take turns holding the row above; rebuilding one row in place is measurably slower.
+	std::vector<unsigned char> rows(rowSize * 2);
+	auto *previous = rows.data(), *current = rows.data() + rowSize;
+	for (uint32_t y = 0; y < height; ++y) {
+		PixelOps::dpcmRow(current, decompressor.next(encodedStride), y ? previous : nullptr, rowSize);
+		memcpy(destination + y * stride, current, rowSize);
+		std::swap(previous, current);
+	}
 }
 
-Msk Archive::getMsk(const std::string &path) {
-	auto &entry = get(path);
+std::shared_ptr<const Msk> Archive::getMsk(const std::string &path) {
+	return getMsk(resolve(path));
+}
 
-	std::lock_guard<std::mutex> lock(mutex_);
+std::shared_ptr<const Msk> Archive::getMsk(ArchiveHandle handle) {
+	TraceScope trace(*this, handle, ArchiveTraceOp::Msk);
+	return cached<Msk>(handle, ArchiveAssetKind::Msk, std::string(), [&]() {
+		if (auto asset = takePrefetched(handle, ArchiveAssetKind::Msk)) {
+			return std::move(std::get<Msk>(*asset));
+		}
+		return decodeMsk(handle);
+	});
+}
 
-	BinaryReader br(ifs_);
-	br.seekg(entry.offset);
+Msk Archive::decodeMsk(ArchiveHandle handle) {
+	auto file = fetch(handle);
+
+	BinaryReader br((const char *)file.data(), file.size());
 
 	auto header = br.read<MskHeader>();
 
 	Msk msk;
-	msk.name = entry.name;
+	msk.name = entryName(handle);
 	msk.width = header.width;
 	msk.height = header.height;
-	std::vector<uint8_t> data;
-	data.resize(entry.size);
-	br.read((char *)data.data(), data.size());
-	msk.pixels = DataCompression::decompress12_4(data.data(), data.size(), msk.width * msk.height);
+	auto data = file.view().subspan(sizeof(MskHeader), file.size() - sizeof(MskHeader));
+	msk.pixels.resize(size_t(msk.width) * msk.height);
+	DataCompression::decompress12_4(data.data(), data.size(), msk.pixels.data(), msk.pixels.size());
 
 	return msk;
 }
 
 void Archive::extractMsk(const std::string &path) {
 	auto msk = getMsk(path);
-	std::vector<unsigned char> expandedPixels(msk.width * msk.height * 4);
-	for (uint32_t i = 0; i < msk.height; ++i) {
-		for (uint32_t j = 0; j < msk.width; ++j) {
-			expandedPixels[i * msk.width * 4 + j * 4 + 0] = msk.pixels[i * msk.width + j];
-			expandedPixels[i * msk.width * 4 + j * 4 + 1] = msk.pixels[i * msk.width + j];
-			expandedPixels[i * msk.width * 4 + j * 4 + 2] = msk.pixels[i * msk.width + j];
-			expandedPixels[i * msk.width * 4 + j * 4 + 3] = 0xff;
+	std::vector<unsigned char> expandedPixels(msk->width * msk->height * 4);
+	for (uint32_t i = 0; i < msk->height; ++i) {
+		for (uint32_t j = 0; j < msk->width; ++j) {
+			expandedPixels[i * msk->width * 4 + j * 4 + 0] = msk->pixels[i * msk->width + j];
+			expandedPixels[i * msk->width * 4 + j * 4 + 1] = msk->pixels[i * msk->width + j];
+			expandedPixels[i * msk->width * 4 + j * 4 + 2] = msk->pixels[i * msk->width + j];
+			expandedPixels[i * msk->width * 4 + j * 4 + 3] = 0xff;
 		}
 	}
-	writeImage(msk.name + "_test.png", expandedPixels.data(), msk.width, msk.height, 4 * msk.width);
+	writeImage(msk->name + "_test.png", expandedPixels.data(), msk->width, msk->height, 4 * msk->width);
 }
 
 void Archive::extractPic(ArchiveEntry &entry) {
 	auto pic = getPic(entry.path);
-	writeImage(entry.name + "_test.png", pic.pixels.data(), pic.width, pic.height, 4 * pic.width);
+	writeImage(entry.name + "_test.png", pic->pixels.data(), pic->width, pic->height, 4 * pic->width);
 	/*BinaryReader br(ifs_);
 	br.seekg(entry.offset);
 
@@ -720,91 +1266,176 @@ void Archive::extractPic(ArchiveEntry &entry) {
 	writeImage(pic.name + "_test.png", pic.pixels.data(), header.width, header.height, 4 * header.width);*/
 }
 
-Bup Archive::getBup(const std::string &path) {
-	auto &entry = get(path);
+std::shared_ptr<const Bup> Archive::getBup(const std::string &path) {
+	return getBup(resolve(path));
+}
 
-	std::lock_guard<std::mutex> lock(mutex_);
+std::shared_ptr<const Bup> Archive::getBup(ArchiveHandle handle) {
+	TraceScope trace(*this, handle, ArchiveTraceOp::Bup);
+	return cached<Bup>(handle, ArchiveAssetKind::Bup, std::string(), [&]() {
+		if (auto asset = takePrefetched(handle, ArchiveAssetKind::Bup)) {
+			return std::move(std::get<Bup>(*asset));
+		}
+		return decodeBup(handle);
+	});
+}
 
-	BinaryReader br(ifs_);
-	br.seekg(entry.offset);
-	auto header = br.read<BupHeader>();
-	std::cout << "Magic = " << std::hex << header.magic << std::dec << "\n";
+struct Archive::BupBase {
+	BupHeader header;
 	std::vector<BupChunk> chunks;
-	chunks.reserve(header.chunks);
+	uint32_t stride;
+	std::vector<unsigned char> pixels;
+};
 
-	for (uint32_t i = 0; i < header.chunks; ++i) {
-		auto chunk = br.read<BupChunk>();
-		chunks.push_back(chunk);
+Bup Archive::decodeBup(ArchiveHandle handle) {
+	auto base = bupBase(handle);
+	auto file = fetch(handle);
+
+	Bup bup;
+	bup.pixels = base->pixels;
+	bup.subentries.resize(base->chunks.size());
+	for (size_t i = 0; i < base->chunks.size(); ++i) {
+		composeBupPose(*base, base->chunks[i], file, bup.subentries[i]);
 	}
 
-	auto stride = 4 * ((header.width + 3) & 0xfffc);
+	bup.width = base->stride / 4;
+	bup.height = base->header.height;
+	return bup;
+}
 
-	//unsigned char *data = new unsigned char[stride * header.height * 4];
-	Bup bup;
-	bup.pixels.resize(stride * header.height);
-
-	unsigned char *buffer = new unsigned char[header.size];
-	br.seekg(entry.offset + header.offset);
-	br.read((char *)buffer, header.size);
-	decode(buffer, header.size, bup.pixels.data());
-	dpcm(bup.pixels.data(), bup.pixels.data(), header.width, header.height, stride);
-	/*for (int i = stride; i < stride * header.height; ++i) {
-		bup.pixels[i] += bup.pixels[i - stride];
-	}*/
-	//writeImage(bup.name + "_test.png", data, header.width, header.height, stride);
+std::shared_ptr<const Bup::SubEntry> Archive::getBupPose(const std::string &path, const std::string &pose) {
+	return getBupPose(resolve(path), pose);
+}
 
-	delete[] buffer;
+std::shared_ptr<const Bup::SubEntry> Archive::getBupPose(ArchiveHandle handle, const std::string &pose) {
+	TraceScope trace(*this, handle, ArchiveTraceOp::BupPose, pose);
+	return cached<Bup::SubEntry>(handle, ArchiveAssetKind::Bup, pose, [&]() {
+		auto base = bupBase(handle);
+		for (const auto &chunk : base->chunks) {
+			if (std::string(chunk.title, strnlen(chunk.title, sizeof(chunk.title))) == pose) {
+				Bup::SubEntry subentry;
+				composeBupPose(*base, chunk, fetch(handle), subentry);
+				return subentry;
+			}
+		}
+		throw std::runtime_error("Invalid Bup pose. Got " + pose + ".");
+	});
+}
 
-	bup.subentries.resize(header.chunks);
-	for (uint32_t i = 0; i < header.chunks; ++i) {
-		BupChunk &chunk = chunks[i];
-
-		auto &subentry = bup.subentries[i];
-		subentry.width = stride / 4;
-		subentry.height = header.height;
-		subentry.name = chunk.title;
-		subentry.pixels.resize(stride * header.height);
-		std::copy(bup.pixels.begin(), bup.pixels.end(), subentry.pixels.begin());
-
-		if (chunk.picture[0].width == 0) continue;
-
-		auto stride0 = 4 * ((chunk.picture[0].width + 3) & 0xfffc);
-		unsigned char *xdata = new unsigned char[stride0 * chunk.picture[0].height];
-		buffer = new unsigned char[chunk.picture[0].size];
-		br.seekg(entry.offset + chunk.picture[0].offset);
-		br.read((char *)buffer, chunk.picture[0].size);
-		decode(buffer, chunk.picture[0].size, xdata);
-		dpcm(xdata, xdata, chunk.picture[0].width, chunk.picture[0].height, stride0);
-
-		auto w = chunk.picture[0].width;
-		auto h = chunk.picture[0].height;
-		auto dx = chunk.picture[0].left;
-		auto dy = chunk.picture[0].top;
-		for (int y = 0; y < h; ++y) {
-			for (int x = 0; x < w; ++x) {
-				int d = (x + dx) * 4 + (y + dy) * stride;
-				int s = x * 4 + y * stride0;
-
-				int da = subentry.pixels[d + 3];
-				int sa = xdata[s + 3];
-
-				if (sa != 0) {
-					for (int j = 0; j < 4; ++j) {
-						subentry.pixels[d + j] = xdata[s + j];
-					}
-				}
+void Archive::prefetchBupBase(const std::string &path, const std::string &pose) {
+	auto handle = find(path);
+	if (!handle.valid()) {
+		return;
+	}
+	// A pose in the disk cache is mapped from there and never needs the base.
+	if (imageCache_.isOpen() && imageCache_.contains(imageCacheKey(handle), pose)) {
+		return;
+	}
+	pool().trySubmit([this, handle]() {
+		try {
+			bupBase(handle);
+		} catch (const std::exception &) {
+			// Reported again when the pose is actually requested.
+		}
+	});
+}
+
+std::shared_ptr<const Archive::BupBase> Archive::bupBase(ArchiveHandle handle) {
+	// Callers asking for a base that is still being decoded wait on the same future instead of decoding it again.
+	std::promise<std::shared_ptr<const BupBase>> promise;
+	std::shared_future<std::shared_ptr<const BupBase>> future;
+	bool owner = false;
+	{
+		std::lock_guard<std::mutex> lock(bupMutex_);
+		auto iter = std::find_if(bupBases_.begin(), bupBases_.end(), [&](const auto &cached) {
+			return cached.first == handle.index;
+		});
+		if (iter != bupBases_.end()) {
+			future = iter->second;
+			bupBases_.splice(bupBases_.begin(), bupBases_, iter);
+		} else {
+			future = promise.get_future().share();
+			bupBases_.push_front({ handle.index, future });
+			if (bupBases_.size() > MaxBupBases) {
+				bupBases_.pop_back();
 			}
+			owner = true;
 		}
 	}
 
-	bup.width = stride / 4;
-	bup.height = header.height;
-	return bup;
+	if (owner) {
+		try {
+			promise.set_value(decodeBupBase(handle));
+		} catch (...) {
+			promise.set_exception(std::current_exception());
+			std::lock_guard<std::mutex> lock(bupMutex_);
+			bupBases_.remove_if([&](const auto &cached) {
+				return cached.first == handle.index;
+			});
+		}
+	}
+	return future.get();
+}
+
+std::shared_ptr<const Archive::BupBase> Archive::decodeBupBase(ArchiveHandle handle) {
+	auto file = fetch(handle);
+
+	BinaryReader br((const char *)file.data(), file.size());
+	auto base = std::make_shared<BupBase>();
+	base->header = br.read<BupHeader>();
+	const auto &header = base->header;
+	base->chunks.resize(header.chunks);
+	br.read((char *)base->chunks.data(), header.chunks * sizeof(BupChunk));
+
+	base->stride = 4 * ((header.width + 3) & 0xfffc);
+	base->pixels.resize(base->stride * header.height);
+
+	auto encoded = file.view().subspan(header.offset, header.size);
+	decodeRows(encoded, header.width, header.height, base->pixels.data(), base->stride, base->stride);
+	return base;
+}
+
+void Archive::composeBupPose(const BupBase &base, const BupChunk &chunk, const ArchiveBuffer &file, Bup::SubEntry &subentry) {
+	auto stride = base.stride;
+	subentry.width = stride / 4;
+	subentry.height = base.header.height;
+	subentry.name = std::string(chunk.title, strnlen(chunk.title, sizeof(chunk.title)));
+	subentry.pixels = base.pixels;
+
+	if (chunk.picture[0].width == 0) return;
+
+	auto w = chunk.picture[0].width;
+	auto h = chunk.picture[0].height;
+	auto dx = chunk.picture[0].left;
+	auto dy = chunk.picture[0].top;
+	if (dx + w > subentry.width || dy + h > subentry.height) {
+		throw std::runtime_error("BUP expression lies outside the base image.");
+	}
+
+	auto stride0 = 4 * ((w + 3) & 0xfffc);
+	std::vector<unsigned char> xdata(stride0 * h);
+	auto expression = file.view().subspan(chunk.picture[0].offset, chunk.picture[0].size);
+	decodeRows(expression, w, h, xdata.data(), stride0, stride0);
+
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			int d = (x + dx) * 4 + (y + dy) * stride;
+			int s = x * 4 + y * stride0;
+
+			int sa = xdata[s + 3];
+
+			if (sa != 0) {
+				for (int j = 0; j < 4; ++j) {
+					subentry.pixels[d + j] = xdata[s + j];
+				}
+			}
+		}
+	}
 }
 
 void Archive::extractBup(ArchiveEntry &bup) {
-	BinaryReader br(ifs_);
-	br.seekg(bup.offset);
+	auto file = fetch(resolve(bup.path));
+	BinaryReader br((const char *)file.data(), file.size());
 	auto header = br.read<BupHeader>();
 	std::cout << "Magic = " << std::hex << header.magic << std::dec << "\n";
 	std::vector<BupChunk> chunks;
@@ -819,23 +1450,25 @@ void Archive::extractBup(ArchiveEntry &bup) {
 
 	unsigned char *data = new unsigned char[stride * header.height * 4];
 
-	unsigned char *buffer = new unsigned char[header.size];
-	br.seekg(bup.offset + header.offset);
-	br.read((char *)buffer, header.size);
-	decode(buffer, header.size, data);
+	auto encoded = file.view().subspan(header.offset, header.size);
+	DataCompression::decompressPicture(encoded.data(), encoded.size(), data, stride * header.height * 4);
 	for (int i = stride; i < stride * header.height; ++i) {
 		data[i] += data[i - stride];
 	}
 	writeImage(bup.name + "_test.png", data, header.width, header.height, stride);
 
-	delete[] buffer;
 	delete[] data;
 }
 
 Png Archive::getPng(const std::string &path) {
-	auto pngData = read(path);
+	return getPng(resolve(path));
+}
+
+Png Archive::getPng(ArchiveHandle handle) {
+	TraceScope trace(*this, handle, ArchiveTraceOp::Png);
+	auto pngData = fetch(handle);
 	Png png;
-	png.name = path;
+	png.name = entryPath(handle);
 	auto *data = stbi_load_from_memory(pngData.data(), static_cast<int>(pngData.size()), (int *)&png.width, (int *)&png.height, 0, 4);
 	png.pixels.resize(png.width * png.height * 4);
 	std::copy(data, data + png.pixels.size(), png.pixels.data());
@@ -849,20 +1482,26 @@ struct ArchiveChunk {
 	uint32_t size;
 };
 
-void Archive::scan(uint64_t startOffset, ArchiveEntry &current, BinaryReader &br) {
-	br.seekg(startOffset);
-	auto count = br.read<uint32_t>();
+void Archive::readAt(uint64_t offset, void *buffer, size_t size) {
+	if (backend_ == ArchiveBackend::Mapped) {
+		memcpy(buffer, map_.view(offset, size).data(), size);
+	} else {
+		file_.readAt(offset, buffer, size);
+	}
+}
+
+void Archive::scan(uint64_t startOffset, const std::string &folder) {
+	uint32_t count;
+	readAt(startOffset, &count, sizeof(count));
 	std::vector<ArchiveChunk> chunks(count);
-	br.read((char *)chunks.data(), count * sizeof(ArchiveChunk));
+	readAt(startOffset + sizeof(count), chunks.data(), count * sizeof(ArchiveChunk));
 
 	auto firstNameOffset = chunks[0].nameOffset & ~0x80000000;
 	auto firstName = startOffset + firstNameOffset;
 	auto nameSize = chunks[0].size - firstNameOffset;
-	br.seekg(firstName);
 	std::vector<char> nameList(nameSize);
-	br.read(nameList.data(), nameSize);
+	readAt(firstName, nameList.data(), nameSize);
 
-	current.children.reserve(count);
 	for (uint32_t i = 0; i < count; ++i) {
 		auto &chunk = chunks[i];
 		int isFolder = chunk.nameOffset & 0x80000000;
@@ -877,20 +1516,10 @@ void Archive::scan(uint64_t startOffset, ArchiveEntry &current, BinaryReader &br
 		if (name == "." || name == "..")
 			continue;
 
-		auto &entry = current.children.emplace_back();
-		entry.parent = &current;
-		entry.name = std::move(name);
-		current.childrenNames.insert({ entry.name, current.children.size() - 1 });
-
 		if (isFolder) {
-			std::cout << "Reading folder '" << entry.name << "' (parent = '" << current.name << "')...\n";
-			entry.isFolder = true;
-			entry.path = current.path + entry.name + "/";
-			scan(offset, entry, br);
+			scan(offset, folder + name + "/");
 		} else {
-			entry.offset = offset;
-			entry.size = chunk.size;
-			entry.path = current.path + entry.name;
+			index_.add(folder + name, offset, chunk.size);
 		}
 	}
 }
\ No newline at end of file
@@ -1,12 +1,30 @@
 #pragma once
 
+#include <atomic>
+#include <deque>
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <fstream>
+#include <functional>
+#include <future>
+#include <list>
+#include <unordered_map>
+#include <variant>
 
-class BinaryReader;
+#include "archiveindex.h"
+#include "archiveoverlay.h"
+#include "archivestream.h"
+#include "archivetrace.h"
+#include "imagecache.h"
+#include "imagediskcache.h"
+#include "../util/file.h"
+#include "../util/span.h"
+#include "../util/threadpool.h"
+
+struct BupChunk;
 
 struct ArchiveEntry {
 	ArchiveEntry *parent = nullptr;
@@ -31,14 +49,17 @@ struct Bup {
 	std::vector<SubEntry> subentries;
 };
 
+// Sub-entries are views into one decoded block shared by every copy of the Txa, so copies are cheap and the views
+// stay valid for as long as any copy is alive.
 struct Txa {
 	std::string name;
 	struct SubEntry {
 		std::string name;
 		uint32_t width, height, scanline;
-		std::vector<unsigned char> pixels;
+		Span<const unsigned char> pixels;
 	};
 	std::vector<SubEntry> subentries;
+	std::shared_ptr<const std::vector<unsigned char>> data;
 };
 
 struct Pic {
@@ -59,32 +80,275 @@ struct Png {
 	std::vector<unsigned char> pixels;
 };
 
+// Contents of an archive entry. When the archive is memory-mapped this is a view straight into the ROM, for an overlay
+// file it owns a mapping of that file, otherwise it owns a copy of the entry's bytes.
+class ArchiveBuffer {
+public:
+	ArchiveBuffer() = default;
+	explicit ArchiveBuffer(Span<const unsigned char> view) : view_(view) {}
+	explicit ArchiveBuffer(std::vector<unsigned char> &&data) : data_(std::move(data)), view_(data_) {}
+	explicit ArchiveBuffer(MappedFile &&mapping) : mapping_(std::move(mapping)), view_(mapping_.data(), mapping_.size()) {}
+	ArchiveBuffer(const ArchiveBuffer &other) = delete;
+	ArchiveBuffer(ArchiveBuffer &&other) = default;
+	ArchiveBuffer &operator=(const ArchiveBuffer &other) = delete;
+	ArchiveBuffer &operator=(ArchiveBuffer &&other) = default;
+
+	const unsigned char *data() const {
+		return view_.data();
+	}
+
+	size_t size() const {
+		return view_.size();
+	}
+
+	Span<const unsigned char> view() const {
+		return view_;
+	}
+private:
+	std::vector<unsigned char> data_;
+	MappedFile mapping_;
+	Span<const unsigned char> view_;
+};
+
+enum class ArchiveBackend {
+	Stream,
+	Mapped
+};
+
+enum class ArchiveAssetKind {
+	Raw,
+	Pic,
+	Bup,
+	Txa,
+	Msk
+};
+
+// Decoded result of an asynchronous load; the alternative matches the requested ArchiveAssetKind.
+typedef std::variant<std::vector<unsigned char>, Pic, Bup, Txa, Msk> ArchiveAsset;
+
+// Handle to an asynchronous load. Copies share the same request.
+class ArchiveRequest {
+public:
+	bool valid() const {
+		return state_ != nullptr;
+	}
+
+	// Requests that have not started yet are skipped; get() then throws.
+	void cancel() {
+		if (state_) {
+			state_->cancelled = true;
+		}
+	}
+
+	bool ready() const {
+		return state_ && state_->future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+
+	// Waits for the result, rethrowing any error from the worker.
+	const ArchiveAsset &get() const {
+		return *state_->future.get();
+	}
+private:
+	friend class Archive;
+
+	struct State {
+		std::atomic<bool> cancelled { false };
+		std::shared_future<std::shared_ptr<ArchiveAsset>> future;
+	};
+	std::shared_ptr<State> state_;
+};
+
 class Archive {
 public:
-	void open(const std::string &path);
+	void open(const std::string &path, ArchiveBackend backend = ArchiveBackend::Mapped);
 	void explore();
+
+	// Looks up a path once; the handle can be passed to any of the getters below. Throws if the path is unknown.
+	ArchiveHandle resolve(const std::string &path) const;
+	bool exists(const std::string &path) const;
+	// The ROM's own entries; overlay files are not listed here.
+	const ArchiveIndex &index() const {
+		return index_;
+	}
+
+	// Loose files under directory shadow ROM entries with the same path, e.g. directory/main.snr replaces main.snr.
+	// Directories added later take precedence. Both calls drop every cached and prefetched asset, since handles to
+	// overlay files are renumbered.
+	void addOverlay(const std::string &directory);
+	void clearOverlays();
+
 	std::vector<unsigned char> read(const std::string &path);
-	Txa getTxa(const std::string &path);
-	Bup getBup(const std::string &path);
-	Pic getPic(const std::string &path);
-	Msk getMsk(const std::string &path);
+	std::vector<unsigned char> read(ArchiveHandle handle);
+	ArchiveBuffer fetch(const std::string &path);
+	ArchiveBuffer fetch(ArchiveHandle handle);
+	// Reads an entry incrementally without loading all of it, e.g. for audio. Only valid while the archive is open.
+	ArchiveStream openStream(const std::string &path);
+	ArchiveStream openStream(ArchiveHandle handle);
+	// The decoded images are shared with the memory cache, so a hit hands out the cached image without copying it.
+	std::shared_ptr<const Txa> getTxa(const std::string &path);
+	std::shared_ptr<const Txa> getTxa(ArchiveHandle handle);
+	std::shared_ptr<const Bup> getBup(const std::string &path);
+	std::shared_ptr<const Bup> getBup(ArchiveHandle handle);
+	// Composites a single pose. The decoded base image is cached, so switching poses only decodes the expression.
+	std::shared_ptr<const Bup::SubEntry> getBupPose(const std::string &path, const std::string &pose);
+	std::shared_ptr<const Bup::SubEntry> getBupPose(ArchiveHandle handle, const std::string &pose);
+	std::shared_ptr<const Pic> getPic(const std::string &path);
+	std::shared_ptr<const Pic> getPic(ArchiveHandle handle);
+	// Receives a PIC's dimensions and returns where to decode it: height rows of width * 4 bytes, stride bytes apart.
+	typedef std::function<unsigned char *(uint32_t width, uint32_t height, size_t &stride)> PicSurface;
+	// Decodes straight into caller-owned memory, such as a mapped upload buffer, instead of a new Pic.
+	void getPic(const std::string &path, const PicSurface &surface);
+	void getPic(ArchiveHandle handle, const PicSurface &surface);
+	std::shared_ptr<const Msk> getMsk(const std::string &path);
+	std::shared_ptr<const Msk> getMsk(ArchiveHandle handle);
 	Png getPng(const std::string &path);
+	Png getPng(ArchiveHandle handle);
+
+	// Reads and decodes on the worker pool.
+	ArchiveRequest loadAsync(const std::string &path, ArchiveAssetKind kind);
+	// Warms an asset so the next matching getter returns without decoding. Best effort: unknown paths are ignored and
+	// nothing is queued when the pool is saturated.
+	void prefetch(const std::string &path, ArchiveAssetKind kind);
+	// Infers the kind from each path's extension.
+	void prefetch(const std::vector<std::string> &paths);
+	void cancelPrefetch(const std::string &path, ArchiveAssetKind kind);
+	// Decodes a BUP's base image into the pose cache ahead of getBupPose for pose. Skipped if the disk cache has the pose.
+	void prefetchBupBase(const std::string &path, const std::string &pose);
+	void cancelPrefetches();
+
+	// Threads that decode the chunks of one image, the calling thread included. 0, the default, uses the whole worker
+	// pool; 1 decodes on the calling thread alone. Anything else also sizes the worker pool, so call it before the first
+	// load.
+	void setDecodeThreads(size_t threads) {
+		decodeThreads_ = threads;
+	}
+
+	// Keeps up to budget bytes of decoded images in memory so the getters can return recently used assets without
+	// decoding them again. 0, the default, turns the cache off.
+	void setMemoryCacheBudget(uint64_t budget);
+	ImageCacheStats memoryCacheStats();
+
+	// Keeps decoded images in files under directory so later runs can skip decoding them. Off until this is called.
+	void enableImageCache(const std::string &directory, uint64_t budget);
+	bool imageCacheEnabled() const {
+		return imageCache_.isOpen();
+	}
+	// variant is the BUP pose, or empty for a PIC. Returns an invalid image on a miss or when the cache is off.
+	CachedImage findCachedImage(const std::string &path, const std::string &variant);
+	// Writes in the background, keeping pixels alive until then; skipped if the pool is busy.
+	void storeCachedImage(const std::string &path, const std::string &variant, uint32_t width, uint32_t height, std::shared_ptr<const std::vector<unsigned char>> pixels);
+	// Records every read and decode from here on, with its timing, until stopTrace. Meant for profiling sessions; while
+	// off, the getters only pay for one relaxed atomic load.
+	void startTrace();
+	// Saves the recording to path and stops. Returns the number of events written, or 0 if nothing was recording.
+	size_t stopTrace(const std::string &path);
+
 	void extractMsk(const std::string &path);
-	void writeImage(const std::string &path, const unsigned char *data, int width, int height, int scanline, int bpp=4);
+	// Writes BGRA (bpp 4) or single-channel (bpp 1) pixels as a PNG. Returns false if the file could not be written.
+	bool writeImage(const std::string &path, const unsigned char *data, int width, int height, int scanline, int bpp=4);
 private:
-	ArchiveEntry &get(const std::string &path);
-	void scan(uint64_t startOffset, ArchiveEntry &current, BinaryReader &br);
+	struct BupBase;
+
+	// Times one public call into the trace, if one is recording. Calls made from inside another traced call on the same
+	// thread, such as the fetch in getPic, are folded into the outer one.
+	class TraceScope {
+	public:
+		TraceScope(Archive &archive, ArchiveHandle handle, ArchiveTraceOp op, std::string_view variant = std::string_view());
+		~TraceScope();
+		TraceScope(const TraceScope &other) = delete;
+		TraceScope &operator=(const TraceScope &other) = delete;
+	private:
+		Archive &archive_;
+		std::shared_ptr<ArchiveTrace> trace_;
+		ArchiveHandle handle_;
+		ArchiveTraceOp op_;
+		std::string_view variant_;
+		ArchiveTrace::TimePoint start_;
+		bool counted_ = false;
+	};
+
+	ArchiveIndexKey indexKey(const std::string &path);
+	// Overlay files are numbered after the ROM's entries.
+	ArchiveHandle find(std::string_view path) const;
+	bool isOverlay(ArchiveHandle handle) const {
+		return handle.index >= index_.count();
+	}
+	ArchiveHandle overlayHandle(ArchiveHandle handle) const {
+		ArchiveHandle overlay;
+		overlay.index = handle.index - static_cast<uint32_t>(index_.count());
+		return overlay;
+	}
+	std::string_view entryPath(ArchiveHandle handle) const;
+	std::string_view entryName(ArchiveHandle handle) const;
+	void dropCachedAssets();
+	ImageCacheKey imageCacheKey(ArchiveHandle handle);
+	ThreadPool &pool();
+	// Runs fn(0) .. fn(count - 1) for the chunks of one image, on as many threads as setDecodeThreads allows.
+	void decodeChunks(size_t count, const std::function<void(size_t)> &fn);
+	ArchiveRequest startRequest(ArchiveHandle handle, ArchiveAssetKind kind, bool required);
+	ArchiveAsset loadAsset(ArchiveHandle handle, ArchiveAssetKind kind);
+	std::shared_ptr<ArchiveAsset> takePrefetched(ArchiveHandle handle, ArchiveAssetKind kind);
+	// Returns decode()'s result through the memory cache. variant separates several images of one entry, such as poses.
+	template <typename T, typename Decode>
+	std::shared_ptr<const T> cached(ArchiveHandle handle, ArchiveAssetKind kind, const std::string &variant, Decode decode);
+	Txa decodeTxa(ArchiveHandle handle);
+	Bup decodeBup(ArchiveHandle handle);
+	Pic decodePic(ArchiveHandle handle);
+	void decodePic(ArchiveHandle handle, const PicSurface &surface);
+	Msk decodeMsk(ArchiveHandle handle);
+	std::shared_ptr<const BupBase> bupBase(ArchiveHandle handle);
+	std::shared_ptr<const BupBase> decodeBupBase(ArchiveHandle handle);
+	void composeBupPose(const BupBase &base, const BupChunk &chunk, const ArchiveBuffer &file, Bup::SubEntry &subentry);
+	// Decompresses a delta-coded image one row at a time and reconstructs each row while it is still in cache. Encoded
+	// rows are padded to a multiple of 4 pixels; only the first rowSize bytes of each are written. destination is never
+	// read, so it can be a write-only mapping.
+	static void decodeRows(Span<const unsigned char> encoded, uint32_t width, uint32_t height, unsigned char *destination, size_t stride, size_t rowSize);
+	// Reads raw ROM bytes from whichever backend is open.
+	void readAt(uint64_t offset, void *buffer, size_t size);
+	void scan(uint64_t startOffset, const std::string &folder);
+	void buildTree();
 	void explore(ArchiveEntry &folder);
 
-	uint32_t decode(const unsigned char *buffer, size_t bufferSize, unsigned char *output);
-	void dpcm(unsigned char *source, unsigned char *destination, int width, int height, int scanline);
 	void extractTxa(ArchiveEntry &txa);
 	void extractBup(ArchiveEntry &bup);
 	void extractPic(ArchiveEntry &pic);
 
+	// Only built when the explorer needs it; lookups go through index_.
 	ArchiveEntry root_;
+	bool treeBuilt_ = false;
+	ArchiveIndex index_;
+	// The open ROM's size, timestamp and header hash, also mixed into disk cache keys.
+	ArchiveIndexKey romKey_;
+	ArchiveOverlay overlay_;
+
+	ArchiveBackend backend_ = ArchiveBackend::Stream;
+	File file_;
+	MappedFile map_;
+
+	struct Prefetch {
+		ArchiveRequest request;
+		uint64_t sequence;
+	};
+	static constexpr size_t MaxPrefetches = 64;
+	std::mutex prefetchMutex_;
+	std::unordered_map<uint64_t, Prefetch> prefetches_;
+	// Key and sequence number of recent prefetches, oldest first. Entries may already have been taken.
+	std::deque<std::pair<uint64_t, uint64_t>> prefetchOrder_;
+	uint64_t prefetchSequence_ = 0;
+
+	static constexpr size_t MaxBupBases = 8;
+	std::mutex bupMutex_;
+	std::list<std::pair<uint32_t, std::shared_future<std::shared_ptr<const BupBase>>>> bupBases_;
+
+	ImageDiskCache imageCache_;
+	ImageCache memoryCache_;
 
-	std::mutex mutex_;
+	std::atomic<bool> tracing_ { false };
+	std::mutex traceMutex_;
+	std::shared_ptr<ArchiveTrace> trace_;
 
-	std::ifstream ifs_;
+	size_t decodeThreads_ = 0;
+	// Declared last so the workers are joined before anything they read from is torn down.
+	std::once_flag poolOnce_;
+	std::unique_ptr<ThreadPool> pool_;
 };
\ No newline at end of file
@@ -0,0 +1,263 @@
+#include "archiveindex.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+struct ArchiveIndexFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t romSize;
+	uint64_t romModified;
+	uint64_t headerHash;
+	uint32_t count;
+	uint32_t slotCount;
+	uint32_t namesSize;
+	uint32_t padding;
+};
+
+const char ArchiveIndexMagic[4] = { 'U', 'I', 'D', 'X' };
+const uint32_t ArchiveIndexVersion = 1;
+
+// Walks a path the way the index stores it: lowercase, with leading, trailing and repeated slashes dropped.
+class NormalizedPath {
+public:
+	explicit NormalizedPath(std::string_view path) : path_(path) {}
+
+	bool next(char &c) {
+		bool pendingSlash = false;
+		while (pos_ < path_.size()) {
+			char current = path_[pos_++];
+			if (current == '/') {
+				pendingSlash = emitted_;
+				continue;
+			}
+			if (pendingSlash) {
+				// Emit the separator now and the character on the following call.
+				--pos_;
+				c = '/';
+				return true;
+			}
+			emitted_ = true;
+			c = (current >= 'A' && current <= 'Z') ? current - 'A' + 'a' : current;
+			return true;
+		}
+		return false;
+	}
+private:
+	std::string_view path_;
+	size_t pos_ = 0;
+	bool emitted_ = false;
+};
+
+}
+
+void ArchiveIndex::clear() {
+	offsetStore_.clear();
+	sizeStore_.clear();
+	nameOffsetStore_.clear();
+	hashStore_.clear();
+	slotStore_.clear();
+	nameStore_.clear();
+	cache_.close();
+	bind();
+}
+
+void ArchiveIndex::add(std::string_view path, uint64_t offset, uint32_t size) {
+	offsetStore_.push_back(offset);
+	sizeStore_.push_back(size);
+	nameOffsetStore_.push_back(static_cast<uint32_t>(nameStore_.size()));
+	hashStore_.push_back(hash(path));
+	NormalizedPath normalized(path);
+	char c;
+	while (normalized.next(c)) {
+		nameStore_.push_back(c);
+	}
+	nameStore_.push_back('\0');
+}
+
+void ArchiveIndex::build() {
+	size_t capacity = 16;
+	while (capacity < offsetStore_.size() * 2) {
+		capacity <<= 1;
+	}
+	slotStore_.assign(capacity, 0);
+	auto mask = capacity - 1;
+	for (uint32_t i = 0; i < offsetStore_.size(); ++i) {
+		auto slot = hashStore_[i] & mask;
+		while (slotStore_[slot] != 0) {
+			slot = (slot + 1) & mask;
+		}
+		slotStore_[slot] = i + 1;
+	}
+	bind();
+}
+
+void ArchiveIndex::bind() {
+	count_ = offsetStore_.size();
+	offsets_ = offsetStore_.data();
+	sizes_ = sizeStore_.data();
+	nameOffsets_ = nameOffsetStore_.data();
+	hashes_ = hashStore_.data();
+	names_ = nameStore_.data();
+	slots_ = slotStore_.data();
+	slotCount_ = slotStore_.size();
+}
+
+bool ArchiveIndex::load(const std::string &path, const ArchiveIndexKey &key) {
+	clear();
+	try {
+		cache_.open(path);
+	} catch (const std::exception &) {
+		return false;
+	}
+
+	auto *data = cache_.data();
+	auto size = cache_.size();
+	ArchiveIndexFileHeader header;
+	if (size < sizeof(header)) {
+		cache_.close();
+		return false;
+	}
+	memcpy(&header, data, sizeof(header));
+
+	uint64_t offsetsStart = sizeof(header);
+	uint64_t sizesStart = offsetsStart + uint64_t(header.count) * sizeof(uint64_t);
+	uint64_t nameOffsetsStart = sizesStart + uint64_t(header.count) * sizeof(uint32_t);
+	uint64_t hashesStart = nameOffsetsStart + uint64_t(header.count) * sizeof(uint32_t);
+	uint64_t slotsStart = hashesStart + uint64_t(header.count) * sizeof(uint32_t);
+	uint64_t namesStart = slotsStart + uint64_t(header.slotCount) * sizeof(uint32_t);
+	uint64_t end = namesStart + header.namesSize;
+
+	bool valid = memcmp(header.magic, ArchiveIndexMagic, sizeof(ArchiveIndexMagic)) == 0
+		&& header.version == ArchiveIndexVersion
+		&& header.romSize == key.romSize
+		&& header.romModified == key.romModified
+		&& header.headerHash == key.headerHash
+		&& header.slotCount >= 16 && (header.slotCount & (header.slotCount - 1)) == 0
+		&& header.slotCount >= uint64_t(header.count) * 2
+		&& end == size
+		&& (header.namesSize == 0 || data[end - 1] == '\0');
+	if (!valid) {
+		cache_.close();
+		return false;
+	}
+
+	count_ = header.count;
+	offsets_ = reinterpret_cast<const uint64_t *>(data + offsetsStart);
+	sizes_ = reinterpret_cast<const uint32_t *>(data + sizesStart);
+	nameOffsets_ = reinterpret_cast<const uint32_t *>(data + nameOffsetsStart);
+	hashes_ = reinterpret_cast<const uint32_t *>(data + hashesStart);
+	slots_ = reinterpret_cast<const uint32_t *>(data + slotsStart);
+	slotCount_ = header.slotCount;
+	names_ = reinterpret_cast<const char *>(data + namesStart);
+
+	// Corrupt tables could otherwise index out of the mapping or make find() probe forever.
+	size_t usedSlots = 0;
+	for (size_t i = 0; i < slotCount_; ++i) {
+		if (slots_[i] > count_) {
+			clear();
+			return false;
+		}
+		usedSlots += slots_[i] != 0;
+	}
+	for (size_t i = 0; i < count_; ++i) {
+		if (nameOffsets_[i] >= header.namesSize) {
+			clear();
+			return false;
+		}
+	}
+	if (usedSlots > count_) {
+		clear();
+		return false;
+	}
+	return true;
+}
+
+void ArchiveIndex::save(const std::string &path, const ArchiveIndexKey &key) const {
+	ArchiveIndexFileHeader header = {};
+	memcpy(header.magic, ArchiveIndexMagic, sizeof(ArchiveIndexMagic));
+	header.version = ArchiveIndexVersion;
+	header.romSize = key.romSize;
+	header.romModified = key.romModified;
+	header.headerHash = key.headerHash;
+	header.count = static_cast<uint32_t>(count_);
+	header.slotCount = static_cast<uint32_t>(slotCount_);
+	header.namesSize = count_ ? nameOffsets_[count_ - 1] + static_cast<uint32_t>(this->path({ static_cast<uint32_t>(count_ - 1) }).size()) + 1 : 0;
+
+	// Write to a temporary file first so a crash mid-save never leaves a truncated cache behind.
+	auto tempPath = path + ".tmp";
+	{
+		std::ofstream ofs(tempPath, std::ios_base::binary | std::ios_base::trunc);
+		if (!ofs) {
+			throw std::runtime_error("Unable to write archive index '" + tempPath + "'.");
+		}
+		ofs.write((const char *)&header, sizeof(header));
+		ofs.write((const char *)offsets_, count_ * sizeof(uint64_t));
+		ofs.write((const char *)sizes_, count_ * sizeof(uint32_t));
+		ofs.write((const char *)nameOffsets_, count_ * sizeof(uint32_t));
+		ofs.write((const char *)hashes_, count_ * sizeof(uint32_t));
+		ofs.write((const char *)slots_, slotCount_ * sizeof(uint32_t));
+		ofs.write(names_, header.namesSize);
+		if (!ofs) {
+			throw std::runtime_error("Unable to write archive index '" + tempPath + "'.");
+		}
+	}
+	std::remove(path.c_str());
+	if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+		std::remove(tempPath.c_str());
+		throw std::runtime_error("Unable to replace archive index '" + path + "'.");
+	}
+}
+
+ArchiveHandle ArchiveIndex::find(std::string_view path) const {
+	if (slotCount_ == 0) {
+		return ArchiveHandle();
+	}
+	auto h = hash(path);
+	auto mask = slotCount_ - 1;
+	for (auto slot = h & mask; slots_[slot] != 0; slot = (slot + 1) & mask) {
+		auto index = slots_[slot] - 1;
+		if (hashes_[index] == h && equals(this->path({ index }), path)) {
+			return { index };
+		}
+	}
+	return ArchiveHandle();
+}
+
+std::string_view ArchiveIndex::path(ArchiveHandle handle) const {
+	return std::string_view(names_ + nameOffsets_[handle.index]);
+}
+
+std::string_view ArchiveIndex::name(ArchiveHandle handle) const {
+	auto full = path(handle);
+	auto slash = full.rfind('/');
+	return slash == std::string_view::npos ? full : full.substr(slash + 1);
+}
+
+uint32_t ArchiveIndex::hash(std::string_view path) {
+	// FNV-1a over the normalized characters.
+	uint32_t h = 2166136261u;
+	NormalizedPath normalized(path);
+	char c;
+	while (normalized.next(c)) {
+		h ^= static_cast<unsigned char>(c);
+		h *= 16777619u;
+	}
+	return h;
+}
+
+bool ArchiveIndex::equals(std::string_view normalized, std::string_view path) {
+	NormalizedPath other(path);
+	size_t i = 0;
+	char c;
+	while (other.next(c)) {
+		if (i >= normalized.size() || normalized[i++] != c) {
+			return false;
+		}
+	}
+	return i == normalized.size();
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../util/file.h"
+
+// Resolved reference to a file in an archive. Resolving a path once and keeping the handle skips the hash lookup on
+// later reads.
+struct ArchiveHandle {
+	static constexpr uint32_t Invalid = 0xffffffff;
+
+	uint32_t index = Invalid;
+
+	bool valid() const {
+		return index != Invalid;
+	}
+};
+
+// Identifies the ROM an index was built from. A cached index is only reused when all three fields match.
+struct ArchiveIndexKey {
+	uint64_t romSize = 0;
+	uint64_t romModified = 0;
+	uint64_t headerHash = 0;
+};
+
+// Flat table of every file in an archive, looked up by full path through a single open-addressing hash table.
+// Paths are normalized while hashing (lowercased, empty segments dropped), so "BMP//Back1.pic" and "bmp/back1.pic"
+// resolve to the same entry without building a temporary string.
+//
+// The tables can also be saved to a sidecar file and mapped back in on a later run, in which case the index reads
+// straight out of the mapping.
+class ArchiveIndex {
+public:
+	ArchiveIndex() = default;
+	ArchiveIndex(const ArchiveIndex &other) = delete;
+	ArchiveIndex &operator=(const ArchiveIndex &other) = delete;
+
+	void clear();
+
+	void add(std::string_view path, uint64_t offset, uint32_t size);
+	void build();
+
+	// Maps a previously saved index. Returns false, leaving the index empty, if the file is missing, corrupt or was
+	// built for a different ROM.
+	bool load(const std::string &path, const ArchiveIndexKey &key);
+	void save(const std::string &path, const ArchiveIndexKey &key) const;
+
+	ArchiveHandle find(std::string_view path) const;
+
+	size_t count() const {
+		return count_;
+	}
+
+	uint64_t offset(ArchiveHandle handle) const {
+		return offsets_[handle.index];
+	}
+
+	uint32_t size(ArchiveHandle handle) const {
+		return sizes_[handle.index];
+	}
+
+	std::string_view path(ArchiveHandle handle) const;
+	std::string_view name(ArchiveHandle handle) const;
+private:
+	static uint32_t hash(std::string_view path);
+	static bool equals(std::string_view normalized, std::string_view path);
+
+	void bind();
+
+	// Storage while building; empty when the index was loaded from a cache file.
+	std::vector<uint64_t> offsetStore_;
+	std::vector<uint32_t> sizeStore_;
+	std::vector<uint32_t> nameOffsetStore_;
+	std::vector<uint32_t> hashStore_;
+	std::vector<uint32_t> slotStore_;
+	std::string nameStore_;
+
+	MappedFile cache_;
+
+	// Views into either the stores above or the mapped cache file.
+	size_t count_ = 0;
+	const uint64_t *offsets_ = nullptr;
+	const uint32_t *sizes_ = nullptr;
+	const uint32_t *nameOffsets_ = nullptr;
+	const uint32_t *hashes_ = nullptr;
+	const char *names_ = nullptr;
+
+	// Entry index + 1 per slot, 0 for empty. Always a power of two in size.
+	const uint32_t *slots_ = nullptr;
+	size_t slotCount_ = 0;
+};
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include "archiveoverlay.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <unordered_set>
+
+void ArchiveOverlay::add(const std::string &directory) {
+	std::error_code error;
+	if (!std::filesystem::is_directory(directory, error)) {
+		throw std::runtime_error("Overlay directory '" + directory + "' does not exist.");
+	}
+	directories_.push_back(directory);
+	rebuild();
+}
+
+void ArchiveOverlay::clear() {
+	directories_.clear();
+	rebuild();
+}
+
+ArchiveHandle ArchiveOverlay::find(std::string_view path) const {
+	if (files_.empty()) {
+		return ArchiveHandle();
+	}
+	return index_.find(path);
+}
+
+MappedFile ArchiveOverlay::open(ArchiveHandle handle) const {
+	MappedFile mapping;
+	std::error_code error;
+	if (std::filesystem::file_size(files_[handle.index], error) == 0 && !error) {
+		return mapping;
+	}
+	mapping.open(files_[handle.index]);
+	return mapping;
+}
+
+void ArchiveOverlay::rebuild() {
+	index_.clear();
+	files_.clear();
+
+	// Walk the newest directory first so the first file seen for a path is the one that wins.
+	std::unordered_set<std::string> seen;
+	for (auto dir = directories_.rbegin(); dir != directories_.rend(); ++dir) {
+		std::error_code error;
+		std::filesystem::recursive_directory_iterator iter(*dir, error), end;
+		for (; !error && iter != end; iter.increment(error)) {
+			std::error_code entryError;
+			if (!iter->is_regular_file(entryError)) {
+				continue;
+			}
+			auto relative = iter->path().lexically_relative(*dir).generic_string();
+			auto key = relative;
+			std::transform(key.begin(), key.end(), key.begin(), [](char c) {
+				return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+			});
+			if (!seen.insert(key).second) {
+				continue;
+			}
+			auto size = iter->file_size(entryError);
+			if (entryError || size > 0xffffffff) {
+				continue;
+			}
+			index_.add(relative, 0, static_cast<uint32_t>(size));
+			files_.push_back(iter->path().string());
+		}
+	}
+	index_.build();
+}
\ No newline at end of file
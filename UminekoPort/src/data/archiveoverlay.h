@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "archiveindex.h"
+#include "../util/file.h"
+
+// Loose files that shadow archive entries with the same path, so an edited script or font can be tried without
+// rewriting the ROM. Every directory is walked once when it is added and merged into a single index; the files
+// themselves are mapped fresh on each open, so edits are picked up the next time an asset is loaded.
+class ArchiveOverlay {
+public:
+	// Directories added later take precedence over earlier ones. Throws if directory does not exist.
+	void add(const std::string &directory);
+	void clear();
+
+	bool empty() const {
+		return files_.empty();
+	}
+
+	size_t count() const {
+		return files_.size();
+	}
+
+	// Returns an invalid handle if no overlay has the path.
+	ArchiveHandle find(std::string_view path) const;
+
+	std::string_view path(ArchiveHandle handle) const {
+		return index_.path(handle);
+	}
+
+	std::string_view name(ArchiveHandle handle) const {
+		return index_.name(handle);
+	}
+
+	// Location of the file on disk.
+	const std::string &file(ArchiveHandle handle) const {
+		return files_[handle.index];
+	}
+
+	// Maps the file as it is now. An empty file gives a closed mapping.
+	MappedFile open(ArchiveHandle handle) const;
+private:
+	void rebuild();
+
+	std::vector<std::string> directories_;
+	ArchiveIndex index_;
+	std::vector<std::string> files_;
+};
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "archivestream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+ArchiveStream::ArchiveStream(const File &file, uint64_t offset, uint64_t size) : file_(&file), offset_(offset), size_(size) {
+	if (offset > file.size() || size > file.size() - offset) {
+		throw std::out_of_range("Archive stream out of range.");
+	}
+}
+
+ArchiveStream::ArchiveStream(Span<const unsigned char> view) : view_(view), size_(view.size()) {
+
+}
+
+ArchiveStream::ArchiveStream(MappedFile &&file) : mapping_(std::move(file)), view_(mapping_.data(), mapping_.size()), size_(mapping_.size()) {
+
+}
+
+size_t ArchiveStream::read(void *buffer, size_t size) {
+	auto *output = static_cast<unsigned char *>(buffer);
+	size = static_cast<size_t>(std::min<uint64_t>(size, size_ - std::min(position_, size_)));
+
+	if (!file_) {
+		if (size) {
+			memcpy(output, view_.data() + position_, size);
+		}
+		position_ += size;
+		return size;
+	}
+
+	size_t done = 0;
+	while (done < size) {
+		if (position_ >= bufferStart_ && position_ < bufferStart_ + bufferSize_) {
+			auto count = std::min(size - done, static_cast<size_t>(bufferStart_ + bufferSize_ - position_));
+			memcpy(output + done, buffer_.data() + (position_ - bufferStart_), count);
+			done += count;
+			position_ += count;
+			continue;
+		}
+
+		// Large reads skip the buffer rather than copying through it.
+		auto remaining = size - done;
+		if (remaining >= ReadAhead) {
+			file_->readAt(offset_ + position_, output + done, remaining);
+			done += remaining;
+			position_ += remaining;
+			break;
+		}
+
+		buffer_.resize(ReadAhead);
+		bufferStart_ = position_;
+		bufferSize_ = static_cast<size_t>(std::min<uint64_t>(ReadAhead, size_ - position_));
+		file_->readAt(offset_ + bufferStart_, buffer_.data(), bufferSize_);
+	}
+	return done;
+}
+
+void ArchiveStream::seek(uint64_t position) {
+	if (position > size_) {
+		throw std::out_of_range("Archive stream seek past the end.");
+	}
+	position_ = position;
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "../util/file.h"
+#include "../util/span.h"
+
+// Seekable reader over one archive entry, for consumers that decode incrementally. Reads from a file go through a small
+// read-ahead buffer, so memory use does not grow with the entry; reads from a mapped archive copy straight from the view.
+class ArchiveStream {
+public:
+	static constexpr size_t ReadAhead = 64 * 1024;
+
+	ArchiveStream() = default;
+	// The file must outlive the stream. Several streams can read the same file at once.
+	ArchiveStream(const File &file, uint64_t offset, uint64_t size);
+	explicit ArchiveStream(Span<const unsigned char> view);
+	// Reads a whole mapped file, keeping the mapping alive for as long as the stream.
+	explicit ArchiveStream(MappedFile &&file);
+
+	// Returns the number of bytes read, which is less than size only at the end of the entry.
+	size_t read(void *buffer, size_t size);
+	// Positions are relative to the start of the entry. Throws if position is past the end.
+	void seek(uint64_t position);
+
+	uint64_t tell() const {
+		return position_;
+	}
+
+	uint64_t size() const {
+		return size_;
+	}
+
+	bool eof() const {
+		return position_ >= size_;
+	}
+private:
+	const File *file_ = nullptr;
+	MappedFile mapping_;
+	Span<const unsigned char> view_;
+	uint64_t offset_ = 0, size_ = 0, position_ = 0;
+
+	std::vector<unsigned char> buffer_;
+	// Entry position of buffer_[0]; only the first bufferSize_ bytes are valid.
+	uint64_t bufferStart_ = 0;
+	size_t bufferSize_ = 0;
+};
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "archivetrace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace {
+
+struct ArchiveTraceFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t eventCount;
+	uint32_t stringCount;
+	uint32_t threadCount;
+	uint32_t padding;
+};
+
+const char ArchiveTraceMagic[4] = { 'U', 'T', 'R', 'C' };
+const uint32_t ArchiveTraceVersion = 1;
+// Archive paths are far shorter; anything longer means the file is corrupt.
+const uint32_t MaxStringLength = 1 << 16;
+
+static_assert(sizeof(ArchiveTraceEvent) == 40, "Trace events are written as is.");
+
+}
+
+ArchiveTrace::ArchiveTrace() : start_(std::chrono::steady_clock::now()) {}
+
+void ArchiveTrace::record(ArchiveTraceOp op, std::string_view path, std::string_view variant, uint64_t offset, uint32_t size, TimePoint start, TimePoint end) {
+	ArchiveTraceEvent event = {};
+	event.timestamp = static_cast<uint64_t>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(start - start_).count()));
+	event.offset = offset;
+	event.size = size;
+	auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	event.duration = static_cast<uint32_t>(std::clamp<int64_t>(duration, 0, 0xffffffff));
+	event.op = op;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	event.path = intern(path);
+	event.variant = variant.empty() ? ArchiveTraceEvent::NoVariant : intern(variant);
+	auto thread = threads_.emplace(std::this_thread::get_id(), static_cast<uint16_t>(threadCount_));
+	threadCount_ += thread.second;
+	event.thread = thread.first->second;
+	events_.push_back(event);
+}
+
+uint32_t ArchiveTrace::intern(std::string_view string) {
+	auto it = stringIndices_.find(std::string(string));
+	if (it != stringIndices_.end()) {
+		return it->second;
+	}
+	auto index = static_cast<uint32_t>(strings_.size());
+	strings_.emplace_back(string);
+	stringIndices_.emplace(strings_.back(), index);
+	return index;
+}
+
+size_t ArchiveTrace::save(const std::string &path) const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	ArchiveTraceFileHeader header = {};
+	memcpy(header.magic, ArchiveTraceMagic, sizeof(ArchiveTraceMagic));
+	header.version = ArchiveTraceVersion;
+	header.eventCount = static_cast<uint32_t>(events_.size());
+	header.stringCount = static_cast<uint32_t>(strings_.size());
+	header.threadCount = static_cast<uint32_t>(threadCount_);
+
+	std::ofstream ofs(path, std::ios_base::binary | std::ios_base::trunc);
+	if (!ofs) {
+		throw std::runtime_error("Unable to write archive trace '" + path + "'.");
+	}
+	ofs.write((const char *)&header, sizeof(header));
+	for (const auto &string : strings_) {
+		uint32_t length = static_cast<uint32_t>(string.size());
+		ofs.write((const char *)&length, sizeof(length));
+		ofs.write(string.data(), length);
+	}
+	ofs.write((const char *)events_.data(), events_.size() * sizeof(ArchiveTraceEvent));
+	if (!ofs) {
+		throw std::runtime_error("Unable to write archive trace '" + path + "'.");
+	}
+	return events_.size();
+}
+
+void ArchiveTrace::load(const std::string &path) {
+	std::ifstream ifs(path, std::ios_base::binary);
+	if (!ifs) {
+		throw std::runtime_error("Unable to open archive trace '" + path + "'.");
+	}
+	ArchiveTraceFileHeader header;
+	if (!ifs.read((char *)&header, sizeof(header)) || memcmp(header.magic, ArchiveTraceMagic, sizeof(ArchiveTraceMagic)) != 0) {
+		throw std::runtime_error("'" + path + "' is not an archive trace.");
+	}
+	if (header.version != ArchiveTraceVersion) {
+		throw std::runtime_error("Archive trace '" + path + "' has unsupported version " + std::to_string(header.version) + ".");
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	strings_.clear();
+	stringIndices_.clear();
+	threads_.clear();
+	threadCount_ = 0;
+	for (uint32_t i = 0; i < header.stringCount; ++i) {
+		uint32_t length = 0;
+		std::string value;
+		if (ifs.read((char *)&length, sizeof(length)) && length <= MaxStringLength) {
+			value.resize(length);
+			ifs.read(value.data(), length);
+		}
+		if (!ifs || length > MaxStringLength) {
+			throw std::runtime_error("Archive trace '" + path + "' is truncated.");
+		}
+		stringIndices_.emplace(value, i);
+		strings_.push_back(std::move(value));
+	}
+	auto eventsStart = ifs.tellg();
+	ifs.seekg(0, std::ios_base::end);
+	if (uint64_t(ifs.tellg() - eventsStart) != uint64_t(header.eventCount) * sizeof(ArchiveTraceEvent)) {
+		throw std::runtime_error("Archive trace '" + path + "' is truncated.");
+	}
+	ifs.seekg(eventsStart);
+	events_.resize(header.eventCount);
+	if (!ifs.read((char *)events_.data(), events_.size() * sizeof(ArchiveTraceEvent))) {
+		events_.clear();
+		throw std::runtime_error("Archive trace '" + path + "' is truncated.");
+	}
+	for (const auto &event : events_) {
+		if (event.path >= strings_.size() || (event.variant != ArchiveTraceEvent::NoVariant && event.variant >= strings_.size())
+			|| event.thread >= header.threadCount || event.op > ArchiveTraceOp::Png) {
+			events_.clear();
+			throw std::runtime_error("Archive trace '" + path + "' is corrupt.");
+		}
+	}
+	// The ids belonged to the recording process; only the count carries over.
+	threadCount_ = header.threadCount;
+	std::stable_sort(events_.begin(), events_.end(), [](const ArchiveTraceEvent &a, const ArchiveTraceEvent &b) {
+		return a.timestamp < b.timestamp;
+	});
+}
+
+bool ArchiveTrace::isTrace(const std::string &path) {
+	std::ifstream ifs(path, std::ios_base::binary);
+	char magic[4];
+	return ifs.read(magic, sizeof(magic)) && memcmp(magic, ArchiveTraceMagic, sizeof(magic)) == 0;
+}
+
+std::vector<std::string> ArchiveTrace::accessOrder() const {
+	std::vector<const ArchiveTraceEvent *> sorted;
+	sorted.reserve(events_.size());
+	for (const auto &event : events_) {
+		sorted.push_back(&event);
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](const ArchiveTraceEvent *a, const ArchiveTraceEvent *b) {
+		return a->timestamp < b->timestamp;
+	});
+
+	std::vector<std::string> order;
+	std::unordered_set<uint32_t> seen;
+	for (auto *event : sorted) {
+		if (seen.insert(event->path).second) {
+			order.push_back(strings_[event->path]);
+		}
+	}
+	return order;
+}
+
+const char *ArchiveTrace::opName(ArchiveTraceOp op) {
+	switch (op) {
+	case ArchiveTraceOp::Read: return "read";
+	case ArchiveTraceOp::Fetch: return "fetch";
+	case ArchiveTraceOp::Stream: return "stream";
+	case ArchiveTraceOp::Txa: return "txa";
+	case ArchiveTraceOp::Bup: return "bup";
+	case ArchiveTraceOp::BupPose: return "bup pose";
+	case ArchiveTraceOp::Pic: return "pic";
+	case ArchiveTraceOp::Msk: return "msk";
+	case ArchiveTraceOp::Png: return "png";
+	}
+	return "unknown";
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Public Archive call an event was recorded for.
+enum class ArchiveTraceOp : uint8_t {
+	Read,
+	Fetch,
+	Stream,
+	Txa,
+	Bup,
+	BupPose,
+	Pic,
+	Msk,
+	Png
+};
+
+struct ArchiveTraceEvent {
+	static constexpr uint32_t NoVariant = 0xffffffff;
+
+	// Nanoseconds from the start of the recording to the start of the call.
+	uint64_t timestamp;
+	// ROM offset of the entry, or ~0 for an overlay file.
+	uint64_t offset;
+	uint32_t size;
+	// Wall time spent in the call, decoding included, in nanoseconds. Saturates at about 4 seconds.
+	uint32_t duration;
+	// Indices into the trace's string table. variant is the BUP pose, or NoVariant.
+	uint32_t path;
+	uint32_t variant;
+	// Small per-trace number for the calling thread, in order of first appearance.
+	uint16_t thread;
+	ArchiveTraceOp op;
+	uint8_t padding;
+};
+
+// Log of every read and decode an Archive served, kept in memory while recording and saved as a compact binary file.
+// Paths are stored once in a string table, so an event costs a fixed 40 bytes. Recording is thread-safe.
+class ArchiveTrace {
+public:
+	typedef std::chrono::steady_clock::time_point TimePoint;
+
+	ArchiveTrace();
+	ArchiveTrace(const ArchiveTrace &other) = delete;
+	ArchiveTrace &operator=(const ArchiveTrace &other) = delete;
+
+	void record(ArchiveTraceOp op, std::string_view path, std::string_view variant, uint64_t offset, uint32_t size, TimePoint start, TimePoint end);
+
+	// Returns the number of events written.
+	size_t save(const std::string &path) const;
+	// Replaces the contents with a saved trace. Throws if the file is missing or is not a trace.
+	void load(const std::string &path);
+	// Cheap check for the trace signature, to tell a trace from other inputs.
+	static bool isTrace(const std::string &path);
+
+	// Sorted by timestamp once loaded; in completion order while recording.
+	const std::vector<ArchiveTraceEvent> &events() const {
+		return events_;
+	}
+
+	std::string_view string(uint32_t index) const {
+		return strings_[index];
+	}
+
+	size_t threadCount() const {
+		return threadCount_;
+	}
+
+	// Distinct paths in the order they were first used.
+	std::vector<std::string> accessOrder() const;
+
+	static const char *opName(ArchiveTraceOp op);
+private:
+	uint32_t intern(std::string_view string);
+
+	TimePoint start_;
+	mutable std::mutex mutex_;
+	std::vector<ArchiveTraceEvent> events_;
+	std::vector<std::string> strings_;
+	std::unordered_map<std::string, uint32_t> stringIndices_;
+	std::unordered_map<std::thread::id, uint16_t> threads_;
+	size_t threadCount_ = 0;
+};
\ No newline at end of file
@@ -1,97 +1,274 @@
 #include "compression.h"
 
-std::vector<uint8_t> DataCompression::decompress10_6(const uint8_t *compressedData, size_t compressedSize, size_t decompressedSize) {
-	std::vector<uint8_t> literals;
-	literals.resize(decompressedSize);
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// The back reference is a big-endian 16-bit value. With the top bit set the low 5 bits are the offset and the next 10
+// the count, otherwise the low 11 bits are the offset (biased by 32) and the top 5 the count. The offset is in 4-byte
+// pixels.
+inline void readPictureBackRef(const uint8_t *&readPtr, size_t &count, size_t &distance) {
+	unsigned backRef = (readPtr[0] << 8) | readPtr[1];
+	readPtr += 2;
+	size_t offset;
+	if (backRef & 0x8000) {
+		count = ((backRef >> 5) & 0x3ff) + 3;
+		offset = backRef & 0x1f;
+	} else {
+		count = (backRef >> 11) + 3;
+		offset = (backRef & 0x7ff) + 32;
+	}
+	distance = (offset + 1) * 4;
+}
+
+// The source may overlap the bytes being written, but [copyPtr, writePtr) always repeats with a period of distance,
+// so copying from a fixed start in blocks of everything written so far is equivalent to a byte-by-byte copy.
+// Repeating a single pixel (distance 4) takes log2(count) copies instead of count.
+inline uint8_t *copyBackRef(uint8_t *writePtr, size_t distance, size_t count) {
+	const uint8_t *copyPtr = writePtr - distance;
+	while (count > 0) {
+		auto block = std::min(count, static_cast<size_t>(writePtr - copyPtr));
+		memcpy(writePtr, copyPtr, block);
+		writePtr += block;
+		count -= block;
+	}
+	return writePtr;
+}
 
-	int bytesRead = 0, bytesWritten = 0;
-	uint8_t *litPtr = literals.data();
+}
+
+size_t DataCompression::decompressPicture(const uint8_t *compressedData, size_t compressedSize, uint8_t *output, size_t outputSize) {
 	const uint8_t *readPtr = compressedData;
+	const uint8_t *readEnd = compressedData + compressedSize;
+	uint8_t *writePtr = output;
+	uint8_t *writeEnd = output + outputSize;
 
-	while (bytesRead < compressedSize) {
+	while (readPtr < readEnd) {
 		auto ctrl = *(readPtr++);
-		++bytesRead;
-		/*std::cout << "[";
-		for (int i = 0; i < 8; ++i) {
-		std::cout << (int)((ctrl >> (7 - i)) & 1) << (i < 7 ? " " : "");
+
+		// Eight literals in a row is the common case for noisy images; copy them in one go.
+		if (ctrl == 0 && readEnd - readPtr >= 8 && writeEnd - writePtr >= 8) {
+			memcpy(writePtr, readPtr, 8);
+			readPtr += 8;
+			writePtr += 8;
+			continue;
 		}
-		std::cout << "] ";*/
-		for (int i = 0; i < 8; ++i) {
-			auto type = (ctrl >> i) & 0x1;
-			if (type == 0) { // Literal byte
-				++bytesRead;
-				if (bytesRead > compressedSize) break; // The compressed data can end prematurely
-				auto val = *(readPtr++);
-				*(litPtr++) = val;
-				++bytesWritten;
-			} else { // Copy from decompressed output
-				bytesRead += 2;
-				if (bytesRead > compressedSize) break; // The compressed data can end prematurely
-
-				// The back reference is a 16-bit value laid out like this, from most significant bit to least significant bit:
-				// AAAA AAAA BBCC CCCC
-				// The relative offset is then the 10-bit value "BBAAAAAA" + 3, and the number of bytes to copy is the 6-bit value "CCCCCC"
-				//const auto backRefLow = *(readPtr++);
-				//auto backRef = ((*(readPtr++) << 8) & 0xff00) | (backRefLow & 0xff);
-				auto backRef = *(uint16_t *)readPtr;
-				readPtr += 2;
-				int offset = (((backRef >> 8) & 0xff) | (((backRef >> 6) & 0x3) << 8)) + 1;
-				int count = (backRef & 0x3f) + 3;
-				int absOffset = bytesWritten - offset;
-				for (int i = 0; i < count; ++i) {
-					auto copyVal = literals[absOffset + i];
-					*(litPtr++) = copyVal;
-					++bytesWritten;
+
+		for (int i = 0; i < 8 && readPtr < readEnd; ++i) {
+			if (((ctrl >> i) & 0x1) == 0) { // Literal byte
+				if (writePtr == writeEnd) {
+					throw std::runtime_error("Compressed picture overflows its output.");
 				}
+				*(writePtr++) = *(readPtr++);
+				continue;
+			}
+
+			// Copy from decompressed output
+			if (readEnd - readPtr < 2) break; // The compressed data can end prematurely
+
+			size_t count, distance;
+			readPictureBackRef(readPtr, count, distance);
+			if (distance > static_cast<size_t>(writePtr - output)) {
+				throw std::runtime_error("Compressed picture refers before the start of its output.");
+			}
+			if (count > static_cast<size_t>(writeEnd - writePtr)) {
+				throw std::runtime_error("Compressed picture overflows its output.");
 			}
+
+			writePtr = copyBackRef(writePtr, distance, count);
+		}
+	}
+
+	return writePtr - output;
+}
+
+PictureDecompressor::PictureDecompressor(const uint8_t *compressedData, size_t compressedSize) :
+	readPtr_(compressedData), readEnd_(compressedData + compressedSize) {}
+
+const uint8_t *PictureDecompressor::next(size_t size) {
+	// Slide the window once the next block no longer fits, keeping as much history as a back reference can reach.
+	if (windowPos_ + size > window_.size()) {
+		auto keep = std::min(windowPos_, MaxDistance);
+		if (keep > 0) {
+			memmove(window_.data(), window_.data() + windowPos_ - keep, keep);
+		}
+		discarded_ += windowPos_ - keep;
+		windowPos_ = keep;
+		if (keep + size > window_.size()) {
+			window_.resize(keep + std::max(size * 8, WindowSize));
 		}
-		//std::cout << "\n";
 	}
 
+	auto *start = window_.data() + windowPos_;
+	auto *writePtr = start;
+	auto *writeEnd = start + size;
+	// Work on locals: stores through the byte pointers could alias the members and force them to be reloaded.
+	auto *readPtr = readPtr_;
+	auto ctrl = ctrl_;
+	auto bit = bit_;
+	auto pendingCount = pendingCount_;
+	auto pendingDistance = pendingDistance_;
+	auto history = discarded_ + windowPos_;
+	while (writePtr < writeEnd) {
+		if (pendingCount > 0) {
+			auto count = std::min(pendingCount, static_cast<size_t>(writeEnd - writePtr));
+			writePtr = copyBackRef(writePtr, pendingDistance, count);
+			pendingCount -= count;
+			continue;
+		}
+
+		if (readPtr == readEnd_) break;
+		if (bit == 8) {
+			ctrl = *(readPtr++);
+			bit = 0;
+			// Eight literals in a row is the common case for noisy images; copy them in one go.
+			if (ctrl == 0 && readEnd_ - readPtr >= 8 && writeEnd - writePtr >= 8) {
+				memcpy(writePtr, readPtr, 8);
+				readPtr += 8;
+				writePtr += 8;
+				bit = 8;
+			}
+			continue;
+		}
+
+		if (((ctrl >> bit++) & 0x1) == 0) { // Literal byte
+			*(writePtr++) = *(readPtr++);
+			continue;
+		}
+
+		// Copy from decompressed output
+		if (readEnd_ - readPtr < 2) { // The compressed data can end prematurely
+			readPtr = readEnd_;
+			break;
+		}
+		readPictureBackRef(readPtr, pendingCount, pendingDistance);
+		if (pendingDistance > history + (writePtr - start)) {
+			throw std::runtime_error("Compressed picture refers before the start of its output.");
+		}
+	}
+	readPtr_ = readPtr;
+	ctrl_ = ctrl;
+	bit_ = bit;
+	pendingCount_ = pendingCount;
+	pendingDistance_ = pendingDistance;
+
+	// Whatever the data does not cover reads as zero, as it would from a freshly allocated image.
+	memset(writePtr, 0, writeEnd - writePtr);
+	windowPos_ += size;
+	return start;
+}
+
+std::vector<uint8_t> DataCompression::decompress10_6(const uint8_t *compressedData, size_t compressedSize, size_t decompressedSize) {
+	std::vector<uint8_t> literals(decompressedSize);
+	decompress10_6(compressedData, compressedSize, literals.data(), literals.size());
 	return literals;
 }
 
+size_t DataCompression::decompress10_6(const uint8_t *compressedData, size_t compressedSize, uint8_t *output, size_t outputSize) {
+	LzssDecompressor decompressor(LzssDecompressor::Layout::Split10_6, output, outputSize);
+	decompressor.feed(compressedData, compressedSize);
+	return decompressor.written();
+}
+
 std::vector<uint8_t> DataCompression::decompress12_4(const uint8_t *compressedData, size_t compressedSize, size_t decompressedSize) {
-	std::vector<uint8_t> literals;
-	literals.resize(decompressedSize);
+	std::vector<uint8_t> literals(decompressedSize);
+	decompress12_4(compressedData, compressedSize, literals.data(), literals.size());
+	return literals;
+}
+
+size_t DataCompression::decompress12_4(const uint8_t *compressedData, size_t compressedSize, uint8_t *output, size_t outputSize) {
+	LzssDecompressor decompressor(LzssDecompressor::Layout::Split12_4, output, outputSize);
+	decompressor.feed(compressedData, compressedSize);
+	return decompressor.written();
+}
 
-	int bytesRead = 0, bytesWritten = 0;
-	uint8_t *litPtr = literals.data();
+LzssDecompressor::LzssDecompressor(Layout layout, uint8_t *output, size_t outputSize) :
+	layout_(layout), output_(output), writePtr_(output), writeEnd_(output + outputSize) {}
+
+uint8_t *LzssDecompressor::copy(uint8_t *writePtr, unsigned backRef) const {
+	size_t distance, count;
+	if (layout_ == Layout::Split10_6) {
+		// The back reference is a little-endian 16-bit value laid out like this, from most significant bit to least
+		// significant bit:
+		// AAAA AAAA BBCC CCCC
+		// The relative offset is then the 10-bit value "BBAAAAAAAA" + 1, and the number of bytes to copy is the 6-bit
+		// value "CCCCCC" + 3.
+		distance = (((backRef >> 8) & 0xff) | (((backRef >> 6) & 0x3) << 8)) + 1;
+		count = (backRef & 0x3f) + 3;
+	} else {
+		// Same as above with a 12-bit offset "BBBBAAAAAAAA" and a 4-bit count, from AAAA AAAA BBBB CCCC. The + 1 binds
+		// to the high bits before they are or'ed in; the data was encoded that way, so it is kept.
+		distance = ((backRef >> 8) & 0xff) | ((((backRef >> 4) & 0xf) << 8) + 1);
+		count = (backRef & 0xf) + 3;
+	}
+
+	if (distance > static_cast<size_t>(writePtr - output_)) {
+		throw std::runtime_error("Compressed data refers before the start of its output.");
+	}
+	if (count > static_cast<size_t>(writeEnd_ - writePtr)) {
+		throw std::runtime_error("Compressed data overflows its output.");
+	}
+	// Short overlapping copies are cheaper byte by byte than as a series of tiny blocks.
+	if (distance < count && count <= 18) {
+		const uint8_t *copyPtr = writePtr - distance;
+		for (size_t i = 0; i < count; ++i) {
+			writePtr[i] = copyPtr[i];
+		}
+		return writePtr + count;
+	}
+	return copyBackRef(writePtr, distance, count);
+}
+
+void LzssDecompressor::feed(const uint8_t *compressedData, size_t compressedSize) {
 	const uint8_t *readPtr = compressedData;
+	const uint8_t *readEnd = compressedData + compressedSize;
+	// Work on locals: stores through the byte pointers could alias the members and force them to be reloaded.
+	auto *writePtr = writePtr_;
+	auto *writeEnd = writeEnd_;
+	auto ctrl = ctrl_;
+	auto bit = bit_;
 
-	while (bytesRead < compressedSize) {
-		auto ctrl = *(readPtr++);
-		++bytesRead;
-		for (int i = 0; i < 8; ++i) {
-			auto type = (ctrl >> i) & 0x1;
-			if (type == 0) { // Literal byte
-				++bytesRead;
-				if (bytesRead > compressedSize) break; // The compressed data can end prematurely
-				auto val = *(readPtr++);
-				*(litPtr++) = val;
-				++bytesWritten;
-			} else { // Copy from decompressed output
-				bytesRead += 2;
-				if (bytesRead > compressedSize) break; // The compressed data can end prematurely
-
-				// The back reference is a 16-bit value laid out like this, from most significant bit to least significant bit:
-				// AAAA AAAA BBBB CCCC
-				// The relative offset is then the 12-bit value "BBBBAAAAAA" + 3, and the number of bytes to copy is the 4-bit value "CCCC"
-				//const auto backRefLow = *(readPtr++);
-				//auto backRef = ((*(readPtr++) << 8) & 0xff00) | (backRefLow & 0xff);
-				auto backRef = *(uint16_t *)readPtr;
-				readPtr += 2;
-				int offset = ((backRef >> 8) & 0xff) | (((backRef >> 4) & 0xf) << 8) + 1;
-				int count = (backRef & 0xf) + 3;
-				int absOffset = bytesWritten - offset;
-				for (int i = 0; i < count; ++i) {
-					auto copyVal = literals[absOffset + i];
-					*(litPtr++) = copyVal;
-					++bytesWritten;
-				}
+	if (partial_ && readPtr < readEnd) {
+		writePtr = copy(writePtr, partialLow_ | (*(readPtr++) << 8));
+		partial_ = false;
+	}
+
+	while (readPtr < readEnd) {
+		if (bit == 8) {
+			ctrl = *(readPtr++);
+			bit = 0;
+			// A run of eight literals copies in one go.
+			if (ctrl == 0 && readEnd - readPtr >= 8 && writeEnd - writePtr >= 8) {
+				memcpy(writePtr, readPtr, 8);
+				readPtr += 8;
+				writePtr += 8;
+				bit = 8;
+			}
+			continue;
+		}
+
+		if (((ctrl >> bit++) & 0x1) == 0) { // Literal byte
+			if (writePtr == writeEnd) {
+				throw std::runtime_error("Compressed data overflows its output.");
 			}
+			*(writePtr++) = *(readPtr++);
+			continue;
 		}
+
+		// Copy from decompressed output
+		if (readEnd - readPtr < 2) {
+			partialLow_ = *(readPtr++);
+			partial_ = true;
+			break;
+		}
+		unsigned backRef = readPtr[0] | (readPtr[1] << 8);
+		readPtr += 2;
+		writePtr = copy(writePtr, backRef);
 	}
 
-	return literals;
+	writePtr_ = writePtr;
+	ctrl_ = ctrl;
+	bit_ = bit;
 }
\ No newline at end of file
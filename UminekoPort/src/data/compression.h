@@ -1,9 +1,79 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
 class DataCompression {
 public:
 	static std::vector<uint8_t> decompress12_4(const uint8_t *compressedData, size_t compressedSize, size_t decompressedSize);
+	// Writes at most outputSize bytes and returns the number written; bytes past that are left untouched. Throws if the
+	// data refers outside the output.
+	static size_t decompress12_4(const uint8_t *compressedData, size_t compressedSize, uint8_t *output, size_t outputSize);
+	// LZSS variant used by PIC, BUP and TXA images, where back references are measured in whole pixels. Writes at most
+	// outputSize bytes and returns the number written. Throws if the data refers outside the output.
+	static size_t decompressPicture(const uint8_t *compressedData, size_t compressedSize, uint8_t *output, size_t outputSize);
 	static std::vector<uint8_t> decompress10_6(const uint8_t *compressedData, size_t compressedSize, size_t decompressedSize);
+	static size_t decompress10_6(const uint8_t *compressedData, size_t compressedSize, uint8_t *output, size_t outputSize);
+};
+
+// Resumable form of DataCompression::decompress10_6 and decompress12_4, used by fonts and masks. Compressed data can be
+// fed in chunks of any size, and a token cut off at the end of one chunk is finished by the next. The output buffer
+// also serves as the history for back references, so it has to stay in place until decoding is done.
+class LzssDecompressor {
+public:
+	// How a back reference's 16 bits are split between offset and count.
+	enum class Layout {
+		Split10_6,
+		Split12_4
+	};
+
+	LzssDecompressor(Layout layout, uint8_t *output, size_t outputSize);
+
+	// Throws if the data refers before the start of the output or would overflow it.
+	void feed(const uint8_t *compressedData, size_t compressedSize);
+
+	size_t written() const {
+		return static_cast<size_t>(writePtr_ - output_);
+	}
+private:
+	uint8_t *copy(uint8_t *writePtr, unsigned backRef) const;
+
+	Layout layout_;
+	uint8_t *output_;
+	uint8_t *writePtr_;
+	uint8_t *writeEnd_;
+	uint8_t ctrl_ = 0;
+	int bit_ = 8;
+	// Low byte of a back reference whose high byte is in the next chunk.
+	bool partial_ = false;
+	uint8_t partialLow_ = 0;
+};
+
+// Resumable form of DataCompression::decompressPicture. Only the most recent output is kept as history, so an image can
+// be decoded a row at a time into a small window instead of a full-size buffer.
+class PictureDecompressor {
+public:
+	PictureDecompressor(const uint8_t *compressedData, size_t compressedSize);
+
+	// Decodes the next size bytes. The result stays valid until the next call.
+	const uint8_t *next(size_t size);
+private:
+	// Furthest a back reference can reach: offset 0x7ff + 32, plus one, in 4-byte pixels.
+	static constexpr size_t MaxDistance = (0x7ff + 32 + 1) * 4;
+	// Minimum room for new output; the history is only slid back once this fills up.
+	static constexpr size_t WindowSize = 64 * 1024;
+
+	const uint8_t *readPtr_;
+	const uint8_t *readEnd_;
+	uint8_t ctrl_ = 0;
+	int bit_ = 8;
+	// Remainder of a back reference cut off by the end of the previous block.
+	size_t pendingCount_ = 0;
+	size_t pendingDistance_ = 0;
+
+	std::vector<uint8_t> window_;
+	size_t windowPos_ = 0;
+	// Output that has slid out of the window.
+	size_t discarded_ = 0;
 };
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "imagecache.h"
+
+void ImageCache::setBudget(uint64_t budget) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	budget_ = budget;
+	stats_.budget = budget;
+	trim();
+}
+
+std::shared_ptr<const void> ImageCache::find(const Key &key) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto iter = lookup_.find(key);
+	if (iter == lookup_.end()) {
+		++stats_.misses;
+		return nullptr;
+	}
+	++stats_.hits;
+	entries_.splice(entries_.begin(), entries_, iter->second);
+	return iter->second->value;
+}
+
+bool ImageCache::contains(const Key &key) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return lookup_.count(key) != 0;
+}
+
+void ImageCache::insert(const Key &key, std::shared_ptr<const void> value, uint64_t bytes) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (bytes > budget_) {
+		return;
+	}
+	auto iter = lookup_.find(key);
+	if (iter != lookup_.end()) {
+		stats_.bytes -= iter->second->bytes;
+		entries_.erase(iter->second);
+		lookup_.erase(iter);
+	}
+	entries_.push_front({ key, std::move(value), bytes });
+	lookup_[key] = entries_.begin();
+	stats_.bytes += bytes;
+	trim();
+}
+
+void ImageCache::clear() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	entries_.clear();
+	lookup_.clear();
+	stats_.bytes = 0;
+}
+
+ImageCacheStats ImageCache::stats() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto stats = stats_;
+	stats.entries = entries_.size();
+	return stats;
+}
+
+void ImageCache::trim() {
+	while (stats_.bytes > budget_ && !entries_.empty()) {
+		auto &oldest = entries_.back();
+		stats_.bytes -= oldest.bytes;
+		lookup_.erase(oldest.key);
+		entries_.pop_back();
+		++stats_.evictions;
+	}
+}
\ No newline at end of file
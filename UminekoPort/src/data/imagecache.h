@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+struct ImageCacheStats {
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t evictions = 0;
+	uint64_t bytes = 0;
+	uint64_t budget = 0;
+	size_t entries = 0;
+};
+
+// Decoded images kept in memory and evicted least recently used first once their pixels pass a byte budget. Values are
+// type-erased so one cache can hold every kind of decoded asset; the key's kind says what a value is.
+class ImageCache {
+public:
+	struct Key {
+		uint32_t index;
+		uint32_t kind;
+		// Tells apart several images decoded from one entry, such as BUP poses.
+		std::string variant;
+
+		bool operator==(const Key &other) const {
+			return index == other.index && kind == other.kind && variant == other.variant;
+		}
+	};
+
+	// A budget of 0 turns the cache off and drops everything in it.
+	void setBudget(uint64_t budget);
+
+	bool enabled() const {
+		return budget_ != 0;
+	}
+
+	// Counts a hit or a miss and marks a hit as most recently used.
+	std::shared_ptr<const void> find(const Key &key);
+	// Looks without touching the counters or the eviction order.
+	bool contains(const Key &key);
+	// Values larger than the whole budget are not kept.
+	void insert(const Key &key, std::shared_ptr<const void> value, uint64_t bytes);
+	void clear();
+
+	ImageCacheStats stats();
+private:
+	struct KeyHash {
+		size_t operator()(const Key &key) const {
+			return (size_t(key.index) * 31 + key.kind) ^ std::hash<std::string>()(key.variant);
+		}
+	};
+
+	struct Entry {
+		Key key;
+		std::shared_ptr<const void> value;
+		uint64_t bytes;
+	};
+
+	// Evicts from the back until the total fits. Called with mutex_ held.
+	void trim();
+
+	std::atomic<uint64_t> budget_ { 0 };
+	std::mutex mutex_;
+	// Most recently used first.
+	std::list<Entry> entries_;
+	std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> lookup_;
+	ImageCacheStats stats_;
+};
\ No newline at end of file
@@ -0,0 +1,275 @@
+#include "imagediskcache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+struct ImageCacheFileHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t offset;
+	uint64_t contentHash;
+	uint64_t variantHash;
+	uint32_t size;
+	uint32_t width;
+	uint32_t height;
+	uint32_t padding;
+};
+
+const char ImageCacheMagic[4] = { 'U', 'I', 'M', 'G' };
+const uint32_t ImageCacheVersion = 2;
+const char *ImageCacheExtension = ".img";
+
+}
+
+const unsigned char *CachedImage::pixels() const {
+	return file_.data() + sizeof(ImageCacheFileHeader);
+}
+
+ImageDiskCache::~ImageDiskCache() {
+	flush();
+}
+
+void ImageDiskCache::open(const std::string &directory, uint64_t budget) {
+	flush();
+	std::lock_guard<std::mutex> lock(mutex_);
+	directory_ = directory;
+	budget_ = budget;
+	entries_.clear();
+	totalSize_ = 0;
+	useCounter_ = 0;
+	touched_ = 0;
+
+	std::error_code error;
+	std::filesystem::create_directories(directory_, error);
+
+	// Rank the existing files by modification time so eviction keeps honouring the previous run's usage.
+	std::vector<std::pair<std::filesystem::file_time_type, std::pair<std::string, uint64_t>>> files;
+	for (std::filesystem::directory_iterator iter(directory_, error), end; !error && iter != end; iter.increment(error)) {
+		const auto &path = iter->path();
+		if (path.extension() != ImageCacheExtension) {
+			// Leftovers from an interrupted store.
+			if (path.extension() == ".tmp") {
+				std::filesystem::remove(path, error);
+			}
+			continue;
+		}
+		std::error_code fileError;
+		auto size = std::filesystem::file_size(path, fileError);
+		auto modified = std::filesystem::last_write_time(path, fileError);
+		if (!fileError) {
+			files.push_back({ modified, { path.filename().string(), size } });
+		}
+	}
+	std::sort(files.begin(), files.end());
+	for (const auto &file : files) {
+		entries_[file.second.first] = { file.second.second, ++useCounter_, false };
+		totalSize_ += file.second.second;
+	}
+	trim();
+}
+
+CachedImage ImageDiskCache::find(const ImageCacheKey &key, const std::string &variant) {
+	CachedImage image;
+	if (!isOpen()) {
+		return image;
+	}
+
+	auto variantHash = hash(Span<const unsigned char>(reinterpret_cast<const unsigned char *>(variant.data()), variant.size()));
+	auto name = fileName(key, variantHash);
+	bool flushDue = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		auto iter = entries_.find(name);
+		if (iter == entries_.end()) {
+			return image;
+		}
+		iter->second.lastUse = ++useCounter_;
+		if (!iter->second.touched) {
+			iter->second.touched = true;
+			flushDue = ++touched_ >= FlushInterval;
+		}
+	}
+	if (flushDue) {
+		flush();
+	}
+
+	auto path = directory_ + "/" + name;
+	try {
+		image.file_.open(path);
+	} catch (const std::exception &) {
+		return CachedImage();
+	}
+
+	ImageCacheFileHeader header;
+	if (image.file_.size() < sizeof(header)) {
+		return CachedImage();
+	}
+	memcpy(&header, image.file_.data(), sizeof(header));
+	bool valid = memcmp(header.magic, ImageCacheMagic, sizeof(ImageCacheMagic)) == 0
+		&& header.version == ImageCacheVersion
+		&& header.offset == key.offset
+		&& header.size == key.size
+		&& header.contentHash == key.contentHash
+		&& header.variantHash == variantHash
+		&& image.file_.size() == sizeof(header) + uint64_t(header.width) * header.height * 4;
+	if (!valid) {
+		return CachedImage();
+	}
+	image.width_ = header.width;
+	image.height_ = header.height;
+	return image;
+}
+
+bool ImageDiskCache::contains(const ImageCacheKey &key, const std::string &variant) {
+	if (!isOpen()) {
+		return false;
+	}
+	auto variantHash = hash(Span<const unsigned char>(reinterpret_cast<const unsigned char *>(variant.data()), variant.size()));
+	auto name = fileName(key, variantHash);
+	std::lock_guard<std::mutex> lock(mutex_);
+	return entries_.count(name) != 0;
+}
+
+void ImageDiskCache::store(const ImageCacheKey &key, const std::string &variant, uint32_t width, uint32_t height, const unsigned char *pixels) {
+	if (!isOpen()) {
+		return;
+	}
+
+	ImageCacheFileHeader header = {};
+	memcpy(header.magic, ImageCacheMagic, sizeof(ImageCacheMagic));
+	header.version = ImageCacheVersion;
+	header.offset = key.offset;
+	header.size = key.size;
+	header.contentHash = key.contentHash;
+	header.variantHash = hash(Span<const unsigned char>(reinterpret_cast<const unsigned char *>(variant.data()), variant.size()));
+	header.width = width;
+	header.height = height;
+	auto name = fileName(key, header.variantHash);
+	auto path = directory_ + "/" + name;
+	uint64_t size = sizeof(header) + uint64_t(width) * height * 4;
+
+	// Written under a unique temporary name first, so readers never map a partial file.
+	std::string tempPath;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		tempPath = path + "." + std::to_string(++useCounter_) + ".tmp";
+	}
+	{
+		std::ofstream ofs(tempPath, std::ios_base::binary | std::ios_base::trunc);
+		ofs.write((const char *)&header, sizeof(header));
+		ofs.write((const char *)pixels, size - sizeof(header));
+		if (!ofs) {
+			ofs.close();
+			std::remove(tempPath.c_str());
+			return;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		// Most likely another thread stored the same image and it is mapped right now.
+		std::filesystem::remove(tempPath, error);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto &entry = entries_[name];
+	totalSize_ += size - entry.size;
+	if (entry.touched) {
+		--touched_;
+	}
+	// The rename just gave the file a fresh modification time, so there is nothing left to flush for it.
+	entry = { size, ++useCounter_, false };
+	trim();
+}
+
+void ImageDiskCache::flush() {
+	std::vector<std::pair<uint64_t, std::string>> order;
+	std::string directory;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (touched_ == 0) {
+			return;
+		}
+		order.reserve(touched_);
+		for (auto &entry : entries_) {
+			if (entry.second.touched) {
+				order.push_back({ entry.second.lastUse, entry.first });
+				entry.second.touched = false;
+			}
+		}
+		touched_ = 0;
+		directory = directory_;
+	}
+
+	// Stamped a millisecond apart in order of use, so the next run ranks them the same way this one did. Failing to
+	// stamp a file only makes it look older.
+	std::sort(order.begin(), order.end());
+	auto now = std::filesystem::file_time_type::clock::now();
+	for (size_t i = 0; i < order.size(); ++i) {
+		std::error_code error;
+		auto stamp = now - std::chrono::milliseconds(order.size() - 1 - i);
+		std::filesystem::last_write_time(directory + "/" + order[i].second, stamp, error);
+	}
+}
+
+void ImageDiskCache::trim() {
+	if (totalSize_ <= budget_) {
+		return;
+	}
+	std::vector<std::pair<uint64_t, std::string>> order;
+	order.reserve(entries_.size());
+	for (const auto &entry : entries_) {
+		order.push_back({ entry.second.lastUse, entry.first });
+	}
+	std::sort(order.begin(), order.end());
+	for (const auto &victim : order) {
+		if (totalSize_ <= budget_) {
+			break;
+		}
+		// A file still mapped by a reader cannot be deleted on Windows; it stays tracked and is retried next time.
+		std::error_code error;
+		std::filesystem::remove(directory_ + "/" + victim.second, error);
+		if (!error) {
+			auto &entry = entries_[victim.second];
+			totalSize_ -= entry.size;
+			if (entry.touched) {
+				--touched_;
+			}
+			entries_.erase(victim.second);
+		}
+	}
+}
+
+std::string ImageDiskCache::fileName(const ImageCacheKey &key, uint64_t variantHash) const {
+	// Loose files all share one offset, so the content hash is what keeps two of the same size apart.
+	char name[80];
+	snprintf(name, sizeof(name), "%010llx_%08x_%016llx_%016llx%s", (unsigned long long)key.offset, key.size,
+		(unsigned long long)key.contentHash, (unsigned long long)variantHash, ImageCacheExtension);
+	return name;
+}
+
+uint64_t ImageDiskCache::hash(Span<const unsigned char> data) {
+	// Eight bytes per step with a multiply-xorshift mix; the tail is folded in a byte at a time.
+	const uint64_t multiplier = 0x9e3779b97f4a7c15ull;
+	uint64_t h = 0xcbf29ce484222325ull ^ data.size();
+	size_t i = 0;
+	for (; i + 8 <= data.size(); i += 8) {
+		uint64_t word;
+		memcpy(&word, data.data() + i, sizeof(word));
+		h = (h ^ word) * multiplier;
+		h ^= h >> 29;
+	}
+	for (; i < data.size(); ++i) {
+		h = (h ^ data.data()[i]) * multiplier;
+	}
+	h ^= h >> 32;
+	return h;
+}
\ No newline at end of file
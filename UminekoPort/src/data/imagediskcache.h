@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "../util/file.h"
+#include "../util/span.h"
+
+// Identifies the archive entry an image was decoded from. The content hash catches a ROM replaced by one with the same
+// layout; it need not cover every byte of the entry.
+struct ImageCacheKey {
+	uint64_t offset = 0;
+	uint32_t size = 0;
+	uint64_t contentHash = 0;
+};
+
+// Decoded BGRA pixels mapped straight from a cache file.
+class CachedImage {
+public:
+	bool valid() const {
+		return file_.isOpen();
+	}
+
+	uint32_t width() const {
+		return width_;
+	}
+
+	uint32_t height() const {
+		return height_;
+	}
+
+	const unsigned char *pixels() const;
+private:
+	friend class ImageDiskCache;
+
+	MappedFile file_;
+	uint32_t width_ = 0;
+	uint32_t height_ = 0;
+};
+
+// Decoded images kept in a directory, one file each: a fixed header followed by the raw pixels, so a hit is a single
+// mapping with nothing to decode. The directory is trimmed to a byte budget, least recently used first, and recency
+// carries over between runs through the files' modification times, which are only written when the cache is flushed.
+class ImageDiskCache {
+public:
+	~ImageDiskCache();
+
+	void open(const std::string &directory, uint64_t budget);
+
+	bool isOpen() const {
+		return !directory_.empty();
+	}
+
+	// variant tells apart several images decoded from one entry, such as BUP poses. Returns an invalid image on a miss.
+	CachedImage find(const ImageCacheKey &key, const std::string &variant);
+	// Looks without mapping the file or marking it used.
+	bool contains(const ImageCacheKey &key, const std::string &variant);
+	void store(const ImageCacheKey &key, const std::string &variant, uint32_t width, uint32_t height, const unsigned char *pixels);
+
+	// Fast non-cryptographic hash for ImageCacheKey::contentHash.
+	static uint64_t hash(Span<const unsigned char> data);
+
+	// Writes the recency of every file found since the last flush to its modification time. Runs on its own every
+	// FlushInterval hits and when the cache is closed.
+	void flush();
+private:
+	static const size_t FlushInterval = 256;
+
+	std::string fileName(const ImageCacheKey &key, uint64_t variantHash) const;
+	// Deletes the least recently used files until the total is back under budget. Called with mutex_ held.
+	void trim();
+
+	std::string directory_;
+	uint64_t budget_ = 0;
+
+	struct Entry {
+		uint64_t size;
+		uint64_t lastUse;
+		bool touched;
+	};
+	std::mutex mutex_;
+	std::unordered_map<std::string, Entry> entries_;
+	uint64_t totalSize_ = 0;
+	uint64_t useCounter_ = 0;
+	size_t touched_ = 0;
+};
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include "pixelops.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define PIXELOPS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define PIXELOPS_NEON
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang only emit AVX2 instructions in functions that ask for them; MSVC accepts the intrinsics anywhere.
+#if defined(PIXELOPS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define PIXELOPS_AVX2 __attribute__((target("avx2")))
+#else
+#define PIXELOPS_AVX2
+#endif
+
+namespace {
+
+typedef void (*AddRowFunction)(unsigned char *destination, const unsigned char *row, const unsigned char *previous, size_t size);
+typedef void (*SwapRedBlueFunction)(unsigned char *destination, const unsigned char *source, size_t pixels);
+
+void addRowScalar(unsigned char *destination, const unsigned char *row, const unsigned char *previous, size_t size) {
+	for (size_t x = 0; x < size; ++x) {
+		destination[x] = row[x] + previous[x];
+	}
+}
+
+void swapRedBlueScalar(unsigned char *destination, const unsigned char *source, size_t pixels) {
+	for (size_t i = 0; i < pixels * 4; i += 4) {
+		auto b = source[i + 0];
+		destination[i + 0] = source[i + 2];
+		destination[i + 1] = source[i + 1];
+		destination[i + 2] = b;
+		destination[i + 3] = source[i + 3];
+	}
+}
+
+#ifdef PIXELOPS_X86
+void addRowSse2(unsigned char *destination, const unsigned char *row, const unsigned char *previous, size_t size) {
+	size_t x = 0;
+	for (; x + 16 <= size; x += 16) {
+		auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x));
+		auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(previous + x));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(destination + x), _mm_add_epi8(a, b));
+	}
+	addRowScalar(destination + x, row + x, previous + x, size - x);
+}
+
+PIXELOPS_AVX2 void addRowAvx2(unsigned char *destination, const unsigned char *row, const unsigned char *previous, size_t size) {
+	size_t x = 0;
+	for (; x + 32 <= size; x += 32) {
+		auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + x));
+		auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(previous + x));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + x), _mm256_add_epi8(a, b));
+	}
+	addRowSse2(destination + x, row + x, previous + x, size - x);
+}
+
+// Swaps bytes 0 and 2 of each pixel with shifts and masks, since byte shuffles need SSSE3.
+void swapRedBlueSse2(unsigned char *destination, const unsigned char *source, size_t pixels) {
+	const auto keep = _mm_set1_epi32(static_cast<int>(0xff00ff00));
+	const auto low = _mm_set1_epi32(0x000000ff);
+	size_t i = 0;
+	for (; i + 4 <= pixels; i += 4) {
+		auto p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(source + i * 4));
+		auto ga = _mm_and_si128(p, keep);
+		auto r = _mm_and_si128(_mm_srli_epi32(p, 16), low);
+		auto b = _mm_slli_epi32(_mm_and_si128(p, low), 16);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(destination + i * 4), _mm_or_si128(ga, _mm_or_si128(r, b)));
+	}
+	swapRedBlueScalar(destination + i * 4, source + i * 4, pixels - i);
+}
+
+PIXELOPS_AVX2 void swapRedBlueAvx2(unsigned char *destination, const unsigned char *source, size_t pixels) {
+	const auto shuffle = _mm256_setr_epi8(
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	size_t i = 0;
+	for (; i + 8 <= pixels; i += 8) {
+		auto p = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(source + i * 4));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(destination + i * 4), _mm256_shuffle_epi8(p, shuffle));
+	}
+	swapRedBlueSse2(destination + i * 4, source + i * 4, pixels - i);
+}
+
+bool hasAvx2() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+	__cpuid(info, 1);
+	// The OS has to save the YMM registers too (OSXSAVE, then XCR0 bits 1 and 2).
+	if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6) {
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+#ifdef PIXELOPS_NEON
+void addRowNeon(unsigned char *destination, const unsigned char *row, const unsigned char *previous, size_t size) {
+	size_t x = 0;
+	for (; x + 16 <= size; x += 16) {
+		vst1q_u8(destination + x, vaddq_u8(vld1q_u8(row + x), vld1q_u8(previous + x)));
+	}
+	addRowScalar(destination + x, row + x, previous + x, size - x);
+}
+
+void swapRedBlueNeon(unsigned char *destination, const unsigned char *source, size_t pixels) {
+	size_t i = 0;
+	for (; i + 16 <= pixels; i += 16) {
+		auto p = vld4q_u8(source + i * 4);
+		auto b = p.val[0];
+		p.val[0] = p.val[2];
+		p.val[2] = b;
+		vst4q_u8(destination + i * 4, p);
+	}
+	swapRedBlueScalar(destination + i * 4, source + i * 4, pixels - i);
+}
+#endif
+
+struct Kernels {
+	PixelOps::Target target;
+	AddRowFunction addRow;
+	SwapRedBlueFunction swapRedBlue;
+};
+
+Kernels kernelsFor(PixelOps::Target target) {
+	switch (target) {
+#if defined(PIXELOPS_X86)
+	case PixelOps::Target::Sse2:
+		return { target, addRowSse2, swapRedBlueSse2 };
+	case PixelOps::Target::Avx2:
+		return { target, addRowAvx2, swapRedBlueAvx2 };
+#elif defined(PIXELOPS_NEON)
+	case PixelOps::Target::Neon:
+		return { target, addRowNeon, swapRedBlueNeon };
+#endif
+	default:
+		return { PixelOps::Target::Scalar, addRowScalar, swapRedBlueScalar };
+	}
+}
+
+Kernels &kernels() {
+	static Kernels selected = kernelsFor(PixelOps::availableTargets().back());
+	return selected;
+}
+
+}
+
+void PixelOps::dpcmRow(unsigned char *destination, const unsigned char *row, const unsigned char *previous, size_t size) {
+	if (!previous) {
+		if (destination != row) {
+			memcpy(destination, row, size);
+		}
+		return;
+	}
+	kernels().addRow(destination, row, previous, size);
+}
+
+void PixelOps::swapRedBlue(unsigned char *destination, const unsigned char *source, size_t pixels) {
+	kernels().swapRedBlue(destination, source, pixels);
+}
+
+std::vector<PixelOps::Target> PixelOps::availableTargets() {
+	std::vector<Target> targets { Target::Scalar };
+#if defined(PIXELOPS_X86)
+	targets.push_back(Target::Sse2);
+	if (hasAvx2()) {
+		targets.push_back(Target::Avx2);
+	}
+#elif defined(PIXELOPS_NEON)
+	targets.push_back(Target::Neon);
+#endif
+	return targets;
+}
+
+PixelOps::Target PixelOps::target() {
+	return kernels().target;
+}
+
+void PixelOps::setTarget(Target target) {
+	auto targets = availableTargets();
+	if (std::find(targets.begin(), targets.end(), target) != targets.end()) {
+		kernels() = kernelsFor(target);
+	}
+}
+
+const char *PixelOps::name(Target target) {
+	switch (target) {
+	case Target::Sse2:
+		return "SSE2";
+	case Target::Avx2:
+		return "AVX2";
+	case Target::Neon:
+		return "NEON";
+	default:
+		return "scalar";
+	}
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Per-pixel passes shared by the image decoders. Picks the widest vector implementation the CPU supports the first
+// time it is used.
+class PixelOps {
+public:
+	// Instruction sets with an implementation of every pass.
+	enum class Target {
+		Scalar,
+		Sse2,
+		Avx2,
+		Neon
+	};
+
+	// Reconstructs one delta-coded row into destination, which may be row itself. previous is the reconstructed row
+	// above, or null for the first row.
+	static void dpcmRow(unsigned char *destination, const unsigned char *row, const unsigned char *previous, size_t size);
+	// Converts BGRA pixels to RGBA or back. destination may be source itself.
+	static void swapRedBlue(unsigned char *destination, const unsigned char *source, size_t pixels);
+
+	// The targets this build and CPU can run, scalar first and the default last.
+	static std::vector<Target> availableTargets();
+	static Target target();
+	// Makes every later call use target, if it is available, so the targets can be checked against each other. Not
+	// safe while another thread is using PixelOps.
+	static void setTarget(Target target);
+	static const char *name(Target target);
+};
\ No newline at end of file
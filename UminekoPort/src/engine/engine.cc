@@ -1,4 +1,5 @@
 #include "engine.h"
+#include "graphicscontext.h"
 
 #include "../data/archive.h"
 #include "../script/script.h"
@@ -13,18 +14,45 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <filesystem>
+#include <iostream>
 #include <thread>
 
 const std::string Engine::game = "umi";
 
+std::string Engine::romPath() {
+	if (game == "chiru")
+		return "chiru_data/DATA.ROM";
+	else if (game == "higu")
+		return "higurashi_data/DATA.ROM";
+	return "data/DATA.ROM";
+}
+
+std::string Engine::overlayPath() {
+	auto rom = romPath();
+	return rom.substr(0, rom.find_last_of('/') + 1) + "mods";
+}
+
+std::string Engine::autosavePath() {
+	auto rom = romPath();
+	return rom.substr(0, rom.find_last_of('/') + 1) + "autosave.sav";
+}
+
 void Engine::run() {
 	Archive arc;
-	if (game == "umi")
-		arc.open("data/DATA.ROM");
-	else if (game == "chiru")
-		arc.open("chiru_data/DATA.ROM");
-	else if (game == "higu") {
-		arc.open("higurashi_data/DATA.ROM");
+	arc.open(romPath());
+	if (!tracePath_.empty()) {
+		arc.startTrace();
+	}
+	std::error_code error;
+	if (std::filesystem::is_directory(overlayPath(), error)) {
+		arc.addOverlay(overlayPath());
+	}
+	arc.setMemoryCacheBudget(memoryCacheBudget_);
+	if (!imageCachePath_.empty()) {
+		arc.enableImageCache(imageCachePath_, imageCacheBudget_);
+	}
+	if (game == "higu") {
 		arc.explore();
 	}
 
@@ -59,6 +87,11 @@ void Engine::run() {
 	}
 
 	Script script(ctx, audio, false);
+	script.setTraceLevel(scriptTraceLevel_);
+	script.setAutosavePath(autosavePath());
+	if (continue_) {
+		script.restoreFrom(autosavePath());
+	}
 	std::thread scriptThread([&]() {
 		script.load("main.snr", arc);
 	});
@@ -86,6 +119,9 @@ void Engine::run() {
 				if (event.key == KeyCode::D) {
 					script.decompile();
 				}
+				if (event.key == KeyCode::T) {
+					script.dumpTrace(std::cout, 64);
+				}
 			}
 			if (skipping) {
 				ctx.message().advance();
@@ -155,4 +191,7 @@ void Engine::run() {
 
 	script.stop();
 	scriptThread.join();
+	if (!tracePath_.empty()) {
+		arc.stopTrace(tracePath_);
+	}
 }
\ No newline at end of file
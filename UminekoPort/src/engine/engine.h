@@ -1,14 +1,43 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 #include "../math/clock.h"
+#include "../script/scripttrace.h"
 
 class Engine {
 public:
 	void run();
 
+	// Records the session's archive accesses to path, saved when the window closes. Off while empty.
+	void setTracePath(const std::string &path) {
+		tracePath_ = path;
+	}
+	void setScriptTraceLevel(ScriptTraceLevel level) {
+		scriptTraceLevel_ = level;
+	}
+	// Starts from the autosave instead of the top of the script.
+	void setContinue(bool enabled) {
+		continue_ = enabled;
+	}
+	// Keeps up to budget bytes of decoded images in files under directory across runs. Off while directory is empty.
+	void setImageCache(const std::string &directory, uint64_t budget) {
+		imageCachePath_ = directory;
+		imageCacheBudget_ = budget;
+	}
+	// Keeps up to budget bytes of decoded images in memory. Off while 0.
+	void setMemoryCacheBudget(uint64_t budget) {
+		memoryCacheBudget_ = budget;
+	}
+
 	static const std::string game;
+	// Archive holding the current game's data.
+	static std::string romPath();
+	// Loose files in here replace the archive entries with the same path, when the directory exists.
+	static std::string overlayPath();
+	// Written by the script's autosave command, next to the archive.
+	static std::string autosavePath();
 
 private:
 	Clock clock;
@@ -16,4 +45,10 @@ private:
 	double frameTime_ = 0;
 	double accumulator_ = 0;
 	double fpsUpdateFreq_ = 0;
+	std::string tracePath_;
+	ScriptTraceLevel scriptTraceLevel_ = ScriptTraceLevel::Off;
+	bool continue_ = false;
+	std::string imageCachePath_;
+	uint64_t imageCacheBudget_ = 0;
+	uint64_t memoryCacheBudget_ = 0;
 };
\ No newline at end of file
@@ -3,6 +3,49 @@
 #include "../graphics/shader.h"
 #include "../graphics/uniformbuffer.h"
 
+namespace {
+
+void writeLayer(BinaryWriter &writer, const GraphicsLayer &layer) {
+	writer.write(static_cast<uint8_t>(layer.type));
+	writer.writeString(layer.texturePath);
+	writer.writeString(layer.bupPose);
+	const auto &properties = layer.newProperties;
+	writer.write(static_cast<uint8_t>(properties.sprite.anchor));
+	writer.write(static_cast<uint8_t>(properties.sprite.pivot));
+	writer.write(properties.sprite.textureRect);
+	writer.write(properties.sprite.pivotOffset);
+	writer.write(properties.sprite.color);
+	writer.write(properties.transform.position);
+	writer.write(properties.transform.scale);
+	writer.write(properties.transform.rotation);
+	writer.write(properties.offset);
+	writer.write(static_cast<uint32_t>(properties.filter));
+	writer.write(static_cast<uint32_t>(properties.blendMode));
+}
+
+void readLayer(BinaryReader &br, GraphicsLayer &layer) {
+	layer.type = static_cast<GraphicsLayerType>(br.read<uint8_t>());
+	layer.texturePath = br.readString(br.read<uint32_t>());
+	layer.bupPose = br.readString(br.read<uint32_t>());
+	auto &properties = layer.newProperties;
+	properties.sprite.anchor = static_cast<Anchor>(br.read<uint8_t>());
+	properties.sprite.pivot = static_cast<Pivot>(br.read<uint8_t>());
+	properties.sprite.textureRect = br.read<glm::vec4>();
+	properties.sprite.pivotOffset = br.read<glm::ivec2>();
+	properties.sprite.color = br.read<glm::vec4>();
+	properties.transform.position = br.read<glm::vec3>();
+	properties.transform.scale = br.read<glm::vec3>();
+	properties.transform.rotation = br.read<glm::quat>();
+	properties.offset = br.read<glm::ivec2>();
+	properties.filter = static_cast<GraphicsLayerFilter::Flags>(br.read<uint32_t>());
+	properties.blendMode = static_cast<GraphicsLayerBlendMode>(br.read<uint32_t>());
+	layer.properties = properties;
+	layer.texture = Texture();
+	layer.dirty = layer.type != GraphicsLayerType::None;
+}
+
+}
+
 GraphicsContext::GraphicsContext(Window &window, Archive &archive, AudioManager &audio) : window_(window), archive_(archive), audio_(audio), transition_(archive) {
 	prevFramebuffer_.create(window_.fboSize().x, window_.fboSize().y);
 
@@ -140,4 +183,40 @@ void GraphicsContext::render() {
 
 	//lock.unlock();
 	msg_.render();
+}
+
+void GraphicsContext::saveState(BinaryWriter &writer) {
+	std::lock_guard<std::mutex> lock(graphicsMutex_);
+	writer.write(static_cast<uint32_t>(layers_.size()));
+	for (const auto &layer : layers_) {
+		writeLayer(writer, layer);
+	}
+	for (const auto &layer : newLayers_) {
+		writeLayer(writer, layer);
+	}
+}
+
+void GraphicsContext::restoreState(BinaryReader &br) {
+	auto count = br.read<uint32_t>();
+	if (count != layers_.size()) {
+		throw std::runtime_error("Save has " + std::to_string(count) + " graphics layers, expected " + std::to_string(layers_.size()) + ".");
+	}
+	std::vector<GraphicsLayer> layers(count), newLayers(count);
+	for (auto &layer : layers) {
+		readLayer(br, layer);
+	}
+	for (auto &layer : newLayers) {
+		readLayer(br, layer);
+	}
+
+	std::lock_guard<std::mutex> lock(graphicsMutex_);
+	layers_ = std::move(layers);
+	newLayers_ = std::move(newLayers);
+	for (const auto &layer : newLayers_) {
+		if (layer.type == GraphicsLayerType::Default) {
+			archive_.prefetch(layer.texturePath, ArchiveAssetKind::Pic);
+		} else if (layer.type == GraphicsLayerType::Bup) {
+			archive_.prefetchBupBase(layer.texturePath, layer.bupPose);
+		}
+	}
 }
\ No newline at end of file
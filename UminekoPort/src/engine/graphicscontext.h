@@ -12,6 +12,9 @@
 #include "../graphics/font.h"
 #include "../graphics/messagewindow.h"
 #include "../graphics/transition.h"
+#include "../util/binaryreader.h"
+#include "../util/binarywriter.h"
+#include "graphicssink.h"
 
 enum class GraphicsLayerType {
 	None,
@@ -19,30 +22,6 @@ enum class GraphicsLayerType {
 	Bup
 };
 
-struct GraphicsLayerFilter {
-	enum Flags {
-		None = 0,
-		Sepia = 1,
-		Inverted = 2,
-		Grayscale = 4,
-		White = 8, // ???
-	};
-};
-
-enum class GraphicsLayerBlendMode {
-	None = 0,
-	Add = 1,
-	Subtract = 2
-};
-
-struct GraphicsLayerProperties {
-	Sprite sprite;
-	Transform transform;
-	glm::ivec2 offset;
-	GraphicsLayerFilter::Flags filter;
-	GraphicsLayerBlendMode blendMode;
-};
-
 struct GraphicsLayer {
 	GraphicsLayerType type = GraphicsLayerType::None;
 	Texture texture;
@@ -54,13 +33,13 @@ struct GraphicsLayer {
 	GraphicsLayerProperties properties;
 };
 
-class GraphicsContext {
+class GraphicsContext : public GraphicsSink {
 public:
 	GraphicsContext(Window &window, Archive &archive, AudioManager &audio);
 
 	void resize();
 
-	void wait(uint32_t frames) {
+	void wait(uint32_t frames) override {
 		waitTime_ = frames / 60.0;
 		waiting_ = true;
 	}
@@ -74,11 +53,11 @@ public:
 		waiting_ = false;
 	}
 
-	void transition(uint32_t frames) {
+	void transition(uint32_t frames) override {
 		transition_.transition(frames);
 	}
 
-	void transition(const std::string &maskFilename, uint32_t frames) {
+	void transition(const std::string &maskFilename, uint32_t frames) override {
 		transition_.transition(maskFilename, frames);
 	}
 
@@ -94,17 +73,29 @@ public:
 		return msg_;
 	}
 
-	GraphicsLayerProperties layerProperties(int layer) {
+	void pushMessage(const std::string &text) override {
+		msg_.push(text);
+	}
+
+	void hideMessage() override {
+		msg_.hide();
+	}
+
+	void waitForMessageSegment(int segment) override {
+		msg_.waitForMessageSegment(segment);
+	}
+
+	GraphicsLayerProperties layerProperties(int layer) override {
 		return newLayers_[layer].newProperties;
 	}
 
-	void setLayerProperties(int layer, GraphicsLayerProperties properties) {
+	void setLayerProperties(int layer, GraphicsLayerProperties properties) override {
 		std::lock_guard<std::mutex> lock(graphicsMutex_);
 		auto &l = newLayers_[layer];
 		l.newProperties = std::move(properties);
 	}
 
-	void clearLayer(int layer) {
+	void clearLayer(int layer) override {
 		std::lock_guard<std::mutex> lock(graphicsMutex_);
 		newLayers_[layer].type = GraphicsLayerType::None;
 	}
@@ -117,24 +108,29 @@ public:
 		l.dirty = false;
 	}
 
-	void setLayer(int layer, const std::string &path) {
+	void setLayer(int layer, const std::string &path) override {
 		std::lock_guard<std::mutex> lock(graphicsMutex_);
 		auto &l = newLayers_[layer];
+		replacePrefetch(l, path);
+		archive_.prefetch(path, ArchiveAssetKind::Pic);
 		l.type = GraphicsLayerType::Default;
 		l.texturePath = path;
 		l.dirty = true;
 	}
 
-	void setLayerBup(int layer, const std::string &name, const std::string &pose) {
+	void setLayerBup(int layer, const std::string &name, const std::string &pose) override {
 		std::lock_guard<std::mutex> lock(graphicsMutex_);
 		auto &l = newLayers_[layer];
-		l.texturePath = "bustup/" + name + ".bup";
+		auto path = "bustup/" + name + ".bup";
+		replacePrefetch(l, path);
+		archive_.prefetchBupBase(path, pose);
+		l.texturePath = path;
 		l.bupPose = pose;
 		l.type = GraphicsLayerType::Bup;
 		l.dirty = true;
 	}
 
-	void applyLayers() {
+	void applyLayers() override {
 		std::unique_lock<std::mutex> lock(graphicsMutex_);
 		std::cout << "APPLY LAYERS" << std::endl;
 		// implement transition stuff later
@@ -146,7 +142,27 @@ public:
 	void update();
 
 	void render();
+
+	// Layer types, images and properties, both shown and pending. Images are loaded again on the next render().
+	void saveState(BinaryWriter &writer) override;
+	void restoreState(BinaryReader &br) override;
+
+	void saveMessageState(BinaryWriter &writer) override {
+		msg_.saveState(writer);
+	}
+
+	void restoreMessageState(BinaryReader &br) override {
+		msg_.restoreState(br);
+	}
 private:
+	// New layer images are decoded in the background so render() does not stall on them. This drops the previous
+	// request if the layer is replaced before it was ever drawn.
+	void replacePrefetch(const GraphicsLayer &layer, const std::string &path) {
+		if (layer.dirty && layer.type == GraphicsLayerType::Default && layer.texturePath != path) {
+			archive_.cancelPrefetch(layer.texturePath, ArchiveAssetKind::Pic);
+		}
+	}
+
 	MessageWindow msg_;
 	std::mutex graphicsMutex_;
 	std::vector<GraphicsLayer> layers_;
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "../graphics/sprite.h"
+#include "../math/transform.h"
+#include "../util/binaryreader.h"
+#include "../util/binarywriter.h"
+
+struct GraphicsLayerFilter {
+	enum Flags {
+		None = 0,
+		Sepia = 1,
+		Inverted = 2,
+		Grayscale = 4,
+		White = 8, // ???
+	};
+};
+
+enum class GraphicsLayerBlendMode {
+	None = 0,
+	Add = 1,
+	Subtract = 2
+};
+
+struct GraphicsLayerProperties {
+	Sprite sprite;
+	Transform transform;
+	glm::ivec2 offset;
+	GraphicsLayerFilter::Flags filter;
+	GraphicsLayerBlendMode blendMode;
+};
+
+// What the script draws through. GraphicsContext renders it; the headless runner only keeps count.
+// wait() and the transitions start something the script then pauses on until Script::resume().
+class GraphicsSink {
+public:
+	virtual ~GraphicsSink() = default;
+
+	virtual void wait(uint32_t frames) = 0;
+	virtual void transition(uint32_t frames) = 0;
+	virtual void transition(const std::string &maskFilename, uint32_t frames) = 0;
+
+	virtual GraphicsLayerProperties layerProperties(int layer) = 0;
+	virtual void setLayerProperties(int layer, GraphicsLayerProperties properties) = 0;
+	virtual void clearLayer(int layer) = 0;
+	virtual void setLayer(int layer, const std::string &path) = 0;
+	virtual void setLayerBup(int layer, const std::string &name, const std::string &pose) = 0;
+	virtual void applyLayers() = 0;
+
+	virtual void pushMessage(const std::string &text) = 0;
+	virtual void hideMessage() = 0;
+	virtual void waitForMessageSegment(int segment) = 0;
+
+	virtual void saveState(BinaryWriter &writer) = 0;
+	virtual void restoreState(BinaryReader &br) = 0;
+	virtual void saveMessageState(BinaryWriter &writer) = 0;
+	virtual void restoreMessageState(BinaryReader &br) = 0;
+};
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include "savestate.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+size_t beginSaveSection(BinaryWriter &writer, SaveSection section) {
+	writer.write(static_cast<uint32_t>(section));
+	writer.write(uint32_t(0));
+	return writer.tellp();
+}
+
+void endSaveSection(BinaryWriter &writer, size_t start) {
+	writer.writeAt(start - sizeof(uint32_t), static_cast<uint32_t>(writer.tellp() - start));
+}
+
+uint32_t readSaveCount(BinaryReader &br, size_t elementSize) {
+	auto count = br.read<uint32_t>();
+	if (count > br.remaining() / elementSize) {
+		throw std::runtime_error("Save is truncated.");
+	}
+	return count;
+}
+
+bool nextSaveSection(BinaryReader &br, SaveSection &section, BinaryReader &payload) {
+	if (br.remaining() == 0) {
+		return false;
+	}
+	section = static_cast<SaveSection>(br.read<uint32_t>());
+	auto size = br.read<uint32_t>();
+	auto data = br.readStringView(size);
+	payload.wrap(data.data(), data.size());
+	return true;
+}
+
+SaveFile::~SaveFile() {
+	wait();
+}
+
+void SaveFile::writeAsync(const std::string &path, std::vector<char> data) {
+	wait();
+	thread_ = std::thread([path, data = std::move(data)]() {
+		auto temporary = path + ".tmp";
+		std::ofstream ofs(temporary, std::ios_base::binary | std::ios_base::trunc);
+		ofs.write(data.data(), data.size());
+		ofs.close();
+		std::error_code error;
+		if (ofs) {
+			std::filesystem::rename(temporary, path, error);
+		}
+		if (!ofs || error) {
+			std::cerr << "Unable to write save '" << path << "'.\n";
+		}
+	});
+}
+
+void SaveFile::wait() {
+	if (thread_.joinable()) {
+		thread_.join();
+	}
+}
+
+std::vector<char> SaveFile::read(const std::string &path) {
+	std::ifstream ifs(path, std::ios_base::binary);
+	if (!ifs) {
+		throw std::runtime_error("Unable to open save '" + path + "'.");
+	}
+	return std::vector<char>(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+}
\ No newline at end of file
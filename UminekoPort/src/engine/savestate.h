@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../util/binaryreader.h"
+#include "../util/binarywriter.h"
+
+// A save is a SaveHeader followed by sections, each a SaveSection tag, a uint32_t payload size and the payload.
+// Readers skip sections they do not know and leave their part of the state alone when one is missing, so sections
+// can be added without breaking older saves; changing what an existing section holds needs a new SaveVersion.
+const uint32_t SaveVersion = 1;
+
+struct SaveHeader {
+	char magic[4];
+	uint32_t version;
+	// Size and FNV-1a hash of the script the save was made with. Instruction offsets mean nothing in another one.
+	uint32_t scriptSize;
+	uint32_t scriptHash;
+};
+
+enum class SaveSection : uint32_t {
+	Script = 1,
+	Graphics = 2,
+	Message = 3,
+	Audio = 4
+};
+
+// Starts a section and returns what endSaveSection needs to fill in its size.
+size_t beginSaveSection(BinaryWriter &writer, SaveSection section);
+void endSaveSection(BinaryWriter &writer, size_t start);
+// Reads an element count and throws if the rest of the section cannot hold that many elements of elementSize bytes.
+uint32_t readSaveCount(BinaryReader &br, size_t elementSize);
+// Reads the next section's tag and narrows payload to its contents. Returns false at the end of the save.
+bool nextSaveSection(BinaryReader &br, SaveSection &section, BinaryReader &payload);
+
+// Writes saves on a background thread, so the script only pays for building them in memory. Files are written under
+// a temporary name and renamed over the old save, which stays intact if the game exits mid-write.
+class SaveFile {
+public:
+	SaveFile() = default;
+	SaveFile(const SaveFile &other) = delete;
+	SaveFile &operator=(const SaveFile &other) = delete;
+	~SaveFile();
+
+	// Waits for the previous write, if there is one, before starting this one.
+	void writeAsync(const std::string &path, std::vector<char> data);
+	void wait();
+
+	// Throws if the file cannot be read.
+	static std::vector<char> read(const std::string &path);
+private:
+	std::thread thread_;
+};
\ No newline at end of file
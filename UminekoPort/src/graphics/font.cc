@@ -24,7 +24,7 @@ Font &Font::global() {
 
 void Font::load(const std::string &filename, Archive &archive) {
 	std::lock_guard<std::mutex> lock(fontMutex_);
-	data_ = std::move(archive.read(filename));
+	data_ = archive.fetch(filename);
 	BinaryReader br((const char *)data_.data(), data_.size());
 	
 	auto magic = br.readString(4);
@@ -79,7 +79,7 @@ const Glyph &Font::initGlyph(uint32_t index) {
 		glyph.initialized = true;
 		//std::cout << "Reading glyph #" << i << "\n===================\n";
 		//br.seekg(offsets[i]);
-		uint8_t *readPtr = data_.data() + offsets_[index];
+		const uint8_t *readPtr = data_.data() + offsets_[index];
 
 		glyph.xOffset = *(readPtr++);//br.read<uint8_t>();
 		glyph.yOffset = *(readPtr++);
@@ -88,7 +88,7 @@ const Glyph &Font::initGlyph(uint32_t index) {
 		glyph.xAdvance = *(readPtr++);
 		glyph.yAdvance = *(readPtr++);
 
-		glyph.compressedSize = *(uint16_t *)readPtr;
+		glyph.compressedSize = *(const uint16_t *)readPtr;
 		readPtr += 2;
 
 		glyph.pixels.resize(glyph.width * glyph.height);
@@ -101,11 +101,13 @@ const Glyph &Font::initGlyph(uint32_t index) {
 		};
 
 		auto modWidth = (glyph.width % 2 == 0) ? glyph.width : (glyph.width + 1);
-		std::vector<unsigned char> literals;
+		// Reused across glyphs; fontMutex_ is held. Bytes the data does not cover stay zero.
+		auto &literals = literals_;
+		literals.assign(modWidth * glyph.height / 2, 0);
 		if (version_ == FontVersion::Fnt4)
-			literals = DataCompression::decompress12_4(readPtr, glyph.compressedSize, modWidth * glyph.height / 2);
+			DataCompression::decompress12_4(readPtr, glyph.compressedSize, literals.data(), literals.size());
 		else
-			literals = DataCompression::decompress10_6(readPtr, glyph.compressedSize, modWidth * glyph.height / 2);
+			DataCompression::decompress10_6(readPtr, glyph.compressedSize, literals.data(), literals.size());
 
 		int nibbleCount = 0;
 		int literalIndex = 0;
@@ -39,7 +39,9 @@ private:
 	} version_;
 
 	std::vector<uint32_t> offsets_;
-	std::vector<unsigned char> data_;
+	ArchiveBuffer data_;
+	// Scratch space for decompressing a glyph.
+	std::vector<uint8_t> literals_;
 	std::vector<Glyph> glyphs_;
 	
 	std::mutex fontMutex_;
@@ -3,6 +3,7 @@
 #include "../audio/audiomanager.h"
 #include "../data/archive.h"
 #include "../engine/engine.h"
+#include "../engine/savestate.h"
 #include "spritebatch.h"
 
 void MessageWindow::init(Archive &archive, AudioManager &audio) {
@@ -106,4 +107,38 @@ void MessageWindow::render() {
 	batch.add(msgSprite_, msgTransform_);
 	batch.render();
 	text_.render();
+}
+
+void MessageWindow::saveState(BinaryWriter &writer) const {
+	writer.write(static_cast<uint32_t>(messages_.size()));
+	for (const auto &message : messages_) {
+		writer.writeString(message);
+	}
+	writer.write(static_cast<uint8_t>(done_));
+	writer.write(static_cast<uint8_t>(visible_));
+	writer.write(static_cast<uint8_t>(isWaitingForMessageSegment_));
+	writer.write(static_cast<uint8_t>(doneWaitingForMessageSegment_));
+	writer.write(static_cast<int32_t>(waitForMessageSegment_));
+}
+
+void MessageWindow::restoreState(BinaryReader &br) {
+	std::deque<std::string> messages(readSaveCount(br, sizeof(uint32_t)));
+	for (auto &message : messages) {
+		message = br.readString(br.read<uint32_t>());
+	}
+	auto done = br.read<uint8_t>() != 0;
+	auto visible = br.read<uint8_t>() != 0;
+	auto isWaiting = br.read<uint8_t>() != 0;
+	auto doneWaiting = br.read<uint8_t>() != 0;
+	auto segment = br.read<int32_t>();
+
+	messages_ = std::move(messages);
+	if (!messages_.empty()) {
+		text_.setText(messages_.front());
+	}
+	done_ = done;
+	setVisible(visible);
+	isWaitingForMessageSegment_ = isWaiting;
+	doneWaitingForMessageSegment_ = doneWaiting;
+	waitForMessageSegment_ = segment;
 }
\ No newline at end of file
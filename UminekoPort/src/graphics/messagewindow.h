@@ -5,6 +5,8 @@
 #include "texture.h"
 #include "sprite.h"
 #include "font.h"
+#include "../util/binaryreader.h"
+#include "../util/binarywriter.h"
 
 class Archive;
 class AudioManager;
@@ -35,6 +37,10 @@ public:
 
 	void update();
 	void render();
+
+	// Queued messages and waiting state. A restored message is shown again from its start.
+	void saveState(BinaryWriter &writer) const;
+	void restoreState(BinaryReader &br);
 private:
 	friend class GraphicsContext;
 
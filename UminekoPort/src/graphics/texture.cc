@@ -48,18 +48,70 @@ void TextureResource::subImage(int x, int y, int width, int height, int bpp, con
 	glTexSubImage2D(texEnum, 0, x, y, width, height, formatEnum, GL_UNSIGNED_BYTE, pixels.data());
 }
 
-void TextureResource::load(const std::string &path, Archive &archive) {
-	auto pic = archive.getPic(path);
+void TextureResource::createRectangle(const std::string &label, int width, int height, const void *pixels) {
 	glGenTextures(1, &texture_);
 	glBindTexture(GL_TEXTURE_RECTANGLE, texture_);
 	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA, pic.width, pic.height, 0, GL_BGRA, GL_UNSIGNED_BYTE, pic.pixels.data());
-	glObjectLabel(GL_TEXTURE, texture_, static_cast<GLsizei>(path.size()), path.c_str());
-	size_.x = pic.width;
-	size_.y = pic.height;
+	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, pixels);
+	glObjectLabel(GL_TEXTURE, texture_, static_cast<GLsizei>(label.size()), label.c_str());
+	size_.x = width;
+	size_.y = height;
+}
+
+void TextureResource::load(const std::string &path, Archive &archive) {
+	auto cached = archive.findCachedImage(path, "");
+	if (cached.valid()) {
+		// A prefetch queued before the image reached the disk cache would otherwise stay pinned until it is pushed out.
+		archive.cancelPrefetch(path, ArchiveAssetKind::Pic);
+		createRectangle(path, cached.width(), cached.height(), cached.pixels());
+		return;
+	}
+
+	if (archive.imageCacheEnabled()) {
+		// Storing needs the pixels back, which a write-only pixel buffer cannot give, so with the disk cache on the
+		// picture is decoded into memory and uploaded from there.
+		auto pic = archive.getPic(path);
+		createRectangle(path, pic->width, pic->height, pic->pixels.data());
+		archive.storeCachedImage(path, "", pic->width, pic->height, std::shared_ptr<const std::vector<unsigned char>>(pic, &pic->pixels));
+		return;
+	}
+
+	// The picture is decoded straight into a mapped pixel buffer, which the texture is then filled from, so the pixels
+	// are written once on the CPU instead of going through an intermediate Pic.
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+	bool mapped = false;
+	glm::ivec2 size;
+	try {
+		archive.getPic(path, [&](uint32_t width, uint32_t height, size_t &stride) {
+			size.x = width;
+			size.y = height;
+			stride = width * 4;
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, stride * height, nullptr, GL_STREAM_DRAW);
+			auto *pixels = static_cast<unsigned char *>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, stride * height, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+			if (!pixels) {
+				throw std::runtime_error("Unable to map pixel buffer for '" + path + "'.");
+			}
+			mapped = true;
+			return pixels;
+		});
+	} catch (...) {
+		if (mapped) {
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &buffer);
+		throw;
+	}
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	createRectangle(path, size.x, size.y, nullptr);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glDeleteBuffers(1, &buffer);
 }
 
 void TextureResource::load(const char *pixels, int width, int height, int bpp, bool normalized) {
@@ -93,36 +145,24 @@ void TextureResource::load(const char *pixels, int width, int height, int bpp, b
 }
 
 void TextureResource::loadBup(const std::string &path, Archive &archive, const std::string &pose) {
-	auto bup = archive.getBup(path);
-	const Bup::SubEntry *entry = nullptr;
 	std::cout << "Requested Pose: " << pose << "\n";
-	for (const auto &s : bup.subentries) {
-		if (s.name == pose) {
-			entry = &s;
-		}
-		std::cout << "Pose: " << s.name << "\n";
-	}
-	if (!entry) {
-		throw std::runtime_error("Invalid Bup pose. Got " + pose + ".");
-	}
-	glGenTextures(1, &texture_);
-	glBindTexture(GL_TEXTURE_RECTANGLE, texture_);
-	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA, entry->width, entry->height, 0, GL_BGRA, GL_UNSIGNED_BYTE, entry->pixels.data());
 	std::string label = path + "_" + pose;
-	glObjectLabel(GL_TEXTURE, texture_, static_cast<GLsizei>(label.size()), label.c_str());
-	size_.x = entry->width;
-	size_.y = entry->height;
+	auto cached = archive.findCachedImage(path, pose);
+	if (cached.valid()) {
+		createRectangle(label, cached.width(), cached.height(), cached.pixels());
+		return;
+	}
+
+	auto entry = archive.getBupPose(path, pose);
+	createRectangle(label, entry->width, entry->height, entry->pixels.data());
+	archive.storeCachedImage(path, pose, entry->width, entry->height, std::shared_ptr<const std::vector<unsigned char>>(entry, &entry->pixels));
 }
 
 void TextureResource::loadTxa(const std::string &path, Archive &archive, const std::string &tex) {
 	auto txa = archive.getTxa(path);
 	const Txa::SubEntry *entry = nullptr;
 	std::cout << "Requested Texture: " << tex << "\n";
-	for (const auto &s : txa.subentries) {
+	for (const auto &s : txa->subentries) {
 		if (s.name == tex) {
 			entry = &s;
 		}
@@ -137,7 +177,9 @@ void TextureResource::loadTxa(const std::string &path, Archive &archive, const s
 	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_RECTANGLE, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, entry->scanline / 4);
 	glTexImage2D(GL_TEXTURE_RECTANGLE, 0, GL_RGBA, entry->width, entry->height, 0, GL_BGRA, GL_UNSIGNED_BYTE, entry->pixels.data());
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 	std::string label = path + "_" + tex;
 	glObjectLabel(GL_TEXTURE, texture_, static_cast<GLsizei>(label.size()), label.c_str());
 	size_.x = entry->width;
@@ -154,10 +196,10 @@ void TextureResource::loadMsk(const std::string &path, Archive &archive, bool no
 	glTexParameteri(texEnum, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(texEnum, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(texEnum, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexImage2D(texEnum, 0, GL_RED, msk.width, msk.height, 0, GL_RED, GL_UNSIGNED_BYTE, msk.pixels.data());
+	glTexImage2D(texEnum, 0, GL_RED, msk->width, msk->height, 0, GL_RED, GL_UNSIGNED_BYTE, msk->pixels.data());
 	glObjectLabel(GL_TEXTURE, texture_, static_cast<GLsizei>(path.size()), path.c_str());
-	size_.x = msk.width;
-	size_.y = msk.height;
+	size_.x = msk->width;
+	size_.y = msk->height;
 }
 
 std::shared_ptr<TextureResource> TextureCache::create(int width, int height, bool normalized) {
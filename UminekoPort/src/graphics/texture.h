@@ -24,6 +24,9 @@ public:
 	void loadTxa(const std::string &path, Archive &archive, const std::string &tex);
 	void loadMsk(const std::string &path, Archive &archive, bool normalized = false);
 private:
+	// Creates a rectangle texture from BGRA pixels, or from the bound pixel unpack buffer when pixels is null.
+	void createRectangle(const std::string &label, int width, int height, const void *pixels);
+
 	friend class TextureWrapper;
 	friend class Framebuffer;
 	friend class GraphicsContext;
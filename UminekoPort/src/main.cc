@@ -1,7 +1,258 @@
 #include "engine/engine.h"
+#include "data/archive.h"
+#include "tools/archivebench.h"
+#include "tools/archivestress.h"
+#include "tools/extractor.h"
+#include "tools/headlessrunner.h"
+#include "tools/lzssbench.h"
+#include "tools/pixelopscheck.h"
+#include "tools/readerbench.h"
+#include "tools/repacker.h"
+#include "tools/scriptbench.h"
+#include "tools/syntheticrom.h"
+#include "tools/tracereplay.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
 
 int main(int argc, char **argv) {
+	// --extract [directory]: converts the whole archive to files on disk and exits without opening a window.
+	if (argc >= 2 && std::string(argv[1]) == "--extract") {
+		Archive archive;
+		archive.open(Engine::romPath());
+		Extractor extractor(archive);
+		return extractor.run(argc >= 3 ? argv[2] : "extracted") == 0 ? 0 : 1;
+	}
+
+	// --repack <trace> [output]: rewrites the ROM with the files in trace laid out in the order they were first used.
+	// trace is either a recording from --trace or a text file with one archive path per line.
+	if (argc >= 3 && std::string(argv[1]) == "--repack") {
+		std::vector<std::string> accessOrder;
+		if (ArchiveTrace::isTrace(argv[2])) {
+			ArchiveTrace trace;
+			trace.load(argv[2]);
+			accessOrder = trace.accessOrder();
+		} else {
+			std::ifstream trace(argv[2]);
+			if (!trace) {
+				std::cerr << "Unable to open trace '" << argv[2] << "'.\n";
+				return 1;
+			}
+			for (std::string line; std::getline(trace, line);) {
+				if (!line.empty() && line.back() == '\r') {
+					line.pop_back();
+				}
+				if (!line.empty()) {
+					accessOrder.push_back(line);
+				}
+			}
+		}
+		Repacker repacker(Engine::romPath());
+		repacker.repack(accessOrder, argc >= 4 ? argv[3] : Engine::romPath() + ".repacked");
+		auto before = repacker.seekStats(accessOrder, false);
+		auto after = repacker.seekStats(accessOrder, true);
+		std::cout << "Replaying " << before.reads << " reads: " << before.seeks << " seeks over " << before.seekDistance / (1024 * 1024)
+			<< " MB before, " << after.seeks << " seeks over " << after.seekDistance / (1024 * 1024) << " MB after.\n";
+		return 0;
+	}
+
+	// --replay <trace> [stream|mapped|all] [overlay directory] [rom]: re-issues the calls of a recorded trace against each
+	// backend and prints latency percentiles next to the recorded ones. An empty overlay directory means none.
+	if (argc >= 3 && std::string(argv[1]) == "--replay") {
+		ArchiveTrace trace;
+		trace.load(argv[2]);
+		std::string backend = argc >= 4 ? argv[3] : "all";
+		std::string overlay = argc >= 5 ? argv[4] : "";
+		std::string rom = argc >= 6 ? argv[5] : Engine::romPath();
+		TraceReplay replay(trace);
+		TraceReplay::print(std::cout, "Recorded (" + std::to_string(trace.events().size()) + " calls on " + std::to_string(trace.threadCount()) + " threads)", replay.recorded());
+		if (backend == "stream" || backend == "all") {
+			TraceReplay::print(std::cout, "Stream backend", replay.run(rom, ArchiveBackend::Stream, overlay));
+		}
+		if (backend == "mapped" || backend == "all") {
+			TraceReplay::print(std::cout, "Mapped backend", replay.run(rom, ArchiveBackend::Mapped, overlay));
+		}
+		return 0;
+	}
+
+	// --stress [threads] [passes] [stream|mapped|all] [rom]: loads every entry from several threads at once and compares
+	// each result with a single-threaded pass. Exits with 1 on any mismatch.
+	if (argc >= 2 && std::string(argv[1]) == "--stress") {
+		auto threads = argc >= 3 ? std::stoul(argv[2]) : 8;
+		auto passes = argc >= 4 ? std::stoul(argv[3]) : 2;
+		std::string backend = argc >= 5 ? argv[4] : "all";
+		ArchiveStress stress(argc >= 6 ? argv[5] : Engine::romPath());
+		uint64_t mismatches = 0;
+		for (auto candidate : { ArchiveBackend::Stream, ArchiveBackend::Mapped }) {
+			if (backend == "all" || backend == (candidate == ArchiveBackend::Stream ? "stream" : "mapped")) {
+				auto result = stress.run(candidate, threads, passes);
+				ArchiveStress::print(std::cout, result);
+				mismatches += result.mismatches;
+			}
+		}
+		return mismatches == 0 ? 0 : 1;
+	}
+
+	// --decode-bench [max threads] [path] [rom]: decodes one PIC, by default the largest in the ROM, with 1 to max
+	// threads and prints the median time of each.
+	if (argc >= 2 && std::string(argv[1]) == "--decode-bench") {
+		auto threads = argc >= 3 ? std::stoul(argv[2]) : std::max(std::thread::hardware_concurrency(), 1u);
+		ArchiveBench bench(argc >= 5 ? argv[4] : Engine::romPath());
+		auto path = argc >= 4 && argv[3][0] ? std::string(argv[3]) : bench.largestPic();
+		ArchiveBench::print(std::cout, "Decoding " + path, bench.decodeScaling(path, threads, 9));
+		return 0;
+	}
+
+	// --atlas-bench [threads] [rom]: decodes the largest TXA3 and TXA4 atlases with one decode thread and with several,
+	// and times copying their parts out against the shared views getTxa returns.
+	if (argc >= 2 && std::string(argv[1]) == "--atlas-bench") {
+		auto threads = argc >= 3 ? std::stoul(argv[2]) : std::max(std::thread::hardware_concurrency(), 1u);
+		ArchiveBench bench(argc >= 4 ? argv[3] : Engine::romPath());
+		std::vector<AtlasBenchResult> results;
+		for (auto version : { '3', '4' }) {
+			auto path = bench.largestTxa(version);
+			if (!path.empty()) {
+				results.push_back(bench.atlas(path, threads, 9));
+			}
+		}
+		ArchiveBench::print(std::cout, results);
+		return 0;
+	}
+
+	// --lzss-bench [repetitions] [rom]: decodes every compressed picture, glyph and mask in the ROM, and generated
+	// streams, with the current decoders and the ones they replaced, and prints the throughput of each. Exits with 1 if
+	// any output differs.
+	if (argc >= 2 && std::string(argv[1]) == "--lzss-bench") {
+		LzssBench bench(argc >= 4 ? argv[3] : Engine::romPath());
+		auto repetitions = argc >= 3 ? std::stoul(argv[2]) : 5;
+		auto results = bench.pictures(repetitions);
+		auto lzss = bench.lzss(repetitions);
+		results.insert(results.end(), lzss.begin(), lzss.end());
+		LzssBench::print(std::cout, results);
+		return std::all_of(results.begin(), results.end(), [](const LzssBenchResult &result) {
+			return result.mismatches == 0;
+		}) ? 0 : 1;
+	}
+
+	// --reader-bench [repetitions] [rom]: parses the ROM's image headers and walks its other entries as operand streams
+	// with BinaryReader and with the istream-based reader it replaced, and prints the time of each. Exits with 1 if the
+	// two read different values.
+	if (argc >= 2 && std::string(argv[1]) == "--reader-bench") {
+		ReaderBench bench(argc >= 4 ? argv[3] : Engine::romPath());
+		auto repetitions = argc >= 3 ? std::stoul(argv[2]) : 5;
+		std::vector<ReaderBenchResult> results { bench.headers(repetitions), bench.fields(repetitions) };
+		ReaderBench::print(std::cout, results);
+		return results[0].identical && results[1].identical ? 0 : 1;
+	}
+
+	// --pixelops-check [repetitions] [rom]: decodes the ROM's pictures and sprites with every PixelOps target the CPU
+	// supports and prints each one's time over a full-HD frame. Exits with 1 if any target's pixels differ from the
+	// scalar code's.
+	if (argc >= 2 && std::string(argv[1]) == "--pixelops-check") {
+		PixelOpsCheck check(argc >= 4 ? argv[3] : Engine::romPath());
+		auto results = check.run(argc >= 3 ? std::stoul(argv[2]) : 20);
+		PixelOpsCheck::print(std::cout, results);
+		return std::all_of(results.begin(), results.end(), [](const auto &result) { return result.mismatches == 0; }) ? 0 : 1;
+	}
+
+	// --synthetic-rom <output> [trace]: writes a ROM of generated assets and records a session against it, by default
+	// to <output>.trace, for benchmarking the backends with --replay on machines without the game data.
+	if (argc >= 3 && std::string(argv[1]) == "--synthetic-rom") {
+		std::string rom = argv[2];
+		std::string trace = argc >= 4 ? argv[3] : rom + ".trace";
+		auto size = SyntheticRom::write(rom);
+		auto events = SyntheticRom::recordSession(rom, trace);
+		std::cout << "Wrote " << SyntheticRom::files().size() << " files, " << size / (1024 * 1024) << " MB, to '" << rom << "' and "
+			<< events << " calls to '" << trace << "'.\nBenchmark the backends with: --replay " << trace << " all \"\" " << rom << '\n';
+		return 0;
+	}
+
+	// --script-bench [repetitions]: times arithmetic- and branch-heavy instruction sequences against the variable store.
+	if (argc >= 2 && std::string(argv[1]) == "--script-bench") {
+		ScriptBench bench;
+		ScriptBench::print(std::cout, bench.run(argc >= 3 ? std::stoul(argv[2]) : 2000));
+		return 0;
+	}
+
+	// --headless [instruction limit]: runs main.snr without a window or audio device, as fast as it goes, and prints
+	// the instruction rate, per-opcode counts and simulated time. Exits with 1 if the script failed.
+	if (argc >= 2 && std::string(argv[1]) == "--headless") {
+		Archive archive;
+		archive.open(Engine::romPath());
+		std::error_code error;
+		if (std::filesystem::is_directory(Engine::overlayPath(), error)) {
+			archive.addOverlay(Engine::overlayPath());
+		}
+		HeadlessRunner runner(archive);
+		auto result = runner.run("main.snr", argc >= 3 ? std::stoull(argv[2]) : 0);
+		HeadlessRunner::print(std::cout, result);
+		return result.error.empty() ? 0 : 1;
+	}
+
+	// --save-bench [instructions] [max KB] [max save us] [max restore us]: runs main.snr headlessly, then times
+	// snapshots of where it stopped and restores of them. Exits with 1 if the snapshot is larger than max KB, the 99th
+	// percentile save or restore is slower than its bound, or restoring does not give the same state back.
+	if (argc >= 2 && std::string(argv[1]) == "--save-bench") {
+		auto instructions = argc >= 3 ? std::stoull(argv[2]) : 1000000;
+		auto maxBytes = (argc >= 4 ? std::stoull(argv[3]) : 64) * 1024;
+		auto maxSave = argc >= 5 ? std::stod(argv[4]) : 1000.0;
+		auto maxRestore = argc >= 6 ? std::stod(argv[5]) : 5000.0;
+		Archive archive;
+		archive.open(Engine::romPath());
+		std::error_code error;
+		if (std::filesystem::is_directory(Engine::overlayPath(), error)) {
+			archive.addOverlay(Engine::overlayPath());
+		}
+		HeadlessRunner runner(archive);
+		auto result = runner.benchSaves("main.snr", instructions, 1000);
+		HeadlessRunner::print(std::cout, result);
+		bool passed = result.error.empty() && result.roundTrip;
+		if (result.bytes > maxBytes) {
+			std::cout << "Snapshot is larger than " << maxBytes << " bytes.\n";
+			passed = false;
+		}
+		if (result.saveP99 > maxSave || result.restoreP99 > maxRestore) {
+			std::cout << "Saving or restoring is slower than " << maxSave << " / " << maxRestore << " us.\n";
+			passed = false;
+		}
+		return passed ? 0 : 1;
+	}
+
 	Engine engine;
+	// --trace <file>: records every archive read and decode of the session and saves it to file on exit.
+	if (argc >= 3 && std::string(argv[1]) == "--trace") {
+		engine.setTracePath(argv[2]);
+	}
+	// --continue: resumes from the last autosave.
+	if (argc >= 2 && std::string(argv[1]) == "--continue") {
+		engine.setContinue(true);
+	}
+	// --image-cache <directory> [budget MB]: keeps decoded images in files under directory, 1024 MB by default, so later
+	// runs can skip decoding them.
+	if (argc >= 3 && std::string(argv[1]) == "--image-cache") {
+		engine.setImageCache(argv[2], (argc >= 4 ? std::stoull(argv[3]) : 1024) * 1024 * 1024);
+	}
+	// --memory-cache <budget MB>: keeps recently used decoded images in memory.
+	if (argc >= 3 && std::string(argv[1]) == "--memory-cache") {
+		engine.setMemoryCacheBudget(std::stoull(argv[2]) * 1024 * 1024);
+	}
+	// --script-trace <record|print>: records executed script instructions for dumping with T, or prints each one.
+	if (argc >= 3 && std::string(argv[1]) == "--script-trace") {
+		std::string level = argv[2];
+		if (level == "record") {
+			engine.setScriptTraceLevel(ScriptTraceLevel::Record);
+		} else if (level == "print") {
+			engine.setScriptTraceLevel(ScriptTraceLevel::Print);
+		} else if (level != "off") {
+			std::cerr << "Unknown script trace level '" << level << "', expected off, record or print.\n";
+			return 1;
+		}
+	}
 	engine.run();
 	return 0;
 }
\ No newline at end of file
@@ -43,165 +43,148 @@ void HiguScript::readSprites(BinaryReader &br, uint32_t offset) {
 
 void HiguScript::setupCommands() {
 	commands_.resize(0x100, nullptr);
-	commands_[0x41] = std::bind(&ScriptImpl::set_variable, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x42] = std::bind(&ScriptImpl::command42, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x46] = std::bind(&ScriptImpl::jump_if, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x47] = std::bind(&ScriptImpl::jump, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x48] = std::bind(&ScriptImpl::call, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x49] = std::bind(&ScriptImpl::return_, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x4A] = std::bind(&ScriptImpl::branch_on_variable, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x4D] = std::bind(&ScriptImpl::push, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x4E] = std::bind(&ScriptImpl::pop, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x80] = std::bind(&ScriptImpl::unlock_content, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x81] = std::bind(&ScriptImpl::command81, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x82] = std::bind(&HiguScript::command82, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x83] = std::bind(&ScriptImpl::wait, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x85] = std::bind(&ScriptImpl::command85, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x86] = std::bind(&ScriptImpl::display_text, this, std::placeholders::_1, std::placeholders::_2);
-	//commands_[0x87] = std::bind(&ScriptImpl::wait_msg_advance, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x88] = std::bind(&ScriptImpl::return_to_message, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x89] = std::bind(&ScriptImpl::hide_text, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x8A] = std::bind(&HiguScript::command8A, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x8D] = std::bind(&ScriptImpl::show_choices, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x8E] = std::bind(&ScriptImpl::do_transition, this, std::placeholders::_1, std::placeholders::_2); // Probably
-	commands_[0x95] = std::bind(&HiguScript::command95, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x9C] = std::bind(&ScriptImpl::play_bgm, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x9D] = std::bind(&ScriptImpl::stop_bgm, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x9E] = std::bind(&ScriptImpl::command9E, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xA0] = std::bind(&ScriptImpl::set_title, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xA1] = std::bind(&ScriptImpl::stop_se, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xA2] = std::bind(&ScriptImpl::stop_all_se, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xA3] = std::bind(&ScriptImpl::set_se_volume, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xA4] = std::bind(&ScriptImpl::commandA4, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xA5] = std::bind(&HiguScript::commandA5, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xA6] = std::bind(&HiguScript::play_voice_maybe, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xAE] = std::bind(&HiguScript::commandAE, this, std::placeholders::_1, std::placeholders::_2);
-	//commands_[0xB0] = std::bind(&ScriptImpl::set_title, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xB1] = std::bind(&ScriptImpl::play_movie, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xB2] = std::bind(&ScriptImpl::movie_related_B2, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xB3] = std::bind(&ScriptImpl::movie_related_B3, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xB4] = std::bind(&HiguScript::commandB4, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xB6] = std::bind(&ScriptImpl::autosave, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xBE] = std::bind(&ScriptImpl::unlock_trophy, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xBF] = std::bind(&ScriptImpl::commandBF, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xC1] = std::bind(&HiguScript::display_image, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xC2] = std::bind(&HiguScript::set_layer_property, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xC3] = std::bind(&ScriptImpl::commandC3, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xC9] = std::bind(&ScriptImpl::commandC9, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xCA] = std::bind(&ScriptImpl::commandCA, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xCB] = std::bind(&ScriptImpl::commandCB, this, std::placeholders::_1, std::placeholders::_2);
+	commands_[0x41] = &ScriptImpl::set_variable;
+	commands_[0x42] = &ScriptImpl::command42;
+	commands_[0x46] = &ScriptImpl::jump_if;
+	commands_[0x47] = &ScriptImpl::jump;
+	commands_[0x48] = &ScriptImpl::call;
+	commands_[0x49] = &ScriptImpl::return_;
+	commands_[0x4A] = &ScriptImpl::branch_on_variable;
+	commands_[0x4D] = &ScriptImpl::push;
+	commands_[0x4E] = &ScriptImpl::pop;
+	commands_[0x80] = &ScriptImpl::unlock_content;
+	commands_[0x81] = &ScriptImpl::command81;
+	commands_[0x82] = static_cast<CommandDecoder>(&HiguScript::command82);
+	commands_[0x83] = &ScriptImpl::wait;
+	commands_[0x85] = &ScriptImpl::command85;
+	commands_[0x86] = &ScriptImpl::display_text;
+	//commands_[0x87] = &ScriptImpl::wait_msg_advance;
+	commands_[0x88] = &ScriptImpl::return_to_message;
+	commands_[0x89] = &ScriptImpl::hide_text;
+	commands_[0x8A] = static_cast<CommandDecoder>(&HiguScript::command8A);
+	commands_[0x8D] = &ScriptImpl::show_choices;
+	commands_[0x8E] = &ScriptImpl::do_transition; // Probably
+	commands_[0x95] = static_cast<CommandDecoder>(&HiguScript::command95);
+	commands_[0x9C] = &ScriptImpl::play_bgm;
+	commands_[0x9D] = &ScriptImpl::stop_bgm;
+	commands_[0x9E] = &ScriptImpl::command9E;
+	commands_[0xA0] = &ScriptImpl::set_title;
+	commands_[0xA1] = &ScriptImpl::stop_se;
+	commands_[0xA2] = &ScriptImpl::stop_all_se;
+	commands_[0xA3] = &ScriptImpl::set_se_volume;
+	commands_[0xA4] = &ScriptImpl::commandA4;
+	commands_[0xA5] = static_cast<CommandDecoder>(&HiguScript::commandA5);
+	commands_[0xA6] = static_cast<CommandDecoder>(&HiguScript::play_voice_maybe);
+	commands_[0xAE] = static_cast<CommandDecoder>(&HiguScript::commandAE);
+	//commands_[0xB0] = &ScriptImpl::set_title;
+	commands_[0xB1] = &ScriptImpl::play_movie;
+	commands_[0xB2] = &ScriptImpl::movie_related_B2;
+	commands_[0xB3] = &ScriptImpl::movie_related_B3;
+	commands_[0xB4] = static_cast<CommandDecoder>(&HiguScript::commandB4);
+	commands_[0xB6] = &ScriptImpl::autosave;
+	commands_[0xBE] = &ScriptImpl::unlock_trophy;
+	commands_[0xBF] = &ScriptImpl::commandBF;
+	commands_[0xC1] = static_cast<CommandDecoder>(&HiguScript::display_image);
+	commands_[0xC2] = static_cast<CommandDecoder>(&HiguScript::set_layer_property);
+	commands_[0xC3] = &ScriptImpl::commandC3;
+	commands_[0xC9] = &ScriptImpl::commandC9;
+	commands_[0xCA] = &ScriptImpl::commandCA;
+	commands_[0xCB] = &ScriptImpl::commandCB;
 }
 
-void HiguScript::command82(BinaryReader &br, Archive &archive) {
+void HiguScript::command82(BinaryReader &br, ScriptProgram &program) {
 	auto unk = br.read<uint16_t>();
 }
 
-void HiguScript::command8A(BinaryReader &br, Archive &archive) {
+void HiguScript::command8A(BinaryReader &br, ScriptProgram &program) {
 	auto unk = br.read<uint32_t>();
 }
 
-void HiguScript::command95(BinaryReader &br, Archive &archive) {
+void HiguScript::command95(BinaryReader &br, ScriptProgram &program) {
 	auto unk = br.read<uint16_t>();
 	auto unk2 = br.read<uint16_t>();
 	auto unk3 = br.read<uint16_t>();
 	auto unk4 = br.read<uint32_t>();
 }
 
-void HiguScript::commandA5(BinaryReader &br, Archive &archive) {
+void HiguScript::commandA5(BinaryReader &br, ScriptProgram &program) {
 	// ...
 }
 
-void HiguScript::play_voice_maybe(BinaryReader &br, Archive &archive) {
+void HiguScript::play_voice_maybe(BinaryReader &br, ScriptProgram &program) {
 	auto path = script_.readString8(br);
 	auto unk = br.read<uint16_t>();
 	auto unk2 = br.read<uint16_t>();
 }
 
-void HiguScript::commandAE(BinaryReader &br, Archive &archive) {
+void HiguScript::commandAE(BinaryReader &br, ScriptProgram &program) {
 	auto unk = br.read<uint16_t>();
 	auto unk2 = br.read<uint16_t>();
 }
 
-void HiguScript::commandB4(BinaryReader &br, Archive &archive) {
+void HiguScript::commandB4(BinaryReader &br, ScriptProgram &program) {
 	auto unk = br.read<uint16_t>();
 }
 
-void HiguScript::display_image(BinaryReader &br, Archive &archive) {
+void HiguScript::display_image(BinaryReader &br, ScriptProgram &program) {
 	auto layer = br.read<uint16_t>(); // Layer?
 	auto type = (ImageType)br.read<uint16_t>();
 	auto unk3 = br.read<uint16_t>();
 	auto unk4 = br.read<uint8_t>();
 	if (unk4 == 0) {
-		script_.ctx_.clearLayer(layer);
+		program.setOp(ScriptOp::ClearLayer);
+		program.operand(layer);
 		return;
 	}
 	if (type == ImageType::None) return;
 	//std::cout << "[C1: " << (int)layer << "|" << (int)type << "|" << (int)unk3 << "]\n";
-	//if (layer == 0x08 || layer == 0x09 || layer == 0x0a) {
 	if (type == ImageType::Sprite) {
-		auto spriteId = script_.getVariable(br.read<uint16_t>());
-		std::cout << "Displaying sprite " << sprites_[spriteId].name << "_" << sprites_[spriteId].pose << ".\n";
-		/*Texture texture;
-		texture.load(, archive);*/
-		auto texturePath = "bustup/" + sprites_[spriteId].name + ".bup";
-		script_.ctx_.setLayerBup(layer, sprites_[spriteId].name, sprites_[spriteId].pose);
-		//pause();
-		//} else if (layer == 0x01 || layer == 0x02 || layer == 0x03) {
+		program.setOp(ScriptOp::DisplaySprite);
+		program.operand(layer);
+		program.operand(br.read<uint16_t>());
+		program.operand(true);
 	} else if (type == ImageType::Picture) {
-		auto spriteId = script_.getVariable(br.read<uint16_t>());
-		std::cout << "Displaying CG(?) " << cgs_[spriteId].name << ". (" << std::hex << br.tellg() << std::dec << ")\n";
-		auto texturePath = "picture/" + cgs_[spriteId].name + ".pic";
-		script_.ctx_.setLayer(layer, texturePath);
-		//pause();
+		program.setOp(ScriptOp::DisplayPicture);
+		program.operand(layer);
+		program.operand(br.read<uint16_t>());
+		program.operand(true);
+		program.operand(static_cast<uint32_t>(br.tellg()));
 	} else if (type == ImageType::Type1) {
 		auto width = br.read<uint16_t>();
 		auto height = br.read<uint16_t>();
 		//...
 	} else {
-		std::cerr << "Unknown image type " << (int)type << " in display_image.\n";
+		program.setOp(ScriptOp::UnknownImage);
+		program.operand(static_cast<uint32_t>(type));
 	}
 }
 
-void HiguScript::set_layer_property(BinaryReader &br, Archive &archive) {
-	auto layer = script_.getVariable(br.read<uint16_t>());
+void HiguScript::set_layer_property(BinaryReader &br, ScriptProgram &program) {
+	auto layer = br.read<uint16_t>();
 	auto prop = br.read<uint16_t>();
 	auto unk3 = br.read<uint8_t>();
 	if (unk3 == 0x0) {
 		// ...
 	} else if (unk3 == 0x01) {
-		auto props = script_.ctx_.layerProperties(layer);
-		auto value = script_.getVariable(br.read<uint16_t>());
+		// Renumbered to the umineko property numbers, where alpha, red, green and blue are 1-4 rather than 3-6. Filter
+		// and blend mode have not been identified here yet.
+		uint32_t umiProp = 0;
 		switch (prop) {
 		case 3:
-			props.sprite.color.a = (value & 0xff) / 255.0f;
-			break;
 		case 4:
-			props.sprite.color.r = (value & 0xff) / 255.0f;
-			break;
 		case 5:
-			props.sprite.color.g = (value & 0xff) / 255.0f;
-			break;
 		case 6:
-			props.sprite.color.b = (value & 0xff) / 255.0f;
+			umiProp = prop - 2;
 			break;
-		/*case 5:
-			props.filter = (GraphicsLayerFilter::Flags)(value & 0xf);
-			break;
-		case 6:
-			if (value > 2) {
-				throw std::runtime_error("Unhandled blend mode, investigate.");
-			}
-			props.blendMode = (GraphicsLayerBlendMode)value;
-			break;*/
 		case 7:
-			props.offset.x = value;
-			break;
 		case 8:
-			props.offset.y = value;
-		default: // to be implemented
+			umiProp = prop;
 			break;
 		}
-		script_.ctx_.setLayerProperties(layer, props);
+		program.setOp(ScriptOp::SetLayerProperty);
+		program.operand(layer);
+		program.operand(umiProp);
+		program.operand(br.read<uint16_t>());
 	} else if (unk3 == 0x06) {
 		br.skip(4);
 	} else if (unk3 == 0x07) {
@@ -15,13 +15,13 @@ protected:
 
 public:
 
-	void command82(BinaryReader &br, Archive &archive);
-	void command8A(BinaryReader &br, Archive &archive);
-	void command95(BinaryReader &br, Archive &archive);
-	void commandA5(BinaryReader &br, Archive &archive);
-	void play_voice_maybe(BinaryReader &br, Archive &archive);
-	void commandAE(BinaryReader &br, Archive &archive);
-	void commandB4(BinaryReader &br, Archive &archive);
-	void display_image(BinaryReader &br, Archive &archive);
-	void set_layer_property(BinaryReader &br, Archive &archive);
+	void command82(BinaryReader &br, ScriptProgram &program);
+	void command8A(BinaryReader &br, ScriptProgram &program);
+	void command95(BinaryReader &br, ScriptProgram &program);
+	void commandA5(BinaryReader &br, ScriptProgram &program);
+	void play_voice_maybe(BinaryReader &br, ScriptProgram &program);
+	void commandAE(BinaryReader &br, ScriptProgram &program);
+	void commandB4(BinaryReader &br, ScriptProgram &program);
+	void display_image(BinaryReader &br, ScriptProgram &program);
+	void set_layer_property(BinaryReader &br, ScriptProgram &program);
 };
\ No newline at end of file
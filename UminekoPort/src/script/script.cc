@@ -1,11 +1,16 @@
 #include "script.h"
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 
+#include "../data/archive.h"
 #include "../engine/engine.h"
 #include "../util/binaryreader.h"
-#include "../audio/audio.h"
+#include "../util/binarywriter.h"
 
 #include "scriptimpl.h"
 #include "umiscript.h"
@@ -13,7 +18,7 @@
 #include "higuscript.h"
 #include "scriptdecompiler.h"
 
-Script::Script(GraphicsContext &ctx, AudioManager &audio, bool commandTest) : ctx_(ctx), audio_(audio), commandTest_(commandTest), sd_(*this) {}
+Script::Script(GraphicsSink &ctx, AudioSink &audio, bool commandTest) : ctx_(ctx), audio_(audio), commandTest_(commandTest), sd_(*this) {}
 
 Script::~Script() {}
 
@@ -62,39 +67,432 @@ void Script::load(const std::string &path, Archive &archive) {
 	//sd_.decompile(path, data, scriptOffset);
 	//decompile();
 
-	br.seekg(scriptOffset_);
-	while (!stopped_) {
-		executeCommand(br, archive);
+	decode(br);
+	std::cout << "Decoded " << program_.size() << " script instructions.\n";
+	scriptHash_ = 0x811c9dc5;
+	for (auto byte : data_) {
+		scriptHash_ = (scriptHash_ ^ byte) * 0x01000193;
 	}
+	pc_ = 0;
+	if (!restorePath_.empty()) {
+		// Nothing above this on the script thread catches, and a missing or stale save should not end the game. A save
+		// that fails part way may already have restored some sections, so the state from before is put back whole and
+		// the script starts from the top.
+		auto initial = saveState();
+		try {
+			restoreState(SaveFile::read(restorePath_));
+			std::cout << "Restored '" << restorePath_ << "'.\n";
+		} catch (const std::exception &e) {
+			std::cerr << "Could not restore '" << restorePath_ << "': " << e.what() << " Starting from the top.\n";
+			restoreState(initial);
+		}
+	}
+	run();
+}
+
+void Script::decode(BinaryReader &br) {
+	program_.clear();
+	auto entry = scriptOffset_;
+	do {
+		decodeRun(br, entry);
+	} while (program_.nextEntry(entry, scriptOffset_, static_cast<uint32_t>(br.size())));
+	program_.finish();
+}
+
+void Script::decodeRun(BinaryReader &br, uint32_t offset) {
+	br.seekg(offset);
+	while (true) {
+		offset = static_cast<uint32_t>(br.tellg());
+		if (program_.contains(offset)) {
+			program_.link(offset);
+			return;
+		}
+		if (br.remaining() == 0) {
+			program_.unreachable(offset);
+			return;
+		}
+		auto opcode = br.read<uint8_t>();
+		program_.begin(opcode, offset);
+		auto decoder = impl_->commands_[opcode];
+		if (!decoder) {
+			// Its length is unknown, so the run cannot go on past it.
+			program_.setOp(ScriptOp::Invalid);
+			return;
+		}
+		try {
+			(impl_.get()->*decoder)(br, program_);
+		} catch (const std::out_of_range &) {
+			program_.discard();
+			program_.unreachable(offset);
+			return;
+		}
+	}
+}
+
+void Script::run() {
+	try {
+		while (!stopped_) {
+			const auto &instruction = program_[pc_++];
+			if (traceLevel_.load(std::memory_order_relaxed) != ScriptTraceLevel::Off) {
+				trace(instruction);
+			}
+			if (instruction.op != ScriptOp::Continue) {
+				++opcodeCounts_[instruction.opcode];
+				if (++executed_ == instructionLimit_) {
+					stopped_ = true;
+				}
+			}
+			execute(instruction);
+		}
+	} catch (const std::exception &) {
+		if (traceLevel_.load(std::memory_order_relaxed) == ScriptTraceLevel::Record) {
+			std::cerr << "Last script instructions:\n";
+			dumpTrace(std::cerr, 32);
+		}
+		throw;
+	}
+}
+
+void Script::trace(const ScriptInstruction &instruction) {
+	// Neither is an instruction in the file; Unreachable fails right away and says where.
+	if (instruction.op == ScriptOp::Unreachable || instruction.op == ScriptOp::Continue) {
+		return;
+	}
+	if (traceLevel_.load(std::memory_order_relaxed) == ScriptTraceLevel::Print) {
+		BinaryReader br((char *)data_.data(), data_.size());
+		br.seekg(instruction.offset);
+		auto line = sd_.getFunctionLine(br);
+		std::cout << '(' << std::hex << std::setw(2) << std::setfill('0') << (int)instruction.opcode << std::dec << ')' << line << '\n';
+		return;
+	}
+
+	ScriptTraceRecord record;
+	record.offset = instruction.offset;
+	record.opcode = instruction.opcode;
+	record.operandCount = static_cast<uint8_t>(std::min<uint16_t>(instruction.operandCount, 0xff));
+	record.padding = 0;
+	auto *operands = program_.operands(instruction);
+	for (size_t i = 0; i < ScriptTraceRecord::MaxOperands; ++i) {
+		record.operands[i] = i < instruction.operandCount ? operands[i] : 0;
+	}
+	trace_.record(record);
+}
+
+void Script::dumpTrace(std::ostream &os, size_t count) const {
+	uint64_t sequence;
+	auto records = trace_.latest(count, sequence);
+	// Until something is recorded, the script may still be loading.
+	if (records.empty()) {
+		return;
+	}
+	BinaryReader br((char *)data_.data(), data_.size());
+	for (const auto &record : records) {
+		os << '#' << sequence++ << " 0x" << std::hex << std::setw(8) << std::setfill('0') << record.offset
+			<< " (" << std::setw(2) << (int)record.opcode << std::dec << std::setfill(' ') << ')';
+		try {
+			br.seekg(record.offset);
+			os << sd_.getFunctionLine(br) << '\n';
+		} catch (const std::exception &) {
+			// Disassembling ran past the end of the file; show what was decoded instead.
+			os << std::hex;
+			for (size_t i = 0; i < std::min<size_t>(record.operandCount, ScriptTraceRecord::MaxOperands); ++i) {
+				os << " 0x" << record.operands[i];
+			}
+			os << std::dec << '\n';
+		}
+	}
+}
+
+void Script::execute(const ScriptInstruction &instruction) {
+	auto *operands = program_.operands(instruction);
+	switch (instruction.op) {
+	case ScriptOp::Invalid:
+		unrecognizedCommand(instruction.opcode, instruction.offset);
+	case ScriptOp::Unreachable: {
+		std::stringstream ss;
+		ss << "Script execution reached 0x" << std::hex << instruction.offset << ", where no instruction could be decoded.";
+		throw std::runtime_error(ss.str());
+	}
+	case ScriptOp::Nop:
+		break;
+	case ScriptOp::SetVariable:
+		variables_.apply(static_cast<uint8_t>(operands[0]), static_cast<uint16_t>(operands[1]), static_cast<uint16_t>(operands[2]));
+		break;
+	case ScriptOp::SetVariableBinary:
+		variables_.apply(static_cast<uint8_t>(operands[0]), static_cast<uint16_t>(operands[1]), static_cast<uint16_t>(operands[2]), static_cast<uint16_t>(operands[3]));
+		break;
+	case ScriptOp::JumpIf:
+		if (ScriptVariables::compare(operands[0], getVariable(operands[1]), getVariable(operands[2]))) {
+			pc_ = operands[3];
+		}
+		break;
+	case ScriptOp::Continue:
+	case ScriptOp::Jump:
+		pc_ = operands[0];
+		break;
+	case ScriptOp::Call:
+		callStack_.push_back(pc_);
+		pc_ = operands[0];
+		break;
+	case ScriptOp::Return:
+		if (callStack_.size() == 0) {
+			throw std::runtime_error("Cannot return without having called a function first.");
+		}
+		pc_ = callStack_.back();
+		callStack_.pop_back();
+		break;
+	case ScriptOp::BranchOnVariable: {
+		auto value = getVariable(operands[0]);
+		auto count = instruction.operandCount - 1;
+		if (value < 0 || value >= count)
+			throw std::runtime_error("Value out of range in branch_on_variable (is this an error?).");
+		pc_ = operands[1 + value];
+		break;
+	}
+	case ScriptOp::Push:
+		for (int i = 0; i < instruction.operandCount; ++i) {
+			varStack_.push_back(getVariable(operands[i]));
+		}
+		break;
+	case ScriptOp::Pop:
+		// Think this pop order is correct
+		for (int i = 0; i < instruction.operandCount; ++i) {
+			if (varStack_.size() == 0)
+				throw std::out_of_range("Cannot pop from empty stack.");
+			auto var = static_cast<uint16_t>(operands[i]);
+			if ((var & 0x8000) == 0)
+				throw std::runtime_error("Cannot pop into a non-variable argument.");
+			setVariable(var, varStack_.back());
+			varStack_.pop_back();
+		}
+		break;
+	case ScriptOp::Wait:
+		ctx_.wait(operands[0]);
+		pause();
+		break;
+	case ScriptOp::DisplayText:
+		ctx_.applyLayers();
+		ctx_.pushMessage(program_.string(operands[1]));
+		if (operands[0])
+			pause();
+		break;
+	case ScriptOp::WaitMsgAdvance:
+		ctx_.waitForMessageSegment(static_cast<int16_t>(operands[0]));
+		pause();
+		break;
+	case ScriptOp::HideText:
+		ctx_.hideMessage();
+		break;
+	case ScriptOp::Transition:
+		ctx_.transition(getVariable(operands[0]));
+		pause();
+		ctx_.applyLayers();
+		break;
+	case ScriptOp::MaskTransition: {
+		auto maskId = getVariable(operands[0]);
+		auto frames = getVariable(operands[1]);
+		ctx_.transition("mask/" + std::string(impl_->masks_[maskId].name) + ".msk", frames);
+		pause();
+		ctx_.applyLayers();
+		break;
+	}
+	case ScriptOp::ApplyLayers:
+		ctx_.applyLayers();
+		break;
+	case ScriptOp::PlayBgm: {
+		auto bgmId = getVariable(operands[0]);
+		audio_.playBGM("bgm/" + std::string(impl_->bgms_[bgmId].name) + ".at3", operands[1] / 255.0f);
+		break;
+	}
+	case ScriptOp::StopBgm:
+		audio_.stopBGM(getVariable(operands[0]));
+		break;
+	case ScriptOp::PlaySe:
+		audio_.playSE(operands[0], "se/" + std::string(impl_->ses_[operands[1]].name) + ".at3", operands[2] / 255.0f);
+		break;
+	case ScriptOp::StopSe:
+		audio_.stopSE(getVariable(operands[0]), getVariable(operands[1]));
+		break;
+	case ScriptOp::StopAllSe:
+		audio_.stopAllSE(getVariable(operands[0]));
+		break;
+	case ScriptOp::SetSeVolume:
+		audio_.setSEVolume(getVariable(operands[0]), operands[1] / 255.0f);
+		break;
+	case ScriptOp::Autosave:
+		if (!autosavePath_.empty()) {
+			saveFile_.writeAsync(autosavePath_, saveState());
+		}
+		break;
+	case ScriptOp::ClearLayer:
+		ctx_.clearLayer(operands[0]);
+		break;
+	case ScriptOp::DisplaySprite: {
+		auto &sprite = impl_->sprites_[operands[2] ? getVariable(operands[1]) : operands[1]];
+		std::cout << "Displaying sprite " << sprite.name << "_" << sprite.pose << ".\n";
+		ctx_.setLayerBup(operands[0], sprite.name, sprite.pose);
+		break;
+	}
+	case ScriptOp::DisplayPicture: {
+		auto &cg = impl_->cgs_[operands[2] ? getVariable(operands[1]) : operands[1]];
+		std::cout << "Displaying CG(?) " << cg.name << ". (" << std::hex << operands[3] << std::dec << ")\n";
+		ctx_.setLayer(operands[0], "picture/" + cg.name + ".pic");
+		break;
+	}
+	case ScriptOp::UnknownImage:
+		std::cerr << "Unknown image type " << operands[0] << " in display_image.\n";
+		break;
+	case ScriptOp::SetLayerProperty: {
+		auto layer = getVariable(operands[0]);
+		auto props = ctx_.layerProperties(layer);
+		auto value = getVariable(operands[2]);
+		switch (operands[1]) {
+		case 1:
+			props.sprite.color.a = (value & 0xff) / 255.0f;
+			break;
+		case 2:
+			props.sprite.color.r = (value & 0xff) / 255.0f;
+			break;
+		case 3:
+			props.sprite.color.g = (value & 0xff) / 255.0f;
+			break;
+		case 4:
+			props.sprite.color.b = (value & 0xff) / 255.0f;
+			break;
+		case 5:
+			props.filter = (GraphicsLayerFilter::Flags)(value & 0xf);
+			break;
+		case 6:
+			if (value > 2) {
+				throw std::runtime_error("Unhandled blend mode, investigate.");
+			}
+			props.blendMode = (GraphicsLayerBlendMode)value;
+			break;
+		case 7:
+			props.offset.x = value;
+			break;
+		case 8:
+			props.offset.y = value;
+		default: // to be implemented
+			break;
+		}
+		ctx_.setLayerProperties(layer, props);
+		break;
+	}
+	}
+}
+
+void Script::unrecognizedCommand(uint8_t opcode, uint32_t offset) {
+	size_t curPos = offset + 1;
+	size_t start = curPos > 0x30 ? curPos - 0x30 : 0;
+	size_t end = std::min(start + 0x60, data_.size());
+	std::cerr << std::hex;
+	for (size_t i = start; i < end; ++i) {
+		std::cerr << std::setw(2) << std::setfill('0') << (int)data_[i] << ((i - start) % 0x10 == 0xf ? "\n" : " ");
+	}
+	std::cerr << std::dec << std::setw(1) << std::setfill(' ') << "\n";
+	std::stringstream ss;
+	ss << "Unrecognized Command Byte 0x" << std::hex << (int)opcode << " at 0x" << offset << ".";
+	throw std::runtime_error(ss.str());
 }
 
-void Script::executeCommand(BinaryReader &br, Archive &archive) {
-	if (targetOffset_) {
-		br.seekg(targetOffset_);
-		targetOffset_ = 0;
-	}
-	auto line = sd_.getFunctionLine(br);
-	auto cmd = br.read<uint8_t>();
-	std::cout << '(' << std::hex << std::setw(2) << std::setfill('0') << (int)cmd << std::dec << ')' << line << '\n';
-	CommandFunction cf = impl_->commands_[cmd];
-	uint64_t curPos = br.tellg();
-	if (!cf) {
-		br.seekg(curPos - 0x30);
-		unsigned char buffer[0x60];
-		br.read((char *)buffer, 0x60);
-		std::cerr << std::hex;
-		for (int i = 0; i < 0x6; ++i) {
-			for (int j = 0; j < 0x10; ++j) {
-				std::cerr << std::setw(2) << std::setfill('0') << (int)buffer[i * 0x10 + j] << " ";
+std::vector<char> Script::saveState() {
+	BinaryWriter writer;
+	writer.reserve(16 * 1024);
+	SaveHeader header { { 'U', 'S', 'A', 'V' }, SaveVersion, static_cast<uint32_t>(data_.size()), scriptHash_ };
+	writer.write(header);
+
+	// Instruction indices depend on how the script was decoded, so the save holds file offsets. An index past a Continue
+	// instruction maps to the code it continues into, which is where execution would go anyway.
+	auto section = beginSaveSection(writer, SaveSection::Script);
+	writer.write(program_[pc_].offset);
+	writer.write(static_cast<uint32_t>(callStack_.size()));
+	for (auto index : callStack_) {
+		writer.write(program_[index].offset);
+	}
+	writer.write(static_cast<uint32_t>(varStack_.size()));
+	for (auto value : varStack_) {
+		writer.write(value);
+	}
+	// Slots that were never written are still zero.
+	const auto &modified = variables_.modified();
+	writer.write(static_cast<uint32_t>(modified.size()));
+	for (auto index : modified) {
+		writer.write(index);
+		writer.write(variables_.get(index));
+	}
+	endSaveSection(writer, section);
+
+	section = beginSaveSection(writer, SaveSection::Graphics);
+	ctx_.saveState(writer);
+	endSaveSection(writer, section);
+
+	section = beginSaveSection(writer, SaveSection::Message);
+	ctx_.saveMessageState(writer);
+	endSaveSection(writer, section);
+
+	section = beginSaveSection(writer, SaveSection::Audio);
+	audio_.saveState(writer);
+	endSaveSection(writer, section);
+	return writer.release();
+}
+
+void Script::restoreState(const std::vector<char> &data) {
+	BinaryReader br(data.data(), data.size());
+	auto header = br.read<SaveHeader>();
+	if (memcmp(header.magic, "USAV", 4) != 0) {
+		throw std::runtime_error("Save has invalid signature, expected 'USAV'.");
+	}
+	if (header.version == 0 || header.version > SaveVersion) {
+		throw std::runtime_error("Save version " + std::to_string(header.version) + " is not supported.");
+	}
+	if (header.scriptSize != data_.size() || header.scriptHash != scriptHash_) {
+		throw std::runtime_error("Save was made with a different script.");
+	}
+
+	SaveSection section;
+	BinaryReader payload;
+	while (nextSaveSection(br, section, payload)) {
+		switch (section) {
+		case SaveSection::Script: {
+			auto pc = program_.offsetIndex(payload.read<uint32_t>());
+			std::vector<uint32_t> callStack(readSaveCount(payload, sizeof(uint32_t)));
+			for (auto &index : callStack) {
+				index = program_.offsetIndex(payload.read<uint32_t>());
 			}
-			std::cerr << "\n";
+			std::vector<uint16_t> varStack(readSaveCount(payload, sizeof(uint16_t)));
+			for (auto &value : varStack) {
+				value = payload.read<uint16_t>();
+			}
+			ScriptVariables variables;
+			auto count = readSaveCount(payload, sizeof(uint16_t) + sizeof(int16_t));
+			for (uint32_t i = 0; i < count; ++i) {
+				auto index = payload.read<uint16_t>();
+				auto value = payload.read<int16_t>();
+				if (index >= ScriptVariables::Count) {
+					throw std::runtime_error("Save has a variable out of range.");
+				}
+				variables.set(index, value);
+			}
+			pc_ = pc;
+			callStack_ = std::move(callStack);
+			varStack_ = std::move(varStack);
+			variables_ = std::move(variables);
+			break;
+		}
+		case SaveSection::Graphics:
+			ctx_.restoreState(payload);
+			break;
+		case SaveSection::Message:
+			ctx_.restoreMessageState(payload);
+			break;
+		case SaveSection::Audio:
+			audio_.restoreState(payload);
+			break;
+		default:
+			break;
 		}
-		std::cerr << std::dec << std::setw(1) << std::setfill(' ');
-		std::cerr << "Unrecognized Command Byte 0x" << std::hex << (int)cmd << std::dec << " at 0x" << std::hex << (curPos - 1) << std::dec << ".\n";
-		std::cerr << "";
 	}
-	//std::cout << "CB 0x" << std::hex << (int)cmd << std::dec << "\n";
-	cf(br, archive);
 }
 
 MaskEntry Script::getMask(uint32_t id) {
@@ -121,52 +519,4 @@ BGMEntry Script::getBgm(uint32_t id) {
 
 SEEntry Script::getSe(uint32_t id) {
 	return impl_->ses_[id];
-}
-
-void Script::setVariable(uint8_t operation, uint16_t variable, uint16_t value) {
-	auto op1 = getVariable(variable);
-	auto op2 = getVariable(value);
-	switch (operation) {
-	case 0: // set (confirmed?)
-		setVariable(variable, op2);
-		break;
-	case 1: // same as 0? appears to be set
-		setVariable(variable, op2); // ???
-		break;
-	case 2: // add (confirmed?)
-		setVariable(variable, op1 + op2);
-		break;
-	case 3: // subtract (confirmed?)
-		setVariable(variable, op1 - op2);
-		break;
-	case 4: // multiply (confirmed?)
-		setVariable(variable, op1 * op2);
-		break;
-	case 5: // divide (confirmed?)
-		setVariable(variable, op1 / op2);
-		break;
-	default:
-		throw std::runtime_error("Unhandled operation.");
-	}
-}
-
-void Script::setVariable(uint8_t operation, uint16_t variable, uint16_t left, uint16_t right) {
-	auto op1 = getVariable(left);
-	auto op2 = getVariable(right);
-	switch (operation) {
-	case 2: // add (confirmed?)
-		setVariable(variable, op1 + op2);
-		break;
-	case 3: // subtract (confirmed?)
-		setVariable(variable, op1 - op2);
-		break;
-	case 4: // multiply (confirmed?)
-		setVariable(variable, op1 * op2);
-		break;
-	case 5: // divide (confirmed?)
-		setVariable(variable, op1 / op2);
-		break;
-	default:
-		throw std::runtime_error("Unhandled operation.");
-	}
 }
\ No newline at end of file
@@ -1,12 +1,21 @@
 #pragma once
 
+#include <array>
 #include <iostream>
 #include <vector>
 #include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
 
-#include "../engine/graphicscontext.h"
+#include "../audio/audiosink.h"
+#include "../engine/graphicssink.h"
+#include "../engine/savestate.h"
 #include "../util/binaryreader.h"
 #include "scriptdecompiler.h"
+#include "scriptprogram.h"
+#include "scripttrace.h"
+#include "scriptvariables.h"
 
 struct ScriptHeader {
 	uint32_t fileSize;
@@ -50,11 +59,13 @@ enum class ImageType {
 	Anim = 4
 };
 
-class AudioManager;
+class Archive;
+class ScriptImpl;
 
 class Script {
 public:
-	Script(GraphicsContext &ctx, AudioManager &audio, bool commandTest=false);
+	// With commandTest, pause() returns at once, so waits, transitions and message advances take no time.
+	Script(GraphicsSink &ctx, AudioSink &audio, bool commandTest=false);
 	~Script();
 	virtual void load(const std::string &path, Archive &archive);
 	void pause() {
@@ -80,6 +91,39 @@ public:
 	void decompile() {
 		sd_.decompile(path_, data_, scriptOffset_);
 	}
+
+	// Can be changed from any thread while the script runs.
+	void setTraceLevel(ScriptTraceLevel level) {
+		traceLevel_.store(level, std::memory_order_relaxed);
+	}
+	// Disassembles up to count of the most recently recorded instructions, oldest first. Safe to call from any thread.
+	void dumpTrace(std::ostream &os, size_t count) const;
+
+	// Stops the script once it has executed limit instructions.
+	void setInstructionLimit(uint64_t limit) {
+		instructionLimit_ = limit;
+	}
+	// Instructions executed so far, by opcode. Read it once the script has stopped.
+	const std::array<uint64_t, 0x100> &opcodeCounts() const {
+		return opcodeCounts_;
+	}
+	const std::string &opcodeName(uint8_t opcode) const {
+		return sd_.getName(opcode);
+	}
+
+	// Where the autosave opcode writes to. Autosaves are skipped while this is empty.
+	void setAutosavePath(const std::string &path) {
+		autosavePath_ = path;
+	}
+	// Makes load() continue from the save at path instead of starting the script from the top.
+	void restoreFrom(const std::string &path) {
+		restorePath_ = path;
+	}
+	// Snapshot of the script, graphics, message window and audio state, resuming after the current instruction.
+	// Called on the script thread between instructions.
+	std::vector<char> saveState();
+	// Puts a saveState() snapshot back. Needs the script the save was made with to be loaded.
+	void restoreState(const std::vector<char> &data);
 private:
 	friend class ScriptDecompiler;
 	friend class ScriptImpl;
@@ -99,19 +143,42 @@ private:
 
 	ScriptDecompiler sd_;
 
-	std::atomic<bool> paused_;
-	std::atomic<bool> stopped_;
-	GraphicsContext &ctx_;
-	AudioManager &audio_;
+	std::atomic<bool> paused_ { false };
+	std::atomic<bool> stopped_ { false };
+	GraphicsSink &ctx_;
+	AudioSink &audio_;
 	bool commandTest_;
 
-	uint32_t targetOffset_ = 0;
+	std::array<uint64_t, 0x100> opcodeCounts_ {};
+	uint64_t executed_ = 0;
+	uint64_t instructionLimit_ = UINT64_MAX;
+
+	std::atomic<ScriptTraceLevel> traceLevel_ { ScriptTraceLevel::Off };
+	ScriptTraceBuffer trace_;
+
+	std::string autosavePath_;
+	std::string restorePath_;
+	SaveFile saveFile_;
+	uint32_t scriptHash_ = 0;
+
+	ScriptProgram program_;
+	// Index of the next instruction to run.
+	uint32_t pc_ = 0;
+	// Instruction indices to return to.
 	std::vector<uint32_t> callStack_;
 	std::vector<uint16_t> varStack_; // separate from callstack?
 
-	std::map<int, int16_t> variables_;
+	ScriptVariables variables_;
 
-	void executeCommand(BinaryReader &br, Archive &archive);
+	// Decodes the code reachable from scriptOffset_ into program_.
+	void decode(BinaryReader &br);
+	// Decodes from offset until the end of the file, an opcode without a decoder or code that is already decoded.
+	void decodeRun(BinaryReader &br, uint32_t offset);
+	void run();
+	void trace(const ScriptInstruction &instruction);
+	void execute(const ScriptInstruction &instruction);
+	// Prints the bytes around offset and throws, for an opcode the interpreter does not know.
+	[[noreturn]] void unrecognizedCommand(uint8_t opcode, uint32_t offset);
 
 	MaskEntry getMask(uint32_t id);
 	CgEntry getCg(uint32_t id);
@@ -120,23 +187,12 @@ private:
 	BGMEntry getBgm(uint32_t id);
 	SEEntry getSe(uint32_t id);
 
-	int16_t getVariable(uint16_t value) {
-		// Negative values that aren't variables also work so not 100% sure where the "cut-off point" is
-		if ((value >> 0xC) == 0x8) {
-			return variables_[value & ~0x8000];
-		}
-		return (int16_t)value;
+	int16_t getVariable(uint16_t value) const {
+		return variables_.resolve(value);
 	}
 
 	void setVariable(uint16_t variable, uint16_t value) {
-		if ((variable >> 0xC) != 0x8) {
-			throw std::runtime_error("Not a variable: " + std::to_string(variable));
-		}
-		variables_[variable & ~0x8000] = value;
-	}
-
-	void jump(uint32_t offset) {
-		targetOffset_ = offset;
+		variables_.assign(variable, (int16_t)value);
 	}
 
 	std::string readString8(BinaryReader &br) {
@@ -152,7 +208,4 @@ private:
 		br.skip(1);
 		return str;
 	}
-
-	void setVariable(uint8_t operation, uint16_t variable, uint16_t value);
-	void setVariable(uint8_t operation, uint16_t variable, uint16_t left, uint16_t right);
 };
\ No newline at end of file
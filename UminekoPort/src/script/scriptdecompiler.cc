@@ -227,7 +227,7 @@ void ScriptDecompiler::decompile(const std::string &path, const std::vector<unsi
 		}
 	};
 	
-	while (br.tellg() < static_cast<int>(data.size())) {
+	while (br.tellg() < data.size()) {
 		uint32_t offset = static_cast<uint32_t>(br.tellg());
 
 		++iterations;
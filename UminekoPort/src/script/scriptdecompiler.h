@@ -60,9 +60,9 @@ public:
 	void decompile(const std::string &path, const std::vector<unsigned char> &data, uint32_t scriptOffset);
 
 	std::string getFunctionLine(BinaryReader &br) const;
+	const std::string &getName(uint8_t opcode) const;
 private:
 	FuncInfo buildFunction(const SDCommand &cmd, BinaryReader &br) const;
-	const std::string &getName(uint8_t opcode) const;
 	std::string parseArgument(const SDArgument &arg, BinaryReader &br) const;
 
 	bool isVariable(uint16_t value) const {
@@ -49,164 +49,115 @@ void ScriptImpl::readSes(BinaryReader &br, uint32_t offset) {
 	}
 }
 
-void ScriptImpl::set_variable(BinaryReader &br, Archive &archive) {
+void ScriptImpl::set_variable(BinaryReader &br, ScriptProgram &program) {
 	auto operation = br.read<uint8_t>();
 	auto variable = br.read<uint16_t>();
 	auto value = br.read<uint16_t>();
-	int16_t op1, op2;
 	if (operation & 0x80) {
 		auto secondValue = br.read<uint16_t>();
-		script_.setVariable(operation & ~0x80, variable, value, secondValue);
+		program.setOp(ScriptOp::SetVariableBinary);
+		program.operand(operation & ~0x80);
+		program.operand(variable);
+		program.operand(value);
+		program.operand(secondValue);
 	} else {
-		script_.setVariable(operation, variable, value);
+		program.setOp(ScriptOp::SetVariable);
+		program.operand(operation);
+		program.operand(variable);
+		program.operand(value);
 	}
 }
 
-void ScriptImpl::command42(BinaryReader &br, Archive &archive) {
+void ScriptImpl::command42(BinaryReader &br, ScriptProgram &program) {
 	br.skip(14);
 }
 
-void ScriptImpl::jump_if(BinaryReader &br, Archive &archive) {
-	auto operation = br.read<uint8_t>();
-	auto value = script_.getVariable(br.read<uint16_t>());
-	auto compareTo = script_.getVariable(br.read<uint16_t>());
-	auto offset = br.read<uint32_t>();
-
-	switch (operation) {
-	case 0: // equal to (confirmed!)
-		if (value == compareTo) {
-			script_.jump(offset);
-		}
-		break;
-	case 1: // Not equal to (confirmed!)
-		if (value != compareTo) {
-			script_.jump(offset);
-		}
-		break;
-	case 2: // greater than or equal to (confirmed!)
-		if (value >= compareTo) {
-			script_.jump(offset);
-		}
-		break;
-	case 3: // greater than (confirmed!)
-		if (value > compareTo) {
-			script_.jump(offset);
-		}
-		break;
-	case 4: // less than or equal to (confirmed!)
-		if (value <= compareTo) {
-			script_.jump(offset);
-		}
-		break;
-	case 5: // less than (confirmed!)
-		if (value < compareTo) {
-			script_.jump(offset);
-		}
-		break;
-	case 6: // ???
-		break;
-	default:
-		throw std::runtime_error("Unsupported jump_if operation: " + std::to_string(operation));
-	}
+void ScriptImpl::jump_if(BinaryReader &br, ScriptProgram &program) {
+	program.setOp(ScriptOp::JumpIf);
+	program.operand(br.read<uint8_t>());
+	program.operand(br.read<uint16_t>());
+	program.operand(br.read<uint16_t>());
+	program.target(br.read<uint32_t>());
 }
 
-void ScriptImpl::jump(BinaryReader &br, Archive &archive) {
-	auto offset = br.read<uint32_t>();
-	script_.jump(offset);
+void ScriptImpl::jump(BinaryReader &br, ScriptProgram &program) {
+	program.setOp(ScriptOp::Jump);
+	program.target(br.read<uint32_t>());
 }
 
-void ScriptImpl::call(BinaryReader &br, Archive &archive) {
-	auto offset = br.read<uint32_t>();
-	script_.callStack_.push_back(static_cast<uint32_t>(br.tellg()));
-	script_.jump(offset);
+void ScriptImpl::call(BinaryReader &br, ScriptProgram &program) {
+	program.setOp(ScriptOp::Call);
+	program.target(br.read<uint32_t>());
 }
 
-void ScriptImpl::return_(BinaryReader &br, Archive &archive) {
-	if (script_.callStack_.size() == 0) {
-		throw std::runtime_error("Cannot return without having called a function first.");
-	}
-	script_.targetOffset_ = script_.callStack_.back();
-	script_.callStack_.pop_back();
+void ScriptImpl::return_(BinaryReader &br, ScriptProgram &program) {
+	program.setOp(ScriptOp::Return);
 }
 
-void ScriptImpl::branch_on_variable(BinaryReader &br, Archive &archive) {
-	auto value = script_.getVariable(br.read<uint16_t>());
+void ScriptImpl::branch_on_variable(BinaryReader &br, ScriptProgram &program) {
+	program.setOp(ScriptOp::BranchOnVariable);
+	program.operand(br.read<uint16_t>());
 	auto count = br.read<uint16_t>();
-	std::vector<uint32_t> offsets;
-	offsets.reserve(count);
 	for (int i = 0; i < count; ++i) {
-		offsets.push_back(br.read<uint32_t>());
+		program.target(br.read<uint32_t>());
 	}
-	if (value < 0 || value >= count)
-		throw std::runtime_error("Value out of range in branch_on_variable (is this an error?).");
-	else
-		script_.jump(offsets[value]);
 }
 
-void ScriptImpl::push(BinaryReader &br, Archive &archive) {
+void ScriptImpl::push(BinaryReader &br, ScriptProgram &program) {
+	program.setOp(ScriptOp::Push);
 	auto count = br.read<uint8_t>();
 	for (int i = 0; i < count; ++i) {
-		script_.varStack_.push_back(script_.getVariable(br.read<uint16_t>()));
+		program.operand(br.read<uint16_t>());
 	}
 }
 
-void ScriptImpl::pop(BinaryReader &br, Archive &archive) {
+void ScriptImpl::pop(BinaryReader &br, ScriptProgram &program) {
+	program.setOp(ScriptOp::Pop);
 	auto count = br.read<uint8_t>();
-	// Think this pop order is correct
 	for (int i = 0; i < count; ++i) {
-		if (script_.varStack_.size() == 0)
-			throw std::out_of_range("Cannot pop from empty stack.");
-		auto var = br.read<uint16_t>();
-		if ((var & 0x8000) == 0)
-			throw std::runtime_error("Cannot pop into a non-variable argument.");
-		script_.setVariable(var, script_.varStack_.back());
-		script_.varStack_.pop_back();
+		program.operand(br.read<uint16_t>());
 	}
 }
 
-void ScriptImpl::unlock_content(BinaryReader &br, Archive &archive) {
+void ScriptImpl::unlock_content(BinaryReader &br, ScriptProgram &program) {
 	/*br.skip(3);
 	auto count = br.read<uint8_t>() & ~0x80;
 	br.skip(2 * count); // ???*/
-	auto id = script_.getVariable(br.read<uint16_t>());
+	auto id = br.read<uint16_t>();
 }
 
-void ScriptImpl::wait(BinaryReader &br, Archive &archive) {
-	auto frames = br.read<uint16_t>();
-	script_.ctx_.wait(frames);
-	script_.pause();
+void ScriptImpl::wait(BinaryReader &br, ScriptProgram &program) {
+	program.setOp(ScriptOp::Wait);
+	program.operand(br.read<uint16_t>());
 }
 
-void ScriptImpl::command85(BinaryReader &br, Archive &archive) {
+void ScriptImpl::command85(BinaryReader &br, ScriptProgram &program) {
 	br.skip(4);
 }
 
-void ScriptImpl::display_text(BinaryReader &br, Archive &archive) {
-	script_.ctx_.applyLayers();
-	auto msgId = script_.getVariable(br.read<uint16_t>());
+void ScriptImpl::display_text(BinaryReader &br, ScriptProgram &program) {
+	auto msgId = br.read<uint16_t>();
 	br.skip(1); // ???
 	auto shouldPause = br.read<uint8_t>();
-	auto text = script_.readString16(br);
-	script_.ctx_.message().push(text);
-	if (shouldPause)
-		script_.pause();
+	program.setOp(ScriptOp::DisplayText);
+	program.operand(shouldPause);
+	program.string(script_.readString16(br));
 }
 
-void ScriptImpl::wait_msg_advance(BinaryReader &br, Archive &archive) {
-	auto segment = br.read<int16_t>();
-	script_.ctx_.message().waitForMessageSegment(segment);
-	script_.pause();
+void ScriptImpl::wait_msg_advance(BinaryReader &br, ScriptProgram &program) {
+	program.setOp(ScriptOp::WaitMsgAdvance);
+	program.operand(static_cast<uint32_t>(br.read<int16_t>()));
 }
 
-void ScriptImpl::return_to_message(BinaryReader &br, Archive &archive) {
+void ScriptImpl::return_to_message(BinaryReader &br, ScriptProgram &program) {
 	//script_.ctx_.returnToMessage();
 }
 
-void ScriptImpl::hide_text(BinaryReader &br, Archive &archive) {
-	script_.ctx_.message().hide();
+void ScriptImpl::hide_text(BinaryReader &br, ScriptProgram &program) {
+	program.setOp(ScriptOp::HideText);
 }
 
-void ScriptImpl::show_choices(BinaryReader &br, Archive &archive) {
+void ScriptImpl::show_choices(BinaryReader &br, ScriptProgram &program) {
 	br.skip(4); // Always 0?
 	auto targetVar = br.read<uint16_t>();
 	br.skip(2); // ???
@@ -214,7 +165,7 @@ void ScriptImpl::show_choices(BinaryReader &br, Archive &archive) {
 	auto choices = script_.readString8(br);
 }
 
-void ScriptImpl::do_transition(BinaryReader &br, Archive &archive) {
+void ScriptImpl::do_transition(BinaryReader &br, ScriptProgram &program) {
 	uint8_t unknown = 0, unknown2 = 0;
 	if (Engine::game == "chiru") {
 		unknown = br.read<uint8_t>();
@@ -223,17 +174,17 @@ void ScriptImpl::do_transition(BinaryReader &br, Archive &archive) {
 	}
 	auto next = br.read<uint8_t>();
 	next &= ~0x80;
+	// Layers are applied after every transition, including the ones that are not implemented.
+	program.setOp(ScriptOp::ApplyLayers);
 	if (unknown != 0) {
 		// ...
 	} else if (next == 0x02) { // fade
-		auto frames = script_.getVariable(br.read<uint16_t>());
-		script_.ctx_.transition(frames);
-		script_.pause();
+		program.setOp(ScriptOp::Transition);
+		program.operand(br.read<uint16_t>());
 	} else if (next == 0x03) { // mask
-		auto maskId = script_.getVariable(br.read<uint16_t>());
-		auto frames = script_.getVariable(br.read<uint16_t>());
-		script_.ctx_.transition("mask/" + std::string(masks_[maskId].name) + ".msk", frames);
-		script_.pause();
+		program.setOp(ScriptOp::MaskTransition);
+		program.operand(br.read<uint16_t>());
+		program.operand(br.read<uint16_t>());
 	} else if (next == 0x0C)
 		br.skip(4);
 	else if (next == 0x0E) {
@@ -242,89 +193,85 @@ void ScriptImpl::do_transition(BinaryReader &br, Archive &archive) {
 
 	//if (unknown != 0)
 	//	br.skip(2);
-	script_.ctx_.applyLayers();
 }
 
-void ScriptImpl::play_bgm(BinaryReader &br, Archive &archive) {
-	auto bgmId = script_.getVariable(br.read<uint16_t>());
+void ScriptImpl::play_bgm(BinaryReader &br, ScriptProgram &program) {
+	program.setOp(ScriptOp::PlayBgm);
+	program.operand(br.read<uint16_t>());
 	auto unk1 = br.read<uint16_t>();
-	auto volume = br.read<uint32_t>(); // B4 00 00 00 - volume?
-
-	script_.audio_.playBGM("bgm/" + std::string(bgms_[bgmId].name) + ".at3", volume / 255.0f);
+	program.operand(br.read<uint32_t>()); // B4 00 00 00 - volume?
 }
 
-void ScriptImpl::stop_bgm(BinaryReader &br, Archive &archive) {
-	auto frames = script_.getVariable(br.read<uint16_t>());
-
-	script_.audio_.stopBGM(frames);
+void ScriptImpl::stop_bgm(BinaryReader &br, ScriptProgram &program) {
+	program.setOp(ScriptOp::StopBgm);
+	program.operand(br.read<uint16_t>());
 }
 
-void ScriptImpl::play_se(BinaryReader &br, Archive &archive) {
-	auto channel = br.read<uint16_t>();
-	auto seId = br.read<uint16_t>();
+void ScriptImpl::play_se(BinaryReader &br, ScriptProgram &program) {
+	program.setOp(ScriptOp::PlaySe);
+	program.operand(br.read<uint16_t>());
+	program.operand(br.read<uint16_t>());
 	auto unk = br.read<uint16_t>();
-	auto volume = br.read<uint32_t>();
-
-	script_.audio_.playSE(channel, "se/" + std::string(ses_[seId].name) + ".at3", volume / 255.0f);
+	program.operand(br.read<uint32_t>());
 }
 
-void ScriptImpl::stop_se(BinaryReader &br, Archive &archive) {
-	auto channel = script_.getVariable(br.read<uint16_t>());
-	auto frames = script_.getVariable(br.read<uint16_t>());
-
-	script_.audio_.stopSE(channel, frames);
+void ScriptImpl::stop_se(BinaryReader &br, ScriptProgram &program) {
+	program.setOp(ScriptOp::StopSe);
+	program.operand(br.read<uint16_t>());
+	program.operand(br.read<uint16_t>());
 }
 
-void ScriptImpl::stop_all_se(BinaryReader &br, Archive &archive) {
-	auto frames = script_.getVariable(br.read<uint16_t>());
-
-	script_.audio_.stopAllSE(frames);
+void ScriptImpl::stop_all_se(BinaryReader &br, ScriptProgram &program) {
+	program.setOp(ScriptOp::StopAllSe);
+	program.operand(br.read<uint16_t>());
 }
 
-void ScriptImpl::set_se_volume(BinaryReader &br, Archive &archive) {
-	auto index = script_.getVariable(br.read<uint16_t>());
-	auto volume = br.read<uint16_t>() / 255.0f;
+void ScriptImpl::set_se_volume(BinaryReader &br, ScriptProgram &program) {
+	program.setOp(ScriptOp::SetSeVolume);
+	program.operand(br.read<uint16_t>());
+	program.operand(br.read<uint16_t>());
 	auto framesMaybe = br.read<uint16_t>();
-	script_.audio_.setSEVolume(index, volume);
 }
 
-void ScriptImpl::set_title(BinaryReader &br, Archive &archive) {
+void ScriptImpl::set_title(BinaryReader &br, ScriptProgram &program) {
 	auto unk = br.read<uint16_t>();
 	auto str = script_.readString8(br);
 	// ???
 }
 
-void ScriptImpl::play_movie(BinaryReader &br, Archive &archive) {
-	auto movieId = script_.getVariable(br.read<uint16_t>());
+void ScriptImpl::play_movie(BinaryReader &br, ScriptProgram &program) {
+	auto movieId = br.read<uint16_t>();
 }
 
-void ScriptImpl::movie_related_B2(BinaryReader &br, Archive &archive) {
+void ScriptImpl::movie_related_B2(BinaryReader &br, ScriptProgram &program) {
 	br.skip(2);
 }
 
-void ScriptImpl::movie_related_B3(BinaryReader &br, Archive &archive) {
+void ScriptImpl::movie_related_B3(BinaryReader &br, ScriptProgram &program) {
 }
 
-void ScriptImpl::movie_related_B4(BinaryReader &br, Archive &archive) {
+void ScriptImpl::movie_related_B4(BinaryReader &br, ScriptProgram &program) {
 }
 
-void ScriptImpl::autosave(BinaryReader &br, Archive &archive) {
+void ScriptImpl::autosave(BinaryReader &br, ScriptProgram &program) {
+	program.setOp(ScriptOp::Autosave);
 }
 
-void ScriptImpl::unlock_trophy(BinaryReader &br, Archive &archive) {
-	auto trophyId = script_.getVariable(br.read<uint16_t>());
+void ScriptImpl::unlock_trophy(BinaryReader &br, ScriptProgram &program) {
+	auto trophyId = br.read<uint16_t>();
 }
 
-void ScriptImpl::commandBF(BinaryReader &br, Archive &archive) {
+void ScriptImpl::commandBF(BinaryReader &br, ScriptProgram &program) {
 	br.skip(4);
 }
 
-void ScriptImpl::display_image(BinaryReader &br, Archive &archive) {
+void ScriptImpl::display_image(BinaryReader &br, ScriptProgram &program) {
 	auto layer = br.read<uint16_t>(); // Layer?
 	auto type = (ImageType)br.read<uint16_t>();
 	auto unk3 = br.read<uint8_t>();
 	if (unk3 == 0) {
-		script_.ctx_.clearLayer(layer);
+		program.setOp(ScriptOp::ClearLayer);
+		program.operand(layer);
 		return;
 	}
 	if (unk3 == 0x2D) {
@@ -335,65 +282,34 @@ void ScriptImpl::display_image(BinaryReader &br, Archive &archive) {
 		spriteId = br.read<uint16_t>();
 	}
 	//std::cout << "[C1: " << (int)layer << "|" << (int)type << "|" << (int)unk3 << "]\n";
-	//if (layer == 0x08 || layer == 0x09 || layer == 0x0a) {
 	if (type == ImageType::Sprite) {
-		std::cout << "Displaying sprite " << sprites_[spriteId].name << "_" << sprites_[spriteId].pose << ".\n";
-		/*Texture texture;
-		texture.load(, archive);*/
-		auto texturePath = "bustup/" + sprites_[spriteId].name + ".bup";
-		script_.ctx_.setLayerBup(layer, sprites_[spriteId].name, sprites_[spriteId].pose);
-		//pause();
-		//} else if (layer == 0x01 || layer == 0x02 || layer == 0x03) {
+		program.setOp(ScriptOp::DisplaySprite);
+		program.operand(layer);
+		program.operand(spriteId);
+		program.operand(false);
 	} else if (type == ImageType::Picture) {
-		std::cout << "Displaying CG(?) " << cgs_[spriteId].name << ". (" << std::hex << br.tellg() << std::dec << ")\n";
-		auto texturePath = "picture/" + cgs_[spriteId].name + ".pic";
-		script_.ctx_.setLayer(layer, texturePath);
-		//pause();
+		program.setOp(ScriptOp::DisplayPicture);
+		program.operand(layer);
+		program.operand(spriteId);
+		program.operand(false);
+		program.operand(static_cast<uint32_t>(br.tellg()));
 	} else {
-		std::cerr << "Unknown image type " << (int)type << " in display_image.\n";
+		program.setOp(ScriptOp::UnknownImage);
+		program.operand(static_cast<uint32_t>(type));
 	}
 }
 
-void ScriptImpl::set_layer_property(BinaryReader &br, Archive &archive) {
-	auto layer = script_.getVariable(br.read<uint16_t>());
+void ScriptImpl::set_layer_property(BinaryReader &br, ScriptProgram &program) {
+	auto layer = br.read<uint16_t>();
 	auto prop = br.read<uint16_t>();
 	auto unk3 = br.read<uint8_t>();
 	if (unk3 == 0x0) {
 		// ...
 	} else if (unk3 == 0x01) {
-		auto props = script_.ctx_.layerProperties(layer);
-		auto value = script_.getVariable(br.read<uint16_t>());
-		switch (prop) {
-		case 1:
-			props.sprite.color.a = (value & 0xff) / 255.0f;
-			break;
-		case 2:
-			props.sprite.color.r = (value & 0xff) / 255.0f;
-			break;
-		case 3:
-			props.sprite.color.g = (value & 0xff) / 255.0f;
-			break;
-		case 4:
-			props.sprite.color.b = (value & 0xff) / 255.0f;
-			break;
-		case 5:
-			props.filter = (GraphicsLayerFilter::Flags)(value & 0xf);
-			break;
-		case 6:
-			if (value > 2) {
-				throw std::runtime_error("Unhandled blend mode, investigate.");
-			}
-			props.blendMode = (GraphicsLayerBlendMode)value;
-			break;
-		case 7:
-			props.offset.x = value;
-			break;
-		case 8:
-			props.offset.y = value;
-		default: // to be implemented
-			break;
-		}
-		script_.ctx_.setLayerProperties(layer, props);
+		program.setOp(ScriptOp::SetLayerProperty);
+		program.operand(layer);
+		program.operand(prop);
+		program.operand(br.read<uint16_t>());
 	} else if (unk3 == 0x06) {
 		br.skip(4);
 	} else if (unk3 == 0x07) {
@@ -403,15 +319,15 @@ void ScriptImpl::set_layer_property(BinaryReader &br, Archive &archive) {
 	}
 }
 
-void ScriptImpl::commandC3(BinaryReader &br, Archive &archive) {
+void ScriptImpl::commandC3(BinaryReader &br, ScriptProgram &program) {
 	br.skip(4);
 }
 
-void ScriptImpl::commandC9(BinaryReader &br, Archive &archive) {
+void ScriptImpl::commandC9(BinaryReader &br, ScriptProgram &program) {
 	// ???
 }
 
-void ScriptImpl::commandCA(BinaryReader &br, Archive &archive) {
+void ScriptImpl::commandCA(BinaryReader &br, ScriptProgram &program) {
 	br.skip(2);
 	auto unk = br.read<uint8_t>();
 	if (unk == 0x00) {
@@ -429,6 +345,6 @@ void ScriptImpl::commandCA(BinaryReader &br, Archive &archive) {
 	}
 }
 
-void ScriptImpl::commandCB(BinaryReader &br, Archive &archive) {
+void ScriptImpl::commandCB(BinaryReader &br, ScriptProgram &program) {
 	br.skip(3);
 }
\ No newline at end of file
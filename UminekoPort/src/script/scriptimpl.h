@@ -2,10 +2,10 @@
 
 #include "script.h"
 
-//typedef void (ScriptImpl::*CommandFunction)(BinaryReader &, Archive &);
-typedef std::function<void(BinaryReader &, Archive &)> CommandFunction;
+class ScriptImpl;
 
-class Script;
+// Reads one instruction's operands into the program; runs once per instruction when the script is loaded.
+typedef void (ScriptImpl::*CommandDecoder)(BinaryReader &, ScriptProgram &);
 
 class ScriptImpl {
 public:
@@ -30,9 +30,9 @@ protected:
 	virtual void setupCommands() = 0;
 
 	/**
-	 * Commands
+	 * Commands. Each decodes its operands into a ScriptOp that Script::run executes; the comments give the bytecode.
 	 */
-	std::vector<CommandFunction> commands_;
+	std::vector<CommandDecoder> commands_;
 
 public:
 
@@ -41,192 +41,192 @@ public:
 	 * Perform arithmetic operations and store the result in the specified variable
 	 *  op=, ???, op+=, op-=, op*=, op/=
 	 */
-	void set_variable(BinaryReader &br, Archive &archive);
+	void set_variable(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	 * [42] ???
 	 */
-	void command42(BinaryReader &br, Archive &archive);
+	void command42(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	 * [46] jump_if
 	 */
-	void jump_if(BinaryReader &br, Archive &archive);
+	void jump_if(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	 * [47] jump(offset:u32)
 	 */
-	void jump(BinaryReader &br, Archive &archive);
+	void jump(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	 * [48] call(offset:u32)
 	 */
-	void call(BinaryReader &br, Archive &archive);
+	void call(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	 * [49] return
 	 */
-	void return_(BinaryReader &br, Archive &archive);
+	void return_(BinaryReader &br, ScriptProgram &program);
 	
 	/**
 	 * [4A] branch_on_variable(var:u16, count:u16, offset1:u32[, offset2:u32...])
 	 * Checks the value of the first argument and jumps to the corresponding address in the argument list
 	 */
-	void branch_on_variable(BinaryReader &br, Archive &archive);
+	void branch_on_variable(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	 * [4D] push(count:u8, val1:u16[, val2:u16...])
 	 */
-	void push(BinaryReader &br, Archive &archive);
+	void push(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	 * [4E] pop(count:u8, var1:u16[, var2:u16...])
 	 */
-	void pop(BinaryReader &br, Archive &archive);
+	void pop(BinaryReader &br, ScriptProgram &program);
 	
 	/**
 	 * [80] unlock_content(id:u16)
 	 */
-	void unlock_content(BinaryReader &br, Archive &archive);
+	void unlock_content(BinaryReader &br, ScriptProgram &program);
 
-	void command81(BinaryReader &br, Archive &archive) {
+	void command81(BinaryReader &br, ScriptProgram &program) {
 		br.skip(4);
 	}
 	
 	/**
 	 * [83] wait(frames:u16)
 	 */
-	void wait(BinaryReader &br, Archive &archive);
+	void wait(BinaryReader &br, ScriptProgram &program);
 
-	void command85(BinaryReader &br, Archive &archive);
+	void command85(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	* [86] display_text(id:u16, unk:u8, pause:u8, text:str16)
 	*/
-	void display_text(BinaryReader &br, Archive &archive);
+	void display_text(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	* [87] wait_msg_advance(segment:u16)
 	*/
-	void wait_msg_advance(BinaryReader &br, Archive &archive);
+	void wait_msg_advance(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	* [88] return_to_message()
 	*/
-	void return_to_message(BinaryReader &br, Archive &archive);
+	void return_to_message(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	* [89] hide_text()
 	*/
-	void hide_text(BinaryReader &br, Archive &archive);
+	void hide_text(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	* [8C/8D] show_choices(unk:u32, var:u16, unk2:i16, title:str8, choices:splitstr8)
 	*/
-	void show_choices(BinaryReader &br, Archive &archive);
+	void show_choices(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	* [8D/??] do_transition(...)
 	*/
-	void do_transition(BinaryReader &br, Archive &archive);
+	void do_transition(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	* [9C] play_bgm(id:u16, unk:u16, volume:u32)
 	*/
-	void play_bgm(BinaryReader &br, Archive &archive);
+	void play_bgm(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	* [9D] stop_bgm(frames:u16)
 	*/
-	void stop_bgm(BinaryReader &br, Archive &archive);
+	void stop_bgm(BinaryReader &br, ScriptProgram &program);
 
-	void command9E(BinaryReader &br, Archive &archive) {
+	void command9E(BinaryReader &br, ScriptProgram &program) {
 		br.skip(4);
 	}
 	/**
 	* [A0] play_se(channel:u16, unk:u16, volume:u32)
 	*/
-	void play_se(BinaryReader &br, Archive &archive);
+	void play_se(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	* [A1] stop_se(channel:u16, frames:u16)
 	*/
-	void stop_se(BinaryReader &br, Archive &archive);
+	void stop_se(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	* [A2] stop_all_se(frames:u16)
 	*/
-	void stop_all_se(BinaryReader &br, Archive &archive);
+	void stop_all_se(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	* [A3] set_se_volume(channel:u16, volume:u16, frames?:u16)
 	*/
-	void set_se_volume(BinaryReader &br, Archive &archive);
+	void set_se_volume(BinaryReader &br, ScriptProgram &program);
 
-	void commandA4(BinaryReader &br, Archive &archive) {
+	void commandA4(BinaryReader &br, ScriptProgram &program) {
 		br.skip(7); // Japanese character used in here?
 	}
 
 	/**
 	* [A6] shake(unk1:u16, unk2:u16)
 	*/
-	void shake(BinaryReader &br, Archive &archive) {
-		auto unk1 = script_.getVariable(br.read<uint16_t>());
-		auto unk2 = script_.getVariable(br.read<uint16_t>());
+	void shake(BinaryReader &br, ScriptProgram &program) {
+		auto unk1 = br.read<uint16_t>();
+		auto unk2 = br.read<uint16_t>();
 	}
 
 	/**
 	* [B0/A0] set_title(unk:u16, title:string)
 	*/
-	void set_title(BinaryReader &br, Archive &archive);
+	void set_title(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	* [B1] play_movie(id:u16)
 	*/
-	void play_movie(BinaryReader &br, Archive &archive);
+	void play_movie(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	* [B2] movie_related_B2(unk:u16)
 	*/
-	void movie_related_B2(BinaryReader &br, Archive &archive);
+	void movie_related_B2(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	* [B3] movie_related_B3()
 	*/
-	void movie_related_B3(BinaryReader &br, Archive &archive);
+	void movie_related_B3(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	* [B4] movie_related_B4()
 	*/
-	void movie_related_B4(BinaryReader &br, Archive &archive);
+	void movie_related_B4(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	* [B6] autosave()
 	*/
-	void autosave(BinaryReader &br, Archive &archive);
+	void autosave(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	* [BE] unlock_trophy(id:u16)
 	*/
-	void unlock_trophy(BinaryReader &br, Archive &archive);
+	void unlock_trophy(BinaryReader &br, ScriptProgram &program);
 
-	void commandBF(BinaryReader &br, Archive &archive);
+	void commandBF(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	* [C1] display_image(...)
 	*/
-	void display_image(BinaryReader &br, Archive &archive);
+	void display_image(BinaryReader &br, ScriptProgram &program);
 
 	/**
 	* [C2] set_layer_property(layer:u16, property:u16, unk:u8, ...)
 	*/
-	void set_layer_property(BinaryReader &br, Archive &archive);
+	void set_layer_property(BinaryReader &br, ScriptProgram &program);
 
-	void commandC3(BinaryReader &br, Archive &archive);
+	void commandC3(BinaryReader &br, ScriptProgram &program);
 
-	void commandC9(BinaryReader &br, Archive &archive);
+	void commandC9(BinaryReader &br, ScriptProgram &program);
 
-	void commandCA(BinaryReader &br, Archive &archive);
+	void commandCA(BinaryReader &br, ScriptProgram &program);
 
-	void commandCB(BinaryReader &br, Archive &archive);
+	void commandCB(BinaryReader &br, ScriptProgram &program);
 };
\ No newline at end of file
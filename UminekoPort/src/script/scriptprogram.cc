@@ -0,0 +1,95 @@
+#include "scriptprogram.h"
+
+#include <sstream>
+#include <stdexcept>
+
+void ScriptProgram::clear() {
+	instructions_.clear();
+	operands_.clear();
+	strings_.clear();
+	targets_.clear();
+	nextTarget_ = 0;
+	indices_.clear();
+}
+
+bool ScriptProgram::nextEntry(uint32_t &offset, uint32_t first, uint32_t last) {
+	for (; nextTarget_ < targets_.size(); ++nextTarget_) {
+		auto target = operands_[targets_[nextTarget_]];
+		if (target >= first && target < last && !contains(target)) {
+			offset = target;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ScriptProgram::begin(uint8_t opcode, uint32_t offset) {
+	ScriptInstruction instruction;
+	instruction.op = ScriptOp::Nop;
+	instruction.opcode = opcode;
+	instruction.operandCount = 0;
+	instruction.operands = static_cast<uint32_t>(operands_.size());
+	instruction.offset = offset;
+	indices_[offset] = static_cast<uint32_t>(instructions_.size());
+	instructions_.push_back(instruction);
+}
+
+void ScriptProgram::target(uint32_t offset) {
+	targets_.push_back(static_cast<uint32_t>(operands_.size()));
+	operand(offset);
+}
+
+void ScriptProgram::string(std::string &&value) {
+	operand(static_cast<uint32_t>(strings_.size()));
+	strings_.push_back(std::move(value));
+}
+
+void ScriptProgram::discard() {
+	auto &instruction = instructions_.back();
+	while (!targets_.empty() && targets_.back() >= instruction.operands) {
+		targets_.pop_back();
+	}
+	operands_.resize(instruction.operands);
+	indices_.erase(instruction.offset);
+	instructions_.pop_back();
+}
+
+void ScriptProgram::unreachable(uint32_t offset) {
+	begin(0, offset);
+	setOp(ScriptOp::Unreachable);
+}
+
+void ScriptProgram::link(uint32_t offset) {
+	ScriptInstruction instruction;
+	instruction.op = ScriptOp::Continue;
+	instruction.opcode = 0;
+	instruction.operandCount = 0;
+	instruction.operands = static_cast<uint32_t>(operands_.size());
+	instruction.offset = offset;
+	instructions_.push_back(instruction);
+	target(offset);
+}
+
+void ScriptProgram::finish() {
+	for (auto slot : targets_) {
+		auto offset = operands_[slot];
+		auto it = indices_.find(offset);
+		if (it == indices_.end()) {
+			unreachable(offset);
+			it = indices_.find(offset);
+		}
+		operands_[slot] = it->second;
+	}
+	targets_.clear();
+	nextTarget_ = 0;
+}
+
+uint32_t ScriptProgram::offsetIndex(uint32_t offset) const {
+	auto it = indices_.find(offset);
+	if (it == indices_.end()) {
+		std::stringstream ss;
+		ss << "No script instruction starts at 0x" << std::hex << offset << ".";
+		throw std::runtime_error(ss.str());
+	}
+	return it->second;
+}
\ No newline at end of file
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// What a decoded instruction does. Opcodes whose handlers only skipped their operands decode to Nop, and one operation
+// that the games encode differently (such as the higurashi layer property numbers) decodes to a single op. Operands
+// marked "value" may name a variable and are resolved with Script::getVariable when the instruction runs.
+enum class ScriptOp : uint8_t {
+	// No decoder for the opcode; reports it when reached.
+	Invalid,
+	// An offset that could not be decoded: the end of the file, an instruction running past it, or a jump target outside
+	// the code.
+	Unreachable,
+	// target; joins a run of decoded code to code decoded earlier from another entry point
+	Continue,
+	Nop,
+	// operation, variable, value
+	SetVariable,
+	// operation, variable, left value, right value
+	SetVariableBinary,
+	// operation, value, compareTo value, target
+	JumpIf,
+	// target
+	Jump,
+	// target
+	Call,
+	Return,
+	// value, target...
+	BranchOnVariable,
+	// value...
+	Push,
+	// variable...
+	Pop,
+	// frames
+	Wait,
+	// pause, text string
+	DisplayText,
+	// segment
+	WaitMsgAdvance,
+	HideText,
+	// frames value; applies layers afterwards
+	Transition,
+	// mask value, frames value; applies layers afterwards
+	MaskTransition,
+	ApplyLayers,
+	// bgm value, volume
+	PlayBgm,
+	// frames value
+	StopBgm,
+	// channel, se, volume
+	PlaySe,
+	// channel value, frames value
+	StopSe,
+	// frames value
+	StopAllSe,
+	// channel value, volume
+	SetSeVolume,
+	Autosave,
+	// layer
+	ClearLayer,
+	// layer, sprite, whether sprite is a value
+	DisplaySprite,
+	// layer, cg, whether cg is a value, offset after the instruction
+	DisplayPicture,
+	// type
+	UnknownImage,
+	// layer value, property (umineko numbering), value
+	SetLayerProperty
+};
+
+struct ScriptInstruction {
+	ScriptOp op;
+	// Byte the instruction was decoded from.
+	uint8_t opcode;
+	uint16_t operandCount;
+	// Index of the first operand in the program's operand array.
+	uint32_t operands;
+	// Offset of the opcode in the script file.
+	uint32_t offset;
+};
+
+// A script's code decoded once at load time. Instructions sit in one array and reference their operands in a second
+// one, so running an instruction never goes back to the bytecode. Code is decoded in runs, from the entry point and
+// then from every jump target not reached yet, so an opcode without a decoder only ends its own run. Jump targets are
+// stored as instruction indices; offsetIndex maps the other way for anything that still deals in file offsets.
+class ScriptProgram {
+public:
+	void clear();
+
+	bool contains(uint32_t offset) const {
+		return indices_.count(offset) != 0;
+	}
+	// Finds a jump target in [first, last) that no run has reached yet.
+	bool nextEntry(uint32_t &offset, uint32_t first, uint32_t last);
+
+	// Starts an instruction as a Nop; the opcode's decoder then sets the op and appends operands.
+	void begin(uint8_t opcode, uint32_t offset);
+	void setOp(ScriptOp op) {
+		instructions_.back().op = op;
+	}
+	void operand(uint32_t value) {
+		operands_.push_back(value);
+		++instructions_.back().operandCount;
+	}
+	// A byte offset to jump to, replaced by the target's instruction index in finish().
+	void target(uint32_t offset);
+	// Stores the string once and appends its index.
+	void string(std::string &&value);
+	// Drops the instruction begun last, for an opcode whose operands ran past the end of the script.
+	void discard();
+	// Ends a run with an Unreachable instruction at offset.
+	void unreachable(uint32_t offset);
+	// Ends a run that fell through into already decoded code at offset.
+	void link(uint32_t offset);
+	// Resolves jump targets to instruction indices.
+	void finish();
+
+	size_t size() const {
+		return instructions_.size();
+	}
+
+	const ScriptInstruction &operator[](size_t index) const {
+		return instructions_[index];
+	}
+
+	const uint32_t *operands(const ScriptInstruction &instruction) const {
+		return operands_.data() + instruction.operands;
+	}
+
+	const std::string &string(uint32_t index) const {
+		return strings_[index];
+	}
+
+	// Index of the instruction starting at offset. Throws if no decoded instruction does.
+	uint32_t offsetIndex(uint32_t offset) const;
+private:
+	std::vector<ScriptInstruction> instructions_;
+	std::vector<uint32_t> operands_;
+	std::vector<std::string> strings_;
+	// Operand slots holding byte offsets until finish().
+	std::vector<uint32_t> targets_;
+	// Slots in targets_ that nextEntry has already looked at.
+	size_t nextTarget_ = 0;
+	// Offset of each decoded or Unreachable instruction to its index. Continue instructions share the offset of their
+	// target and are not listed.
+	std::unordered_map<uint32_t, uint32_t> indices_;
+};
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include "scripttrace.h"
+
+#include <algorithm>
+#include <cstring>
+
+ScriptTraceBuffer::ScriptTraceBuffer() : words_(new std::atomic<uint64_t>[Capacity * Words]) {
+	for (size_t i = 0; i < Capacity * Words; ++i) {
+		words_[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+void ScriptTraceBuffer::record(const ScriptTraceRecord &record) {
+	auto index = published_.load(std::memory_order_relaxed);
+	started_.store(index + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	uint64_t words[Words];
+	memcpy(words, &record, sizeof(record));
+	auto *slot = &words_[(index % Capacity) * Words];
+	for (size_t i = 0; i < Words; ++i) {
+		slot[i].store(words[i], std::memory_order_relaxed);
+	}
+	published_.store(index + 1, std::memory_order_release);
+}
+
+std::vector<ScriptTraceRecord> ScriptTraceBuffer::latest(size_t count, uint64_t &first) const {
+	auto end = published_.load(std::memory_order_acquire);
+	auto oldest = end - std::min<uint64_t>({ end, count, Capacity });
+
+	std::vector<uint64_t> words((end - oldest) * Words);
+	for (auto index = oldest; index < end; ++index) {
+		auto *slot = &words_[(index % Capacity) * Words];
+		for (size_t i = 0; i < Words; ++i) {
+			words[(index - oldest) * Words + i] = slot[i].load(std::memory_order_relaxed);
+		}
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+	// Slots of records older than this may have been reused while they were copied.
+	auto started = started_.load(std::memory_order_relaxed);
+	first = started > Capacity ? std::min(end, std::max(oldest, started - Capacity)) : oldest;
+
+	std::vector<ScriptTraceRecord> records(end - first);
+	for (size_t i = 0; i < records.size(); ++i) {
+		memcpy(&records[i], &words[(first - oldest + i) * Words], sizeof(ScriptTraceRecord));
+	}
+	return records;
+}
\ No newline at end of file
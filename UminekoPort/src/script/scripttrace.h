@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+enum class ScriptTraceLevel : uint8_t {
+	// Nothing is recorded; the interpreter only checks the level.
+	Off,
+	// Executed instructions go to the script's ScriptTraceBuffer and are disassembled when dumped.
+	Record,
+	// Every executed instruction is disassembled and printed to std::cout as it runs.
+	Print
+};
+
+// One executed instruction.
+struct ScriptTraceRecord {
+	static constexpr size_t MaxOperands = 4;
+
+	// Offset of the opcode in the script file.
+	uint32_t offset;
+	uint8_t opcode;
+	// Operands the instruction has, of which the first MaxOperands are kept.
+	uint8_t operandCount;
+	uint16_t padding;
+	// Decoded operand words, with jump targets as instruction indices.
+	uint32_t operands[MaxOperands];
+};
+
+// Fixed-size ring of the most recently executed instructions. One thread records while any other thread may copy the
+// newest records out; neither side locks, and a record the writer overwrote during the copy is left out of it.
+class ScriptTraceBuffer {
+public:
+	static constexpr size_t Capacity = 1 << 12;
+
+	ScriptTraceBuffer();
+
+	// Only the interpreter thread may record.
+	void record(const ScriptTraceRecord &record);
+	// Up to count of the newest records, oldest first. first is set to the sequence number of the first one returned.
+	std::vector<ScriptTraceRecord> latest(size_t count, uint64_t &first) const;
+	// Records made since construction, including those already overwritten.
+	uint64_t total() const {
+		return published_.load(std::memory_order_acquire);
+	}
+private:
+	static constexpr size_t Words = sizeof(ScriptTraceRecord) / sizeof(uint64_t);
+	static_assert(sizeof(ScriptTraceRecord) % sizeof(uint64_t) == 0, "ScriptTraceRecord must be a whole number of words.");
+
+	std::unique_ptr<std::atomic<uint64_t>[]> words_;
+	// Bumped before a slot is overwritten, so readers can tell which slots changed under them.
+	std::atomic<uint64_t> started_ { 0 };
+	// Records that are completely written.
+	std::atomic<uint64_t> published_ { 0 };
+};
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "scriptvariables.h"
+
+void ScriptVariables::apply(uint8_t operation, uint16_t variable, uint16_t value) {
+	auto op1 = resolve(variable);
+	auto op2 = resolve(value);
+	switch (operation) {
+	case 0: // set (confirmed?)
+		assign(variable, op2);
+		break;
+	case 1: // same as 0? appears to be set
+		assign(variable, op2); // ???
+		break;
+	case 2: // add (confirmed?)
+		assign(variable, op1 + op2);
+		break;
+	case 3: // subtract (confirmed?)
+		assign(variable, op1 - op2);
+		break;
+	case 4: // multiply (confirmed?)
+		assign(variable, op1 * op2);
+		break;
+	case 5: // divide (confirmed?)
+		assign(variable, op1 / op2);
+		break;
+	default:
+		throw std::runtime_error("Unhandled operation.");
+	}
+}
+
+void ScriptVariables::apply(uint8_t operation, uint16_t variable, uint16_t left, uint16_t right) {
+	auto op1 = resolve(left);
+	auto op2 = resolve(right);
+	switch (operation) {
+	case 2: // add (confirmed?)
+		assign(variable, op1 + op2);
+		break;
+	case 3: // subtract (confirmed?)
+		assign(variable, op1 - op2);
+		break;
+	case 4: // multiply (confirmed?)
+		assign(variable, op1 * op2);
+		break;
+	case 5: // divide (confirmed?)
+		assign(variable, op1 / op2);
+		break;
+	default:
+		throw std::runtime_error("Unhandled operation.");
+	}
+}
+
+bool ScriptVariables::compare(uint32_t operation, int16_t value, int16_t compareTo) {
+	switch (operation) {
+	case 0: // equal to (confirmed!)
+		return value == compareTo;
+	case 1: // Not equal to (confirmed!)
+		return value != compareTo;
+	case 2: // greater than or equal to (confirmed!)
+		return value >= compareTo;
+	case 3: // greater than (confirmed!)
+		return value > compareTo;
+	case 4: // less than or equal to (confirmed!)
+		return value <= compareTo;
+	case 5: // less than (confirmed!)
+		return value < compareTo;
+	case 6: // ???
+		return false;
+	default:
+		throw std::runtime_error("Unsupported jump_if operation: " + std::to_string(operation));
+	}
+}
+
+void ScriptVariables::reset() {
+	values_.fill(0);
+	for (auto index : modified_) {
+		modifiedBits_[index / 64] = 0;
+	}
+	modified_.clear();
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// The script's variables. An operand in 0x8000-0x8FFF names one of Count variables and anything else is a literal, so
+// the values fit in one flat array. The first write to each slot is noted as well, in a bitmap and in a list, so
+// snapshots only have to visit the slots that were ever written.
+class ScriptVariables {
+public:
+	static constexpr size_t Count = 0x1000;
+
+	static bool isVariable(uint16_t value) {
+		// Negative values that aren't variables also work so not 100% sure where the "cut-off point" is
+		return (value >> 0xC) == 0x8;
+	}
+
+	// The variable an operand names, or the operand itself if it is a literal.
+	int16_t resolve(uint16_t value) const {
+		if (isVariable(value)) {
+			return values_[value & (Count - 1)];
+		}
+		return (int16_t)value;
+	}
+
+	// Throws if the operand does not name a variable.
+	void assign(uint16_t variable, int16_t value) {
+		if (!isVariable(variable)) {
+			throw std::runtime_error("Not a variable: " + std::to_string(variable));
+		}
+		set(variable & (Count - 1), value);
+	}
+
+	int16_t get(uint16_t index) const {
+		return values_[index];
+	}
+
+	void set(uint16_t index, int16_t value) {
+		values_[index] = value;
+		auto &word = modifiedBits_[index / 64];
+		auto bit = uint64_t(1) << (index % 64);
+		if (!(word & bit)) {
+			word |= bit;
+			modified_.push_back(index);
+		}
+	}
+
+	// variable = variable <operation> value, as set_variable does it.
+	void apply(uint8_t operation, uint16_t variable, uint16_t value);
+	// variable = left <operation> right.
+	void apply(uint8_t operation, uint16_t variable, uint16_t left, uint16_t right);
+	// Whether a jump_if with this comparison is taken.
+	static bool compare(uint32_t operation, int16_t value, int16_t compareTo);
+
+	// Every slot ever written, in the order they were first written. Slots not on it are still zero, which saves rely on.
+	const std::vector<uint16_t> &modified() const {
+		return modified_;
+	}
+	// Sets every variable back to zero.
+	void reset();
+private:
+	std::array<int16_t, Count> values_ {};
+	std::array<uint64_t, Count / 64> modifiedBits_ {};
+	std::vector<uint16_t> modified_;
+};
\ No newline at end of file
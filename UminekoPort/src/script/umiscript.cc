@@ -60,52 +60,52 @@ void UmiScript::readAnims(BinaryReader &br, uint32_t offset) {
 
 void UmiScript::setupCommands() {
 	commands_.resize(0x100, nullptr);
-	commands_[0x41] = std::bind(&ScriptImpl::set_variable, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x42] = std::bind(&ScriptImpl::command42, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x46] = std::bind(&ScriptImpl::jump_if, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x47] = std::bind(&ScriptImpl::jump, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x48] = std::bind(&ScriptImpl::call, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x49] = std::bind(&ScriptImpl::return_, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x4A] = std::bind(&ScriptImpl::branch_on_variable, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x4D] = std::bind(&ScriptImpl::push, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x4E] = std::bind(&ScriptImpl::pop, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x80] = std::bind(&ScriptImpl::unlock_content, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x81] = std::bind(&ScriptImpl::command81, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x82] = std::bind(&UmiScript::command82, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x83] = std::bind(&ScriptImpl::wait, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x85] = std::bind(&ScriptImpl::command85, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x86] = std::bind(&ScriptImpl::display_text, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x87] = std::bind(&ScriptImpl::wait_msg_advance, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x88] = std::bind(&ScriptImpl::return_to_message, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x89] = std::bind(&ScriptImpl::hide_text, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x8C] = std::bind(&ScriptImpl::show_choices, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x8D] = std::bind(&ScriptImpl::do_transition, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x9C] = std::bind(&ScriptImpl::play_bgm, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x9D] = std::bind(&ScriptImpl::stop_bgm, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0x9E] = std::bind(&ScriptImpl::command9E, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xA0] = std::bind(&ScriptImpl::play_se, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xA1] = std::bind(&ScriptImpl::stop_se, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xA2] = std::bind(&ScriptImpl::stop_all_se, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xA3] = std::bind(&ScriptImpl::set_se_volume, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xA4] = std::bind(&ScriptImpl::commandA4, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xA6] = std::bind(&ScriptImpl::shake, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xB0] = std::bind(&ScriptImpl::set_title, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xB1] = std::bind(&ScriptImpl::play_movie, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xB2] = std::bind(&ScriptImpl::movie_related_B2, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xB3] = std::bind(&ScriptImpl::movie_related_B3, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xB4] = std::bind(&ScriptImpl::movie_related_B4, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xB6] = std::bind(&ScriptImpl::autosave, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xBE] = std::bind(&ScriptImpl::unlock_trophy, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xBF] = std::bind(&ScriptImpl::commandBF, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xC1] = std::bind(&ScriptImpl::display_image, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xC2] = std::bind(&ScriptImpl::set_layer_property, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xC3] = std::bind(&ScriptImpl::commandC3, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xC9] = std::bind(&ScriptImpl::commandC9, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xCA] = std::bind(&ScriptImpl::commandCA, this, std::placeholders::_1, std::placeholders::_2);
-	commands_[0xCB] = std::bind(&ScriptImpl::commandCB, this, std::placeholders::_1, std::placeholders::_2);
+	commands_[0x41] = &ScriptImpl::set_variable;
+	commands_[0x42] = &ScriptImpl::command42;
+	commands_[0x46] = &ScriptImpl::jump_if;
+	commands_[0x47] = &ScriptImpl::jump;
+	commands_[0x48] = &ScriptImpl::call;
+	commands_[0x49] = &ScriptImpl::return_;
+	commands_[0x4A] = &ScriptImpl::branch_on_variable;
+	commands_[0x4D] = &ScriptImpl::push;
+	commands_[0x4E] = &ScriptImpl::pop;
+	commands_[0x80] = &ScriptImpl::unlock_content;
+	commands_[0x81] = &ScriptImpl::command81;
+	commands_[0x82] = static_cast<CommandDecoder>(&UmiScript::command82);
+	commands_[0x83] = &ScriptImpl::wait;
+	commands_[0x85] = &ScriptImpl::command85;
+	commands_[0x86] = &ScriptImpl::display_text;
+	commands_[0x87] = &ScriptImpl::wait_msg_advance;
+	commands_[0x88] = &ScriptImpl::return_to_message;
+	commands_[0x89] = &ScriptImpl::hide_text;
+	commands_[0x8C] = &ScriptImpl::show_choices;
+	commands_[0x8D] = &ScriptImpl::do_transition;
+	commands_[0x9C] = &ScriptImpl::play_bgm;
+	commands_[0x9D] = &ScriptImpl::stop_bgm;
+	commands_[0x9E] = &ScriptImpl::command9E;
+	commands_[0xA0] = &ScriptImpl::play_se;
+	commands_[0xA1] = &ScriptImpl::stop_se;
+	commands_[0xA2] = &ScriptImpl::stop_all_se;
+	commands_[0xA3] = &ScriptImpl::set_se_volume;
+	commands_[0xA4] = &ScriptImpl::commandA4;
+	commands_[0xA6] = &ScriptImpl::shake;
+	commands_[0xB0] = &ScriptImpl::set_title;
+	commands_[0xB1] = &ScriptImpl::play_movie;
+	commands_[0xB2] = &ScriptImpl::movie_related_B2;
+	commands_[0xB3] = &ScriptImpl::movie_related_B3;
+	commands_[0xB4] = &ScriptImpl::movie_related_B4;
+	commands_[0xB6] = &ScriptImpl::autosave;
+	commands_[0xBE] = &ScriptImpl::unlock_trophy;
+	commands_[0xBF] = &ScriptImpl::commandBF;
+	commands_[0xC1] = &ScriptImpl::display_image;
+	commands_[0xC2] = &ScriptImpl::set_layer_property;
+	commands_[0xC3] = &ScriptImpl::commandC3;
+	commands_[0xC9] = &ScriptImpl::commandC9;
+	commands_[0xCA] = &ScriptImpl::commandCA;
+	commands_[0xCB] = &ScriptImpl::commandCB;
 }
 
-void UmiScript::command82(BinaryReader &br, Archive &archive) {
+void UmiScript::command82(BinaryReader &br, ScriptProgram &program) {
 	auto unk = br.read<uint16_t>();
 	auto unk2 = br.read<uint16_t>();
 }
\ No newline at end of file
@@ -18,5 +18,5 @@ protected:
 
 public:
 
-	void command82(BinaryReader &br, Archive &archive);
+	void command82(BinaryReader &br, ScriptProgram &program);
 };
\ No newline at end of file
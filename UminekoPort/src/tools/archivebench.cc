@@ -0,0 +1,152 @@
+#include "archivebench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+
+namespace {
+
+bool hasExtension(std::string_view path, const char *extension) {
+	auto length = strlen(extension);
+	return path.size() >= length && path.compare(path.size() - length, length, extension) == 0;
+}
+
+template <typename Call>
+double medianMilliseconds(size_t repetitions, Call call) {
+	std::vector<double> times;
+	for (size_t i = 0; i < std::max<size_t>(repetitions, 1); ++i) {
+		auto start = std::chrono::steady_clock::now();
+		call();
+		times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	std::sort(times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+}
+
+std::string ArchiveBench::largestPic() const {
+	Archive archive;
+	archive.open(romPath_);
+	std::string largest;
+	uint64_t largestPixels = 0;
+	for (uint32_t i = 0; i < archive.index().count(); ++i) {
+		std::string path(archive.index().path({ i }));
+		if (!hasExtension(path, ".pic")) {
+			continue;
+		}
+		try {
+			auto pic = archive.getPic(ArchiveHandle { i });
+			auto pixels = static_cast<uint64_t>(pic->width) * pic->height;
+			if (pixels > largestPixels) {
+				largest = path;
+				largestPixels = pixels;
+			}
+		} catch (const std::exception &) {
+			// Not every .pic in the ROM decodes; those are not candidates.
+		}
+	}
+	if (largest.empty()) {
+		throw std::runtime_error("No PIC in " + romPath_ + " decodes.");
+	}
+	return largest;
+}
+
+std::vector<DecodeScalingResult> ArchiveBench::decodeScaling(const std::string &path, size_t maxThreads, size_t repetitions) const {
+	std::vector<DecodeScalingResult> results;
+	for (size_t threads = 1; threads <= maxThreads; ++threads) {
+		Archive archive;
+		archive.setDecodeThreads(threads);
+		archive.open(romPath_);
+		auto handle = archive.resolve(path);
+		// Starts the workers and faults in the ROM pages before anything is timed.
+		archive.getPic(handle);
+		results.push_back({ threads, medianMilliseconds(repetitions, [&]() {
+			archive.getPic(handle);
+		}) });
+	}
+	return results;
+}
+
+std::string ArchiveBench::largestTxa(char version) const {
+	Archive archive;
+	archive.open(romPath_);
+	std::string largest;
+	uint64_t largestBytes = 0;
+	for (uint32_t i = 0; i < archive.index().count(); ++i) {
+		std::string path(archive.index().path({ i }));
+		if (!hasExtension(path, ".txa")) {
+			continue;
+		}
+		try {
+			auto file = archive.fetch(ArchiveHandle { i });
+			if (file.size() < 4 || file.data()[3] != version) {
+				continue;
+			}
+			auto txa = archive.getTxa(ArchiveHandle { i });
+			if (txa->data->size() > largestBytes) {
+				largest = path;
+				largestBytes = txa->data->size();
+			}
+		} catch (const std::exception &) {
+			// As in largestPic, entries that fail to load are not candidates.
+		}
+	}
+	return largest;
+}
+
+AtlasBenchResult ArchiveBench::atlas(const std::string &path, size_t threads, size_t repetitions) const {
+	AtlasBenchResult result;
+	result.path = path;
+	for (auto decodeThreads : { size_t(1), threads }) {
+		Archive archive;
+		archive.setDecodeThreads(decodeThreads);
+		archive.open(romPath_);
+		auto handle = archive.resolve(path);
+		auto txa = archive.getTxa(handle);
+		result.version = static_cast<char>(archive.fetch(handle).data()[3]);
+		result.parts = txa->subentries.size();
+		result.decodedBytes = txa->data->size();
+		auto time = medianMilliseconds(repetitions, [&]() {
+			archive.getTxa(handle);
+		});
+		if (decodeThreads != 1) {
+			result.parallelMilliseconds = time;
+			continue;
+		}
+		result.serialMilliseconds = time;
+		result.copyMilliseconds = medianMilliseconds(repetitions, [&]() {
+			auto txa = archive.getTxa(handle);
+			std::vector<std::vector<unsigned char>> parts;
+			parts.reserve(txa->subentries.size());
+			for (const auto &subentry : txa->subentries) {
+				parts.emplace_back(subentry.pixels.begin(), subentry.pixels.end());
+			}
+		});
+	}
+	return result;
+}
+
+void ArchiveBench::print(std::ostream &output, const std::string &title, const std::vector<DecodeScalingResult> &results) {
+	output << title << ":\n";
+	output << std::right << std::setw(9) << "threads" << std::setw(10) << "ms" << std::setw(10) << "speedup" << '\n';
+	output << std::fixed;
+	for (const auto &row : results) {
+		output << std::setw(9) << row.threads << std::setw(10) << std::setprecision(2) << row.milliseconds
+			<< std::setw(9) << std::setprecision(2) << results.front().milliseconds / row.milliseconds << "x\n";
+	}
+	output << std::defaultfloat;
+}
+
+void ArchiveBench::print(std::ostream &output, const std::vector<AtlasBenchResult> &results) {
+	output << std::left << std::setw(24) << "atlas" << std::right << std::setw(5) << "TXA" << std::setw(7) << "parts" << std::setw(8) << "MB"
+		<< std::setw(11) << "serial ms" << std::setw(13) << "parallel ms" << std::setw(11) << "+copy ms" << '\n';
+	output << std::fixed;
+	for (const auto &row : results) {
+		output << std::left << std::setw(24) << row.path << std::right << std::setw(5) << row.version << std::setw(7) << row.parts
+			<< std::setw(8) << std::setprecision(1) << row.decodedBytes / (1024.0 * 1024.0) << std::setprecision(2)
+			<< std::setw(11) << row.serialMilliseconds << std::setw(13) << row.parallelMilliseconds << std::setw(11) << row.copyMilliseconds << '\n';
+	}
+	output << std::defaultfloat;
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../data/archive.h"
+
+struct DecodeScalingResult {
+	size_t threads = 0;
+	// Median wall time of one getPic.
+	double milliseconds = 0;
+};
+
+struct AtlasBenchResult {
+	std::string path;
+	// '3' or '4', the TXA version.
+	char version = 0;
+	size_t parts = 0;
+	uint64_t decodedBytes = 0;
+	// Median getTxa with one decode thread and with the requested number.
+	double serialMilliseconds = 0;
+	double parallelMilliseconds = 0;
+	// Median serial getTxa followed by copying every part into a vector of its own, as sub-entries used to be stored,
+	// against the views getTxa returns now.
+	double copyMilliseconds = 0;
+};
+
+// Times image decoding in isolation from the rest of the engine, with a fresh Archive and no caches for every
+// configuration so each one decodes from the ROM.
+class ArchiveBench {
+public:
+	explicit ArchiveBench(const std::string &romPath) : romPath_(romPath) {}
+
+	// The largest PIC in the ROM by pixel count, such as a full HD CG.
+	std::string largestPic() const;
+	// Decodes path with 1 to maxThreads decode threads, repetitions times each.
+	std::vector<DecodeScalingResult> decodeScaling(const std::string &path, size_t maxThreads, size_t repetitions) const;
+	// The TXA of the given version with the most decoded bytes, or an empty string if the ROM has none.
+	std::string largestTxa(char version) const;
+	AtlasBenchResult atlas(const std::string &path, size_t threads, size_t repetitions) const;
+
+	static void print(std::ostream &output, const std::string &title, const std::vector<DecodeScalingResult> &results);
+	static void print(std::ostream &output, const std::vector<AtlasBenchResult> &results);
+private:
+	std::string romPath_;
+};
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "archivestress.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+bool hasExtension(std::string_view path, const char *extension) {
+	auto length = strlen(extension);
+	return path.size() >= length && path.compare(path.size() - length, length, extension) == 0;
+}
+
+// FNV-1a, continued from hash.
+uint64_t fnv(uint64_t hash, const unsigned char *data, size_t size) {
+	for (size_t i = 0; i < size; ++i) {
+		hash = (hash ^ data[i]) * 0x100000001b3;
+	}
+	return hash;
+}
+
+template <typename T>
+uint64_t fnv(uint64_t hash, const T &value) {
+	return fnv(hash, reinterpret_cast<const unsigned char *>(&value), sizeof(value));
+}
+
+}
+
+ArchiveStressResult ArchiveStress::run(ArchiveBackend backend, size_t threads, size_t passes) const {
+	Archive archive;
+	archive.open(romPath_, backend);
+	auto count = archive.index().count();
+
+	std::vector<uint64_t> reference(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		reference[i] = hash(archive, { i });
+	}
+
+	ArchiveStressResult result;
+	result.backend = backend;
+	result.files = count;
+	std::atomic<uint64_t> checks { 0 }, mismatches { 0 };
+	std::mutex logMutex;
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threads; ++t) {
+		workers.emplace_back([&, t]() {
+			auto first = count * t / threads;
+			for (size_t pass = 0; pass < passes; ++pass) {
+				for (size_t i = 0; i < count; ++i) {
+					auto index = static_cast<uint32_t>((first + i) % count);
+					++checks;
+					if (hash(archive, { index }) != reference[index]) {
+						++mismatches;
+						std::lock_guard<std::mutex> lock(logMutex);
+						std::cerr << "Mismatch on '" << archive.index().path({ index }) << "' in thread " << t << ".\n";
+					}
+				}
+			}
+		});
+	}
+	for (auto &worker : workers) {
+		worker.join();
+	}
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.checks = checks;
+	result.mismatches = mismatches;
+	return result;
+}
+
+uint64_t ArchiveStress::hash(Archive &archive, ArchiveHandle handle) {
+	try {
+		auto data = archive.read(handle);
+		auto hash = fnv(0xcbf29ce484222325, data.data(), data.size());
+		auto path = archive.index().path(handle);
+		if (hasExtension(path, ".pic")) {
+			auto pic = archive.getPic(handle);
+			hash = fnv(fnv(hash, pic->width), pic->height);
+			hash = fnv(hash, pic->pixels.data(), pic->pixels.size());
+		} else if (hasExtension(path, ".bup")) {
+			auto bup = archive.getBup(handle);
+			hash = fnv(fnv(hash, bup->width), bup->height);
+			hash = fnv(hash, bup->pixels.data(), bup->pixels.size());
+			for (const auto &pose : bup->subentries) {
+				hash = fnv(fnv(hash, pose.width), pose.height);
+				hash = fnv(hash, pose.pixels.data(), pose.pixels.size());
+			}
+		}
+		return hash ? hash : 1;
+	} catch (const std::exception &) {
+		return 0;
+	}
+}
+
+void ArchiveStress::print(std::ostream &output, const ArchiveStressResult &result) {
+	output << (result.backend == ArchiveBackend::Mapped ? "Mapped" : "Stream") << " backend: " << result.checks << " calls over "
+		<< result.files << " files in " << result.seconds << " s, " << result.mismatches << " mismatches.\n";
+}
\ No newline at end of file
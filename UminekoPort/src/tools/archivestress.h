@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "../data/archive.h"
+
+struct ArchiveStressResult {
+	ArchiveBackend backend;
+	size_t files = 0;
+	// Calls made by the threads and how many of them gave a different result than the single-threaded pass.
+	uint64_t checks = 0;
+	uint64_t mismatches = 0;
+	double seconds = 0;
+};
+
+// Checks that concurrent calls into one Archive return the same bytes as calls made one at a time. Every entry is read
+// and, for PIC and BUP files, decoded on a single thread first and its hash kept. Then several threads go over the whole
+// index at once, each starting at a different entry, and every result is hashed and compared. An entry that failed to
+// load the first time has to fail again.
+class ArchiveStress {
+public:
+	explicit ArchiveStress(const std::string &romPath) : romPath_(romPath) {}
+
+	ArchiveStressResult run(ArchiveBackend backend, size_t threads, size_t passes) const;
+
+	static void print(std::ostream &output, const ArchiveStressResult &result);
+private:
+	// Hash of the entry's bytes followed by what it decodes to, or 0 if either call threw.
+	static uint64_t hash(Archive &archive, ArchiveHandle handle);
+
+	std::string romPath_;
+};
\ No newline at end of file
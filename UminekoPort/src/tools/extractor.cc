@@ -0,0 +1,98 @@
+#include "extractor.h"
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include "../data/archive.h"
+#include "../math/clock.h"
+#include "../util/threadpool.h"
+
+namespace {
+
+bool hasExtension(const std::string &path, const char *extension) {
+	auto length = strlen(extension);
+	return path.size() >= length && path.compare(path.size() - length, length, extension) == 0;
+}
+
+}
+
+size_t Extractor::run(const std::string &outputDirectory) {
+	Clock clock;
+	const auto &index = archive_.index();
+
+	// Folders are created up front so the workers never race to create the same one.
+	std::vector<std::string> outputPaths(index.count());
+	std::set<std::filesystem::path> folders;
+	for (uint32_t i = 0; i < index.count(); ++i) {
+		outputPaths[i] = outputDirectory + "/" + std::string(index.path({ i }));
+		folders.insert(std::filesystem::path(outputPaths[i]).parent_path());
+	}
+	for (const auto &folder : folders) {
+		std::filesystem::create_directories(folder);
+	}
+
+	std::atomic<size_t> images { 0 };
+	std::atomic<size_t> failures { 0 };
+	std::mutex logMutex;
+	ThreadPool pool;
+	pool.parallelFor(index.count(), [&](size_t i) {
+		try {
+			images += extract({ static_cast<uint32_t>(i) }, outputPaths[i]);
+		} catch (const std::exception &e) {
+			++failures;
+			std::lock_guard<std::mutex> lock(logMutex);
+			std::cerr << "Failed to extract '" << index.path({ static_cast<uint32_t>(i) }) << "': " << e.what() << "\n";
+		}
+	});
+
+	auto seconds = clock.reset();
+	std::cout << "Extracted " << index.count() - failures << " of " << index.count() << " files (" << images << " images) to '"
+		<< outputDirectory << "' in " << seconds << " s, " << (seconds > 0 ? index.count() / seconds : 0) << " files/s.\n";
+	return failures;
+}
+
+size_t Extractor::extract(ArchiveHandle handle, const std::string &outputPath) {
+	auto base = outputPath.substr(0, outputPath.rfind('.'));
+	auto write = [&](const std::string &path, const unsigned char *pixels, int width, int height, int scanline, int bpp) {
+		if (!archive_.writeImage(path, pixels, width, height, scanline, bpp)) {
+			throw std::runtime_error("Unable to write '" + path + "'.");
+		}
+	};
+
+	if (hasExtension(outputPath, ".pic")) {
+		auto pic = archive_.getPic(handle);
+		write(base + ".png", pic->pixels.data(), pic->width, pic->height, pic->width * 4, 4);
+		return 1;
+	} else if (hasExtension(outputPath, ".bup")) {
+		auto bup = archive_.getBup(handle);
+		for (const auto &pose : bup->subentries) {
+			write(base + "_" + pose.name + ".png", pose.pixels.data(), pose.width, pose.height, pose.width * 4, 4);
+		}
+		return bup->subentries.size();
+	} else if (hasExtension(outputPath, ".txa")) {
+		auto txa = archive_.getTxa(handle);
+		for (const auto &texture : txa->subentries) {
+			write(base + "_" + texture.name + ".png", texture.pixels.data(), texture.width, texture.height, texture.scanline, 4);
+		}
+		return txa->subentries.size();
+	} else if (hasExtension(outputPath, ".msk")) {
+		auto msk = archive_.getMsk(handle);
+		write(base + ".png", msk->pixels.data(), msk->width, msk->height, msk->width, 1);
+		return 1;
+	}
+
+	auto data = archive_.fetch(handle);
+	std::ofstream ofs(outputPath, std::ios_base::binary);
+	ofs.write((const char *)data.data(), data.size());
+	if (!ofs) {
+		throw std::runtime_error("Unable to write '" + outputPath + "'.");
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+#include "../data/archiveindex.h"
+
+class Archive;
+
+// Non-interactive counterpart to Archive::explore. Converts every PIC, BUP, TXA and MSK in an archive to PNG and copies
+// everything else as is, mirroring the archive's folders under an output directory. Files are processed in parallel.
+class Extractor {
+public:
+	explicit Extractor(Archive &archive) : archive_(archive) {}
+
+	// Returns the number of files that could not be extracted.
+	size_t run(const std::string &outputDirectory);
+private:
+	// Returns the number of images written, or throws.
+	size_t extract(ArchiveHandle handle, const std::string &outputPath);
+
+	Archive &archive_;
+};
\ No newline at end of file
@@ -0,0 +1,403 @@
+#include "headlessrunner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+#include "../engine/graphicssink.h"
+#include "../engine/savestate.h"
+#include "../audio/audiosink.h"
+#include "../script/script.h"
+
+namespace {
+
+const uint32_t FramesPerSecond = 60;
+const int LayerCount = 0x20;
+static_assert(LayerCount <= 32, "Changed layers are tracked in a 32-bit mask.");
+
+class NullGraphics : public GraphicsSink {
+public:
+	NullGraphics() : layers_(LayerCount) {
+		// Same as the layers GraphicsContext starts with.
+		for (auto &layer : layers_) {
+			layer.properties.sprite.anchor = Anchor::Bottom;
+			layer.properties.sprite.pivot = Pivot::Bottom;
+		}
+		newLayers_ = layers_;
+	}
+
+	void wait(uint32_t frames) override {
+		++result_.waits;
+		result_.simulatedFrames += frames;
+	}
+
+	void transition(uint32_t frames) override {
+		++result_.transitions;
+		result_.simulatedFrames += frames;
+	}
+
+	void transition(const std::string &maskFilename, uint32_t frames) override {
+		transition(frames);
+	}
+
+	GraphicsLayerProperties layerProperties(int layer) override {
+		return newLayers_.at(layer).properties;
+	}
+
+	void setLayerProperties(int layer, GraphicsLayerProperties properties) override {
+		++result_.layerChanges;
+		newLayers_.at(layer).properties = std::move(properties);
+		changed_ |= 1u << layer;
+	}
+
+	void clearLayer(int layer) override {
+		++result_.layerChanges;
+		newLayers_.at(layer).type = LayerType::None;
+		changed_ |= 1u << layer;
+	}
+
+	void setLayer(int layer, const std::string &path) override {
+		++result_.layerChanges;
+		auto &l = newLayers_.at(layer);
+		l.type = LayerType::Default;
+		l.path = path;
+		changed_ |= 1u << layer;
+	}
+
+	void setLayerBup(int layer, const std::string &name, const std::string &pose) override {
+		++result_.layerChanges;
+		auto &l = newLayers_.at(layer);
+		l.type = LayerType::Bup;
+		l.path = "bustup/" + name + ".bup";
+		l.pose = pose;
+		changed_ |= 1u << layer;
+	}
+
+	// Only the layers set since the last call are copied; copying all of them took half the run's time, which hid the
+	// interpreter in the numbers.
+	void applyLayers() override {
+		for (int layer = 0; layer < LayerCount; ++layer) {
+			if (changed_ & (1u << layer)) {
+				layers_[layer] = newLayers_[layer];
+			}
+		}
+		changed_ = 0;
+	}
+
+	void pushMessage(const std::string &text) override {
+		++result_.messages;
+	}
+
+	void hideMessage() override {}
+
+	void waitForMessageSegment(int segment) override {
+		++result_.messageWaits;
+	}
+
+	// Same layout as GraphicsContext's, so snapshots taken here are as large as a windowed run's.
+	void saveState(BinaryWriter &writer) override {
+		writer.write(static_cast<uint32_t>(layers_.size()));
+		for (const auto &layer : layers_) {
+			writeLayer(writer, layer);
+		}
+		for (const auto &layer : newLayers_) {
+			writeLayer(writer, layer);
+		}
+	}
+
+	void restoreState(BinaryReader &br) override {
+		if (br.read<uint32_t>() != layers_.size()) {
+			throw std::runtime_error("Save has a different number of graphics layers.");
+		}
+		for (auto &layer : layers_) {
+			readLayer(br, layer);
+		}
+		for (auto &layer : newLayers_) {
+			readLayer(br, layer);
+		}
+		changed_ = ~0u;
+	}
+
+	// Messages are never left waiting here, so this is an empty message window in MessageWindow's layout: no
+	// messages, four flags and the segment.
+	void saveMessageState(BinaryWriter &writer) override {
+		writer.write(uint32_t(0));
+		writer.write(uint32_t(0));
+		writer.write(int32_t(0));
+	}
+
+	void restoreMessageState(BinaryReader &br) override {
+		if (br.read<uint32_t>() != 0) {
+			throw std::runtime_error("Save has pending messages.");
+		}
+		br.skip(sizeof(uint32_t) + sizeof(int32_t));
+	}
+
+	HeadlessResult &result() {
+		return result_;
+	}
+private:
+	// Same values as GraphicsLayerType.
+	enum class LayerType : uint8_t {
+		None,
+		Default,
+		Bup
+	};
+
+	struct Layer {
+		LayerType type = LayerType::None;
+		std::string path;
+		std::string pose;
+		GraphicsLayerProperties properties {};
+	};
+
+	static void writeLayer(BinaryWriter &writer, const Layer &layer) {
+		writer.write(static_cast<uint8_t>(layer.type));
+		writer.writeString(layer.path);
+		writer.writeString(layer.pose);
+		writer.write(static_cast<uint8_t>(layer.properties.sprite.anchor));
+		writer.write(static_cast<uint8_t>(layer.properties.sprite.pivot));
+		writer.write(layer.properties.sprite.textureRect);
+		writer.write(layer.properties.sprite.pivotOffset);
+		writer.write(layer.properties.sprite.color);
+		writer.write(layer.properties.transform.position);
+		writer.write(layer.properties.transform.scale);
+		writer.write(layer.properties.transform.rotation);
+		writer.write(layer.properties.offset);
+		writer.write(static_cast<uint32_t>(layer.properties.filter));
+		writer.write(static_cast<uint32_t>(layer.properties.blendMode));
+	}
+
+	static void readLayer(BinaryReader &br, Layer &layer) {
+		layer.type = static_cast<LayerType>(br.read<uint8_t>());
+		layer.path = br.readString(br.read<uint32_t>());
+		layer.pose = br.readString(br.read<uint32_t>());
+		layer.properties.sprite.anchor = static_cast<Anchor>(br.read<uint8_t>());
+		layer.properties.sprite.pivot = static_cast<Pivot>(br.read<uint8_t>());
+		layer.properties.sprite.textureRect = br.read<glm::vec4>();
+		layer.properties.sprite.pivotOffset = br.read<glm::ivec2>();
+		layer.properties.sprite.color = br.read<glm::vec4>();
+		layer.properties.transform.position = br.read<glm::vec3>();
+		layer.properties.transform.scale = br.read<glm::vec3>();
+		layer.properties.transform.rotation = br.read<glm::quat>();
+		layer.properties.offset = br.read<glm::ivec2>();
+		layer.properties.filter = static_cast<GraphicsLayerFilter::Flags>(br.read<uint32_t>());
+		layer.properties.blendMode = static_cast<GraphicsLayerBlendMode>(br.read<uint32_t>());
+	}
+
+	std::vector<Layer> layers_;
+	std::vector<Layer> newLayers_;
+	// Bit n is set when newLayers_[n] may differ from layers_[n].
+	uint32_t changed_ = 0;
+	HeadlessResult result_;
+};
+
+class NullAudio : public AudioSink {
+public:
+	NullAudio() : ses_(ChannelCount) {}
+
+	void setSEVolume(int channel, float volume) override {
+		++calls_;
+	}
+
+	void playBGM(const std::string &filename, float volume) override {
+		++calls_;
+		bgm_ = { filename, volume };
+	}
+
+	void stopBGM(int frames) override {
+		++calls_;
+		bgm_ = Playing();
+	}
+
+	void playSE(int channel, const std::string &filename, float volume) override {
+		++calls_;
+		ses_.at(channel) = { filename, volume };
+	}
+
+	void stopSE(int channel, int frames) override {
+		++calls_;
+		ses_.at(channel) = Playing();
+	}
+
+	void stopAllSE(int frames) override {
+		++calls_;
+		std::fill(ses_.begin(), ses_.end(), Playing());
+	}
+
+	// Same layout as AudioManager's: what is playing, not where.
+	void saveState(BinaryWriter &writer) const override {
+		writer.writeString(bgm_.filename);
+		writer.write(bgm_.volume);
+		writer.write(static_cast<uint32_t>(ses_.size()));
+		for (const auto &se : ses_) {
+			writer.writeString(se.filename);
+			writer.write(se.volume);
+		}
+	}
+
+	void restoreState(BinaryReader &br) override {
+		bgm_.filename = br.readString(br.read<uint32_t>());
+		bgm_.volume = br.read<float>();
+		std::vector<Playing> ses(readSaveCount(br, sizeof(uint32_t) + sizeof(float)));
+		for (auto &se : ses) {
+			se.filename = br.readString(br.read<uint32_t>());
+			se.volume = br.read<float>();
+		}
+		ses.resize(ChannelCount);
+		ses_ = std::move(ses);
+	}
+
+	uint64_t calls() const {
+		return calls_;
+	}
+private:
+	static constexpr size_t ChannelCount = 0x20;
+
+	struct Playing {
+		std::string filename;
+		float volume = 0;
+	};
+
+	Playing bgm_;
+	std::vector<Playing> ses_;
+	uint64_t calls_ = 0;
+};
+
+// Loads and runs the script with its output discarded. Returns why it stopped, or an empty string once the instruction
+// limit stops it.
+std::string runSilently(Script &script, const std::string &scriptPath, Archive &archive) {
+	std::string error;
+	auto *output = std::cout.rdbuf(nullptr);
+	try {
+		script.load(scriptPath, archive);
+	} catch (const std::exception &e) {
+		error = e.what();
+	}
+	std::cout.rdbuf(output);
+	return error;
+}
+
+// Sorts the samples in place and returns the nearest-rank percentile.
+double percentile(std::vector<double> &samples, double fraction) {
+	std::sort(samples.begin(), samples.end());
+	auto rank = static_cast<size_t>(fraction * samples.size() + 0.999999);
+	return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+}
+
+}
+
+HeadlessResult HeadlessRunner::run(const std::string &scriptPath, uint64_t instructionLimit) const {
+	NullGraphics graphics;
+	NullAudio audio;
+	Script script(graphics, audio, true);
+	if (instructionLimit) {
+		script.setInstructionLimit(instructionLimit);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	auto error = runSilently(script, scriptPath, archive_);
+	auto end = std::chrono::steady_clock::now();
+
+	auto result = graphics.result();
+	result.error = error;
+	result.seconds = std::chrono::duration<double>(end - start).count();
+	result.audioCalls = audio.calls();
+	const auto &counts = script.opcodeCounts();
+	for (size_t opcode = 0; opcode < counts.size(); ++opcode) {
+		if (counts[opcode]) {
+			result.instructions += counts[opcode];
+			result.opcodes.push_back({ static_cast<uint8_t>(opcode), script.opcodeName(static_cast<uint8_t>(opcode)), counts[opcode] });
+		}
+	}
+	std::stable_sort(result.opcodes.begin(), result.opcodes.end(), [](const HeadlessOpcodeCount &a, const HeadlessOpcodeCount &b) {
+		return a.count > b.count;
+	});
+	return result;
+}
+
+HeadlessSaveResult HeadlessRunner::benchSaves(const std::string &scriptPath, uint64_t instructions, uint32_t repetitions) const {
+	NullGraphics graphics;
+	NullAudio audio;
+	Script script(graphics, audio, true);
+	script.setInstructionLimit(std::max<uint64_t>(instructions, 1));
+
+	HeadlessSaveResult result;
+	result.error = runSilently(script, scriptPath, archive_);
+	if (!result.error.empty()) {
+		return result;
+	}
+	for (const auto &count : script.opcodeCounts()) {
+		result.instructions += count;
+	}
+
+	repetitions = std::max<uint32_t>(repetitions, 1);
+	std::vector<double> saves, restores;
+	saves.reserve(repetitions);
+	restores.reserve(repetitions);
+	std::vector<char> snapshot;
+	for (uint32_t i = 0; i < repetitions; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		snapshot = script.saveState();
+		saves.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+	}
+	result.bytes = snapshot.size();
+	try {
+		for (uint32_t i = 0; i < repetitions; ++i) {
+			auto start = std::chrono::steady_clock::now();
+			script.restoreState(snapshot);
+			restores.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+		}
+	} catch (const std::exception &e) {
+		result.error = e.what();
+		return result;
+	}
+	result.roundTrip = script.saveState() == snapshot;
+
+	result.saveMedian = percentile(saves, 0.5);
+	result.saveP99 = percentile(saves, 0.99);
+	result.restoreMedian = percentile(restores, 0.5);
+	result.restoreP99 = percentile(restores, 0.99);
+	return result;
+}
+
+void HeadlessRunner::print(std::ostream &output, const HeadlessResult &result) {
+	auto simulated = result.simulatedFrames / FramesPerSecond;
+	output << std::fixed;
+	output << result.instructions << " instructions in " << std::setprecision(3) << result.seconds << " s, "
+		<< std::setprecision(1) << result.instructions / result.seconds / 1e6 << " M instr/s.\n";
+	output << "Simulated time " << simulated / 3600 << ':' << std::setfill('0') << std::setw(2) << simulated / 60 % 60 << ':'
+		<< std::setw(2) << simulated % 60 << std::setfill(' ') << " (" << result.simulatedFrames << " frames): "
+		<< result.waits << " waits, " << result.transitions << " transitions.\n";
+	output << result.messages << " messages, " << result.messageWaits << " message waits, " << result.layerChanges
+		<< " layer changes, " << result.audioCalls << " audio calls.\n";
+	output << std::defaultfloat;
+	if (!result.error.empty()) {
+		output << "Stopped: " << result.error << '\n';
+	}
+
+	output << std::left << std::setw(8) << "opcode" << std::setw(24) << "name" << std::right << std::setw(14) << "count"
+		<< std::setw(9) << "share" << '\n';
+	output << std::fixed << std::setprecision(2);
+	for (const auto &opcode : result.opcodes) {
+		output << std::hex << "0x" << std::setw(2) << std::setfill('0') << (int)opcode.opcode << std::dec << std::setfill(' ')
+			<< "    " << std::left << std::setw(24) << opcode.name << std::right << std::setw(14) << opcode.count
+			<< std::setw(8) << 100.0 * opcode.count / result.instructions << "%\n";
+	}
+	output << std::defaultfloat;
+}
+
+void HeadlessRunner::print(std::ostream &output, const HeadlessSaveResult &result) {
+	if (!result.error.empty()) {
+		output << "Failed: " << result.error << '\n';
+		return;
+	}
+	output << std::fixed << std::setprecision(1);
+	output << "Snapshot after " << result.instructions << " instructions: " << result.bytes << " bytes"
+		<< (result.roundTrip ? "" : ", differs after a restore") << ".\n";
+	output << "Save " << result.saveMedian << " us median, " << result.saveP99 << " us p99; restore " << result.restoreMedian
+		<< " us median, " << result.restoreP99 << " us p99.\n";
+	output << std::defaultfloat;
+}
\ No newline at end of file
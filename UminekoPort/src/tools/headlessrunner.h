@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../data/archive.h"
+
+struct HeadlessOpcodeCount {
+	uint8_t opcode;
+	std::string name;
+	uint64_t count;
+};
+
+struct HeadlessResult {
+	uint64_t instructions = 0;
+	// Wall time of the whole run, loading and decoding the script included.
+	double seconds = 0;
+	// Frames the script spent in waits and transitions, which a window shows at 60 per second.
+	uint64_t simulatedFrames = 0;
+	uint64_t waits = 0;
+	uint64_t transitions = 0;
+	uint64_t messages = 0;
+	uint64_t messageWaits = 0;
+	uint64_t layerChanges = 0;
+	uint64_t audioCalls = 0;
+	// Most executed first, opcodes that never ran left out.
+	std::vector<HeadlessOpcodeCount> opcodes;
+	// Why the script stopped. Empty when it reached the instruction limit.
+	std::string error;
+};
+
+struct HeadlessSaveResult {
+	uint64_t instructions = 0;
+	// Size of one snapshot of the script and the sinks.
+	size_t bytes = 0;
+	// Microseconds per Script::saveState and Script::restoreState call.
+	double saveMedian = 0;
+	double saveP99 = 0;
+	double restoreMedian = 0;
+	double restoreP99 = 0;
+	// Whether a snapshot taken right after restoring is the same as the one restored.
+	bool roundTrip = false;
+	// Why the script or a restore failed. Empty on success.
+	std::string error;
+};
+
+// Runs a script with no window, GL context or audio device. Graphics and audio go to sinks that only count what they
+// are asked to do, and the script never pauses, so waits, transitions and message advances take no time and the
+// interpreter runs as fast as it can. What the sinks would have shown is added up as simulated time instead.
+class HeadlessRunner {
+public:
+	explicit HeadlessRunner(Archive &archive) : archive_(archive) {}
+
+	// Runs the script until it fails, finishes or has executed instructionLimit instructions (0 for no limit).
+	// The script's own output is discarded while it runs.
+	HeadlessResult run(const std::string &scriptPath, uint64_t instructionLimit) const;
+	// Runs the script for instructions instructions, then saves where it stopped and restores that snapshot
+	// repetitions times each, as an autosave and --continue would.
+	HeadlessSaveResult benchSaves(const std::string &scriptPath, uint64_t instructions, uint32_t repetitions) const;
+
+	static void print(std::ostream &output, const HeadlessResult &result);
+	static void print(std::ostream &output, const HeadlessSaveResult &result);
+private:
+	Archive &archive_;
+};
\ No newline at end of file
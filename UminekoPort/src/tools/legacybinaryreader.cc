@@ -0,0 +1,70 @@
+#include "legacybinaryreader.h"
+
+LegacyBinaryReader::MemoryBuffer::MemoryBuffer(const char *begin, size_t size) {
+	char *ptr(const_cast<char *>(begin));
+	this->setg(ptr, ptr, ptr + size);
+}
+
+std::streampos LegacyBinaryReader::MemoryBuffer::seekpos(std::streampos pos, std::ios_base::openmode which) {
+	this->setg(this->eback(), this->eback() + pos, this->egptr());
+	return pos;
+}
+
+std::streampos LegacyBinaryReader::MemoryBuffer::seekoff(std::streamoff off, std::ios_base::seekdir way, std::ios_base::openmode which) {
+	switch (way) {
+	case std::ios_base::beg:
+		this->setg(this->eback(), this->eback() + off, this->egptr());
+		break;
+	case std::ios_base::cur:
+		this->gbump(static_cast<int>(off));
+		break;
+	case std::ios_base::end:
+		this->setg(this->eback(), this->egptr() - off, this->egptr());
+		break;
+	}
+	return std::streampos(this->gptr() - this->eback());
+}
+
+LegacyBinaryReader::LegacyBinaryReader(const char *data, size_t size) {
+	memoryBuffer_ = std::make_unique<MemoryBuffer>(data, size);
+	is_ = new std::istream(memoryBuffer_.get());
+	is_->rdbuf(memoryBuffer_.get());
+}
+
+LegacyBinaryReader::~LegacyBinaryReader() {
+	delete is_;
+}
+
+std::istream &LegacyBinaryReader::seekg(std::streampos pos) {
+	return is_->seekg(pos);
+}
+
+std::istream &LegacyBinaryReader::seekg(std::streamoff off, std::ios_base::seekdir way) {
+	return is_->seekg(off, way);
+}
+
+std::streampos LegacyBinaryReader::tellg() {
+	return is_->tellg();
+}
+
+std::istream &LegacyBinaryReader::skip(std::streamoff off) {
+	return is_->seekg(off, std::ios_base::cur);
+}
+
+void LegacyBinaryReader::read(char *buffer, size_t size) {
+	is_->read(buffer, size);
+}
+
+std::string LegacyBinaryReader::readString() {
+	std::string val;
+	std::getline(*is_, val, '\0');
+	return val;
+}
+
+std::string LegacyBinaryReader::readString(size_t length) {
+	char *s = new char[length];
+	is_->read(s, length);
+	std::string val(s, length);
+	delete[] s;
+	return val;
+}
\ No newline at end of file
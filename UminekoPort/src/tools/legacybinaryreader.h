@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+
+#include "../util/endian.h"
+
+// BinaryReader as it was before it became a plain cursor: every read goes through a heap-allocated std::istream over a
+// custom streambuf. Kept unchanged, apart from the names, so --reader-bench can compare the two.
+class LegacyBinaryReader {
+public:
+	LegacyBinaryReader(const char *data, size_t size);
+	~LegacyBinaryReader();
+	LegacyBinaryReader(const LegacyBinaryReader &other) = delete;
+	LegacyBinaryReader &operator=(const LegacyBinaryReader &other) = delete;
+
+	std::istream &seekg(std::streampos pos);
+	std::istream &seekg(std::streamoff off, std::ios_base::seekdir way);
+
+	std::streampos tellg();
+
+	std::istream &skip(std::streamoff off);
+
+	void read(char *buffer, size_t size);
+
+	template <typename T>
+	T read() {
+		T val;
+		is_->read(reinterpret_cast<char *>(&val), sizeof(T));
+		return val;
+	}
+
+	template <typename T>
+	T readBE() {
+		T val;
+		is_->read(reinterpret_cast<char *>(&val), sizeof(T));
+		swapEndian(val);
+		return val;
+	}
+
+	std::string readString();
+	std::string readString(size_t length);
+private:
+	struct MemoryBuffer : public std::basic_streambuf<char> {
+		MemoryBuffer(const char *begin, size_t size);
+	protected:
+		std::streampos seekpos(std::streampos pos, std::ios_base::openmode which = std::ios_base::in) override;
+		std::streampos seekoff(std::streamoff off, std::ios_base::seekdir way, std::ios_base::openmode which = std::ios_base::in) override;
+	};
+
+	std::unique_ptr<MemoryBuffer> memoryBuffer_;
+	std::istream *is_;
+};
\ No newline at end of file
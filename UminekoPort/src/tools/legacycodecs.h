@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The decoders as they were before the bounds-checked rewrites in DataCompression, kept unchanged so the benches can
+// check the new ones against them. They trust their input: nothing stops a corrupt stream from writing past the output
+// or reading before its start, so callers have to leave room on both sides.
+class LegacyCodecs {
+public:
+	// Archive::decode: the picture LZ used by PIC, BUP and TXA. Returns the number of bytes written.
+	static uint32_t decodePicture(const unsigned char *buffer, size_t bufferSize, unsigned char *output);
+	// DataCompression::decompress10_6 and decompress12_4, used by fonts and masks.
+	static std::vector<uint8_t> decompress10_6(const uint8_t *compressedData, size_t compressedSize, size_t decompressedSize);
+	static std::vector<uint8_t> decompress12_4(const uint8_t *compressedData, size_t compressedSize, size_t decompressedSize);
+};
\ No newline at end of file
@@ -0,0 +1,489 @@
+#include "lzssbench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <random>
+
+#include "legacycodecs.h"
+#include "../data/archive.h"
+#include "../data/compression.h"
+#include "../util/binaryreader.h"
+
+namespace {
+
+struct Stream {
+	std::vector<unsigned char> encoded;
+	size_t decodedSize;
+	// Bytes per call to the resumable decoder; an image row where there is one.
+	size_t blockSize;
+};
+
+// Furthest a picture back reference reaches: offset 0x7ff + 32, plus one, in 4-byte pixels. The legacy decoder is given
+// this much room before its output so a corrupt stream cannot read outside the buffer.
+const size_t PictureReach = (0x7ff + 32 + 1) * 4;
+// The legacy decoders read a back reference whole even when the stream ends after its first byte.
+const size_t EncodedSlack = 2;
+
+bool hasExtension(std::string_view path, const char *extension) {
+	auto length = strlen(extension);
+	return path.size() >= length && path.compare(path.size() - length, length, extension) == 0;
+}
+
+template <typename Call>
+double medianMilliseconds(size_t repetitions, Call call) {
+	std::vector<double> times;
+	for (size_t i = 0; i < std::max<size_t>(repetitions, 1); ++i) {
+		auto start = std::chrono::steady_clock::now();
+		call();
+		times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	std::sort(times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+size_t pictureStride(size_t width) {
+	return 4 * ((width + 3) & ~size_t(3));
+}
+
+void addStream(std::vector<Stream> &streams, Span<const unsigned char> file, size_t offset, size_t size, size_t decodedSize, size_t blockSize) {
+	if (offset > file.size() || size > file.size() - offset || decodedSize == 0) {
+		return;
+	}
+	Stream stream;
+	stream.encoded.assign(file.data() + offset, file.data() + offset + size);
+	stream.decodedSize = decodedSize;
+	stream.blockSize = blockSize ? blockSize : decodedSize;
+	streams.push_back(std::move(stream));
+}
+
+// Every picture stream in the ROM, by format. Entries that do not parse are skipped; the engine would reject them.
+void romPictureStreams(const std::string &romPath, std::vector<Stream> &pic, std::vector<Stream> &bup, std::vector<Stream> &txa) {
+	Archive archive;
+	archive.open(romPath);
+	for (uint32_t i = 0; i < archive.index().count(); ++i) {
+		ArchiveHandle handle { i };
+		auto path = archive.index().path(handle);
+		bool isPic = hasExtension(path, ".pic"), isBup = hasExtension(path, ".bup"), isTxa = hasExtension(path, ".txa");
+		if (!isPic && !isBup && !isTxa) {
+			continue;
+		}
+		try {
+			auto file = archive.fetch(handle);
+			BinaryReader br(file.view());
+			if (br.size() < 4 || (isPic && file.data()[3] != '3') || (isTxa && file.data()[3] != '3')) {
+				continue;
+			}
+			if (isPic) {
+				br.skip(20);
+				auto chunks = br.read<uint32_t>();
+				for (uint32_t c = 0; c < chunks; ++c) {
+					br.skip(8);
+					auto width = br.read<uint16_t>();
+					auto height = br.read<uint16_t>();
+					auto offset = br.read<uint32_t>();
+					auto size = br.read<uint32_t>();
+					addStream(pic, file.view(), offset, size, pictureStride(width) * height, pictureStride(width));
+				}
+			} else if (isBup) {
+				br.skip(16);
+				auto width = br.read<uint16_t>();
+				auto height = br.read<uint16_t>();
+				auto offset = br.read<uint32_t>();
+				auto size = br.read<uint32_t>();
+				auto chunks = br.read<uint32_t>();
+				addStream(bup, file.view(), offset, size, pictureStride(width) * height, pictureStride(width));
+				// Each pose's expression; the second picture of a chunk is never decoded.
+				for (uint32_t c = 0; c < chunks; ++c) {
+					auto start = br.tellg();
+					br.skip(24);
+					auto expressionWidth = br.read<uint16_t>();
+					auto expressionHeight = br.read<uint16_t>();
+					auto expressionOffset = br.read<uint32_t>();
+					auto expressionSize = br.read<uint32_t>();
+					addStream(bup, file.view(), expressionOffset, expressionSize, pictureStride(expressionWidth) * expressionHeight, pictureStride(expressionWidth));
+					br.seekg(start + 68);
+				}
+			} else {
+				br.skip(8);
+				auto offset = br.read<uint32_t>();
+				auto encodedSize = br.read<uint32_t>();
+				auto decodedSize = br.read<uint32_t>();
+				addStream(txa, file.view(), offset, encodedSize, decodedSize, 0);
+			}
+		} catch (const std::exception &) {
+			// Truncated headers.
+		}
+	}
+}
+
+// Streams of about a full HD CG's rows each: literal runs mixed with both back reference forms, short and long, with
+// and without overlap, so every path through the decoders is taken.
+std::vector<Stream> generatedPictureStreams(size_t count, uint32_t seed) {
+	std::mt19937 random(seed);
+	std::vector<Stream> streams;
+	for (size_t s = 0; s < count; ++s) {
+		Stream stream;
+		stream.blockSize = 1920 * 4;
+		stream.decodedSize = stream.blockSize * 32;
+		auto &encoded = stream.encoded;
+		size_t written = 0;
+		while (written < stream.decodedSize) {
+			auto ctrlPos = encoded.size();
+			encoded.push_back(0);
+			for (int bit = 0; bit < 8 && written < stream.decodedSize; ++bit) {
+				auto remaining = stream.decodedSize - written;
+				auto kind = random() % 8;
+				if (kind < 4 || remaining < 3 || written < PictureReach) {
+					encoded.push_back(static_cast<unsigned char>(random()));
+					++written;
+					continue;
+				}
+				unsigned v;
+				size_t tokenCount;
+				if (kind < 6) {
+					// Short form: a pixel or a few back, up to 1026 bytes, mostly overlapping.
+					tokenCount = std::min<size_t>(3 + random() % 1024, remaining);
+					v = 0x8000 | ((tokenCount - 3) << 5) | (random() % 32);
+				} else {
+					// Long form: 32 to 2079 pixels back, up to 18 bytes, rarely overlapping.
+					tokenCount = std::min<size_t>(3 + random() % 16, remaining);
+					v = ((tokenCount - 3) << 11) | (random() % 0x800);
+				}
+				encoded[ctrlPos] |= 1 << bit;
+				encoded.push_back(static_cast<unsigned char>(v >> 8));
+				encoded.push_back(static_cast<unsigned char>(v));
+				written += tokenCount;
+			}
+		}
+		streams.push_back(std::move(stream));
+	}
+	return streams;
+}
+
+// Every font glyph and mask in the ROM. Fonts use the 10/6 split in FNT3 and 12/4 in FNT4, masks always 12/4.
+void romLzssStreams(const std::string &romPath, std::vector<Stream> &split10_6, std::vector<Stream> &split12_4, std::vector<Stream> &masks) {
+	Archive archive;
+	archive.open(romPath);
+	for (uint32_t i = 0; i < archive.index().count(); ++i) {
+		ArchiveHandle handle { i };
+		auto path = archive.index().path(handle);
+		bool isFont = hasExtension(path, ".fnt"), isMask = hasExtension(path, ".msk");
+		if (!isFont && !isMask) {
+			continue;
+		}
+		try {
+			auto file = archive.fetch(handle);
+			BinaryReader br(file.view());
+			if (isMask) {
+				br.skip(8);
+				auto width = br.read<uint16_t>();
+				auto height = br.read<uint16_t>();
+				br.skip(4);
+				addStream(masks, file.view(), br.tellg(), br.remaining(), size_t(width) * height, 0);
+				continue;
+			}
+			auto magic = br.readStringView(4);
+			if (magic != "FNT3" && magic != "FNT4") {
+				continue;
+			}
+			auto &streams = magic == "FNT3" ? split10_6 : split12_4;
+			br.skip(12);
+			// As in Font::load and Font::initGlyph.
+			const int glyphCount = 8180;
+			std::vector<uint32_t> offsets(glyphCount);
+			br.read(reinterpret_cast<char *>(offsets.data()), offsets.size() * sizeof(uint32_t));
+			for (auto offset : offsets) {
+				br.seekg(offset);
+				br.skip(2);
+				auto width = br.read<uint8_t>();
+				auto height = br.read<uint8_t>();
+				br.skip(2);
+				auto compressedSize = br.read<uint16_t>();
+				auto modWidth = (width % 2 == 0) ? width : (width + 1);
+				if (compressedSize > 0) {
+					addStream(streams, file.view(), br.tellg(), compressedSize, size_t(modWidth) * height / 2, 0);
+				}
+			}
+		} catch (const std::exception &) {
+			// Truncated headers.
+		}
+	}
+}
+
+// Streams that mostly repeat recent output, like glyphs and masks do, with every offset and count the layout allows.
+std::vector<Stream> generatedLzssStreams(LzssDecompressor::Layout layout, size_t count, uint32_t seed) {
+	std::mt19937 random(seed);
+	std::vector<Stream> streams;
+	for (size_t s = 0; s < count; ++s) {
+		Stream stream;
+		stream.decodedSize = 256 * 1024;
+		stream.blockSize = 0;
+		auto &encoded = stream.encoded;
+		size_t written = 0;
+		while (written < stream.decodedSize) {
+			auto ctrlPos = encoded.size();
+			encoded.push_back(0);
+			for (int bit = 0; bit < 8 && written < stream.decodedSize; ++bit) {
+				// Little-endian back reference, decoded the way LzssDecompressor::copy does; out of range ones are
+				// written as a literal instead.
+				unsigned backRef = random() & 0xffff;
+				size_t distance, tokenCount;
+				if (layout == LzssDecompressor::Layout::Split10_6) {
+					distance = (((backRef >> 8) & 0xff) | (((backRef >> 6) & 0x3) << 8)) + 1;
+					tokenCount = (backRef & 0x3f) + 3;
+				} else {
+					distance = ((backRef >> 8) & 0xff) | ((((backRef >> 4) & 0xf) << 8) + 1);
+					tokenCount = (backRef & 0xf) + 3;
+				}
+				if (random() % 4 == 0 || distance > written || tokenCount > stream.decodedSize - written) {
+					encoded.push_back(static_cast<unsigned char>(random() % 16));
+					++written;
+					continue;
+				}
+				encoded[ctrlPos] |= 1 << bit;
+				encoded.push_back(static_cast<unsigned char>(backRef));
+				encoded.push_back(static_cast<unsigned char>(backRef >> 8));
+				written += tokenCount;
+			}
+		}
+		streams.push_back(std::move(stream));
+	}
+	return streams;
+}
+
+// Mirrors LegacyCodecs::decodePicture's walk to find how much it writes, so its buffer can be sized to fit.
+size_t legacyPictureLength(const std::vector<unsigned char> &encoded) {
+	size_t length = 0, p = 0;
+	int marker = 1;
+	while (p < encoded.size()) {
+		if (marker == 1) marker = 0x100 | encoded[p++];
+		if (marker & 1) {
+			unsigned v = ((p < encoded.size() ? encoded[p] : 0) << 8) | (p + 1 < encoded.size() ? encoded[p + 1] : 0);
+			length += (v & 0x8000) ? ((v >> 5) & 0x3ff) + 3 : (v >> 11) + 3;
+			p += 2;
+		} else {
+			++length;
+			++p;
+		}
+		marker >>= 1;
+	}
+	return length;
+}
+
+LzssBenchResult comparePictures(const std::string &corpus, const std::vector<Stream> &streams, size_t repetitions) {
+	LzssBenchResult result;
+	result.corpus = corpus;
+	result.streams = streams.size();
+
+	// Buffers are set up front so only decoding is timed.
+	std::vector<std::vector<unsigned char>> encoded(streams.size()), legacy(streams.size()), block(streams.size()), resumable(streams.size());
+	std::vector<size_t> legacyLengths(streams.size());
+	for (size_t i = 0; i < streams.size(); ++i) {
+		const auto &stream = streams[i];
+		result.encodedBytes += stream.encoded.size();
+		result.decodedBytes += stream.decodedSize;
+		encoded[i] = stream.encoded;
+		encoded[i].resize(stream.encoded.size() + EncodedSlack);
+		legacyLengths[i] = legacyPictureLength(stream.encoded);
+		legacy[i].resize(PictureReach + std::max(legacyLengths[i], stream.decodedSize));
+		block[i].resize(stream.decodedSize);
+		resumable[i].resize(stream.decodedSize);
+	}
+
+	std::vector<bool> valid(streams.size(), true);
+	auto decodeLegacy = [&]() {
+		for (size_t i = 0; i < streams.size(); ++i) {
+			if (!valid[i]) {
+				continue;
+			}
+			LegacyCodecs::decodePicture(encoded[i].data(), streams[i].encoded.size(), legacy[i].data() + PictureReach);
+		}
+	};
+	std::vector<size_t> blockLengths(streams.size());
+	auto decodeBlock = [&]() {
+		for (size_t i = 0; i < streams.size(); ++i) {
+			if (!valid[i]) {
+				continue;
+			}
+			try {
+				blockLengths[i] = DataCompression::decompressPicture(streams[i].encoded.data(), streams[i].encoded.size(), block[i].data(), block[i].size());
+			} catch (const std::exception &) {
+				valid[i] = false;
+			}
+		}
+	};
+	auto decodeResumable = [&]() {
+		for (size_t i = 0; i < streams.size(); ++i) {
+			if (!valid[i]) {
+				continue;
+			}
+			try {
+				PictureDecompressor decompressor(streams[i].encoded.data(), streams[i].encoded.size());
+				for (size_t offset = 0; offset < streams[i].decodedSize; offset += streams[i].blockSize) {
+					auto size = std::min(streams[i].blockSize, streams[i].decodedSize - offset);
+					memcpy(resumable[i].data() + offset, decompressor.next(size), size);
+				}
+			} catch (const std::exception &) {
+				valid[i] = false;
+			}
+		}
+	};
+
+	// Streams the new decoders reject are left out of the rest, since the legacy decoder's output for them is
+	// meaningless; running the new decoders first finds them.
+	decodeBlock();
+	decodeResumable();
+	decodeLegacy();
+	for (size_t i = 0; i < streams.size(); ++i) {
+		if (!valid[i]) {
+			++result.rejected;
+			continue;
+		}
+		const auto *expected = legacy[i].data() + PictureReach;
+		// The resumable decoder always produces a whole block, zero-filling what the data does not cover.
+		bool same = blockLengths[i] == legacyLengths[i]
+			&& memcmp(block[i].data(), expected, blockLengths[i]) == 0
+			&& memcmp(resumable[i].data(), expected, blockLengths[i]) == 0;
+		if (!same) {
+			++result.mismatches;
+		}
+	}
+
+	result.legacyMilliseconds = medianMilliseconds(repetitions, decodeLegacy);
+	result.blockMilliseconds = medianMilliseconds(repetitions, decodeBlock);
+	result.resumableMilliseconds = medianMilliseconds(repetitions, decodeResumable);
+	return result;
+}
+
+LzssBenchResult compareLzss(const std::string &corpus, LzssDecompressor::Layout layout, const std::vector<Stream> &streams, size_t repetitions) {
+	// Small and odd, so back references are regularly cut in half by the end of a call.
+	const size_t FeedSize = 61;
+	LzssBenchResult result;
+	result.corpus = corpus;
+	result.streams = streams.size();
+
+	std::vector<std::vector<uint8_t>> legacy(streams.size()), block(streams.size()), resumable(streams.size());
+	for (size_t i = 0; i < streams.size(); ++i) {
+		result.encodedBytes += streams[i].encoded.size();
+		result.decodedBytes += streams[i].decodedSize;
+		block[i].resize(streams[i].decodedSize);
+		resumable[i].resize(streams[i].decodedSize);
+	}
+
+	std::vector<bool> valid(streams.size(), true);
+	auto decodeLegacy = [&]() {
+		for (size_t i = 0; i < streams.size(); ++i) {
+			if (!valid[i]) {
+				continue;
+			}
+			const auto &stream = streams[i];
+			legacy[i] = layout == LzssDecompressor::Layout::Split10_6
+				? LegacyCodecs::decompress10_6(stream.encoded.data(), stream.encoded.size(), stream.decodedSize)
+				: LegacyCodecs::decompress12_4(stream.encoded.data(), stream.encoded.size(), stream.decodedSize);
+		}
+	};
+	auto decodeBlock = [&]() {
+		for (size_t i = 0; i < streams.size(); ++i) {
+			if (!valid[i]) {
+				continue;
+			}
+			const auto &stream = streams[i];
+			try {
+				if (layout == LzssDecompressor::Layout::Split10_6) {
+					DataCompression::decompress10_6(stream.encoded.data(), stream.encoded.size(), block[i].data(), block[i].size());
+				} else {
+					DataCompression::decompress12_4(stream.encoded.data(), stream.encoded.size(), block[i].data(), block[i].size());
+				}
+			} catch (const std::exception &) {
+				valid[i] = false;
+			}
+		}
+	};
+	auto decodeResumable = [&]() {
+		for (size_t i = 0; i < streams.size(); ++i) {
+			if (!valid[i]) {
+				continue;
+			}
+			const auto &stream = streams[i];
+			try {
+				LzssDecompressor decompressor(layout, resumable[i].data(), resumable[i].size());
+				for (size_t offset = 0; offset < stream.encoded.size(); offset += FeedSize) {
+					decompressor.feed(stream.encoded.data() + offset, std::min(FeedSize, stream.encoded.size() - offset));
+				}
+			} catch (const std::exception &) {
+				valid[i] = false;
+			}
+		}
+	};
+
+	// As for pictures, the legacy decoder only sees the streams the new ones accept; it would run outside its buffer on
+	// the others.
+	decodeBlock();
+	decodeResumable();
+	decodeLegacy();
+	for (size_t i = 0; i < streams.size(); ++i) {
+		if (!valid[i]) {
+			++result.rejected;
+		} else if (block[i] != legacy[i] || resumable[i] != legacy[i]) {
+			++result.mismatches;
+		}
+	}
+
+	result.legacyMilliseconds = medianMilliseconds(repetitions, decodeLegacy);
+	result.blockMilliseconds = medianMilliseconds(repetitions, decodeBlock);
+	result.resumableMilliseconds = medianMilliseconds(repetitions, decodeResumable);
+	return result;
+}
+
+}
+
+std::vector<LzssBenchResult> LzssBench::pictures(size_t repetitions) const {
+	std::vector<Stream> pic, bup, txa;
+	romPictureStreams(romPath_, pic, bup, txa);
+	std::vector<LzssBenchResult> results;
+	for (const auto &corpus : { std::make_pair("ROM PIC3", &pic), std::make_pair("ROM BUP", &bup), std::make_pair("ROM TXA3", &txa) }) {
+		if (!corpus.second->empty()) {
+			results.push_back(comparePictures(corpus.first, *corpus.second, repetitions));
+		}
+	}
+	results.push_back(comparePictures("generated PIC", generatedPictureStreams(32, 1), repetitions));
+	return results;
+}
+
+std::vector<LzssBenchResult> LzssBench::lzss(size_t repetitions) const {
+	std::vector<Stream> split10_6, split12_4, masks;
+	romLzssStreams(romPath_, split10_6, split12_4, masks);
+	std::vector<LzssBenchResult> results;
+	if (!split10_6.empty()) {
+		results.push_back(compareLzss("ROM FNT3 10/6", LzssDecompressor::Layout::Split10_6, split10_6, repetitions));
+	}
+	if (!split12_4.empty()) {
+		results.push_back(compareLzss("ROM FNT4 12/4", LzssDecompressor::Layout::Split12_4, split12_4, repetitions));
+	}
+	if (!masks.empty()) {
+		results.push_back(compareLzss("ROM MSK 12/4", LzssDecompressor::Layout::Split12_4, masks, repetitions));
+	}
+	results.push_back(compareLzss("generated 10/6", LzssDecompressor::Layout::Split10_6, generatedLzssStreams(LzssDecompressor::Layout::Split10_6, 16, 2), repetitions));
+	results.push_back(compareLzss("generated 12/4", LzssDecompressor::Layout::Split12_4, generatedLzssStreams(LzssDecompressor::Layout::Split12_4, 16, 3), repetitions));
+	return results;
+}
+
+void LzssBench::print(std::ostream &output, const std::vector<LzssBenchResult> &results) {
+	auto rate = [](uint64_t bytes, double milliseconds) {
+		return milliseconds > 0 ? bytes / (1024.0 * 1024.0) / (milliseconds / 1000.0) : 0.0;
+	};
+	output << std::left << std::setw(16) << "corpus" << std::right << std::setw(9) << "streams" << std::setw(10) << "MB in" << std::setw(10) << "MB out"
+		<< std::setw(13) << "legacy MB/s" << std::setw(12) << "block MB/s" << std::setw(16) << "resumable MB/s" << std::setw(12) << "mismatches"
+		<< std::setw(10) << "rejected" << '\n';
+	output << std::fixed;
+	for (const auto &row : results) {
+		output << std::left << std::setw(16) << row.corpus << std::right << std::setw(9) << row.streams << std::setprecision(1)
+			<< std::setw(10) << row.encodedBytes / (1024.0 * 1024.0) << std::setw(10) << row.decodedBytes / (1024.0 * 1024.0)
+			<< std::setprecision(0) << std::setw(13) << rate(row.decodedBytes, row.legacyMilliseconds)
+			<< std::setw(12) << rate(row.decodedBytes, row.blockMilliseconds) << std::setw(16) << rate(row.decodedBytes, row.resumableMilliseconds)
+			<< std::setw(12) << row.mismatches << std::setw(10) << row.rejected << '\n';
+	}
+	output << std::defaultfloat;
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct LzssBenchResult {
+	// Where the streams came from and which format they are in, such as "ROM PIC3" or "generated 12/4".
+	std::string corpus;
+	size_t streams = 0;
+	uint64_t encodedBytes = 0;
+	uint64_t decodedBytes = 0;
+	// Median time to decode the whole corpus once with the legacy decoder, the block decoder and the resumable one.
+	double legacyMilliseconds = 0;
+	double blockMilliseconds = 0;
+	double resumableMilliseconds = 0;
+	// Streams where either new decoder gave different bytes than the legacy one, and streams they rejected as corrupt.
+	size_t mismatches = 0;
+	size_t rejected = 0;
+};
+
+// Checks the decompressors in DataCompression against the implementations they replaced, kept in LegacyCodecs, and
+// times all of them. Every compressed stream in the ROM is decoded, along with generated streams that use every kind
+// of back reference, since a ROM, and the synthetic one in particular, may not contain them all.
+class LzssBench {
+public:
+	explicit LzssBench(const std::string &romPath) : romPath_(romPath) {}
+
+	// The picture LZ of PIC3, BUP and TXA3, with decompressPicture as the block decoder and PictureDecompressor, fed
+	// a row at a time as the engine does, as the resumable one.
+	std::vector<LzssBenchResult> pictures(size_t repetitions) const;
+	// The byte LZSS of fonts and masks, with decompress10_6 and decompress12_4 as the block decoders and
+	// LzssDecompressor, fed a few bytes at a time so tokens are split between calls, as the resumable one.
+	std::vector<LzssBenchResult> lzss(size_t repetitions) const;
+
+	static void print(std::ostream &output, const std::vector<LzssBenchResult> &results);
+private:
+	std::string romPath_;
+};
\ No newline at end of file
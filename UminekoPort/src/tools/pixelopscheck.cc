@@ -0,0 +1,171 @@
+#include "pixelopscheck.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <random>
+
+#include "../data/archive.h"
+
+namespace {
+
+// Longest generated row, in bytes; past three 32-byte vectors plus any tail.
+const size_t MaxRowBytes = 100;
+// Generated rows start this many bytes past an aligned address, one pass for each.
+const size_t Misalignments = 4;
+const uint32_t FrameWidth = 1920, FrameHeight = 1080;
+
+bool hasExtension(std::string_view path, const char *extension) {
+	auto length = strlen(extension);
+	return path.size() >= length && path.compare(path.size() - length, length, extension) == 0;
+}
+
+template <typename Call>
+double medianMilliseconds(size_t repetitions, Call call) {
+	std::vector<double> times;
+	for (size_t i = 0; i < std::max<size_t>(repetitions, 1); ++i) {
+		auto start = std::chrono::steady_clock::now();
+		call();
+		times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	std::sort(times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+// FNV-1a, continued from hash.
+uint64_t fnv(uint64_t hash, const unsigned char *data, size_t size) {
+	for (size_t i = 0; i < size; ++i) {
+		hash = (hash ^ data[i]) * 0x100000001b3;
+	}
+	return hash;
+}
+
+template <typename T>
+uint64_t fnv(uint64_t hash, const T &value) {
+	return fnv(hash, reinterpret_cast<const unsigned char *>(&value), sizeof(value));
+}
+
+// Continues hash with the image and with the image converted to RGBA.
+uint64_t hashImage(uint64_t hash, uint32_t width, uint32_t height, const std::vector<unsigned char> &pixels) {
+	hash = fnv(fnv(hash, width), height);
+	hash = fnv(hash, pixels.data(), pixels.size());
+	std::vector<unsigned char> converted(pixels.size());
+	PixelOps::swapRedBlue(converted.data(), pixels.data(), pixels.size() / 4);
+	return fnv(hash, converted.data(), converted.size());
+}
+
+// Hash of what the entry decodes to, or 0 if decoding threw.
+uint64_t hashEntry(Archive &archive, ArchiveHandle handle, std::string_view path) {
+	try {
+		uint64_t hash = 0xcbf29ce484222325;
+		if (hasExtension(path, ".pic")) {
+			auto pic = archive.getPic(handle);
+			hash = hashImage(hash, pic->width, pic->height, pic->pixels);
+		} else {
+			auto bup = archive.getBup(handle);
+			hash = hashImage(hash, bup->width, bup->height, bup->pixels);
+			for (const auto &pose : bup->subentries) {
+				hash = hashImage(hash, pose.width, pose.height, pose.pixels);
+			}
+		}
+		return hash ? hash : 1;
+	} catch (const std::exception &) {
+		return 0;
+	}
+}
+
+// Hashes of every generated row through both passes, with and without a row above.
+std::vector<uint64_t> hashRows(const std::vector<unsigned char> &input) {
+	std::vector<uint64_t> hashes;
+	std::vector<unsigned char> output(MaxRowBytes + Misalignments);
+	for (size_t offset = 0; offset < Misalignments; ++offset) {
+		for (size_t size = 0; size <= MaxRowBytes; ++size) {
+			const auto *row = input.data() + offset;
+			const auto *previous = input.data() + MaxRowBytes + Misalignments + offset;
+			auto *destination = output.data() + offset;
+			PixelOps::dpcmRow(destination, row, previous, size);
+			hashes.push_back(fnv(0xcbf29ce484222325, destination, size));
+			PixelOps::dpcmRow(destination, row, nullptr, size);
+			hashes.push_back(fnv(0xcbf29ce484222325, destination, size));
+			PixelOps::swapRedBlue(destination, row, size / 4);
+			hashes.push_back(fnv(0xcbf29ce484222325, destination, size / 4 * 4));
+		}
+	}
+	return hashes;
+}
+
+std::vector<unsigned char> randomBytes(size_t size) {
+	std::mt19937 random(0x5eed);
+	std::vector<unsigned char> bytes(size);
+	for (auto &byte : bytes) {
+		byte = static_cast<unsigned char>(random());
+	}
+	return bytes;
+}
+
+}
+
+std::vector<PixelOpsCheckResult> PixelOpsCheck::run(size_t repetitions) const {
+	auto selected = PixelOps::target();
+	auto rowInput = randomBytes((MaxRowBytes + Misalignments) * 2);
+	auto frame = randomBytes(size_t(FrameWidth) * FrameHeight * 4);
+	std::vector<unsigned char> output(frame.size());
+
+	std::vector<PixelOpsCheckResult> results;
+	std::vector<uint64_t> referenceImages, referenceRows;
+	for (auto target : PixelOps::availableTargets()) {
+		PixelOps::setTarget(target);
+		PixelOpsCheckResult result;
+		result.target = target;
+
+		// A fresh archive per target, so no image decoded by an earlier target is served from the memory cache.
+		Archive archive;
+		archive.open(romPath_);
+		std::vector<uint64_t> images;
+		for (uint32_t i = 0; i < archive.index().count(); ++i) {
+			ArchiveHandle handle { i };
+			auto path = archive.index().path(handle);
+			if (hasExtension(path, ".pic") || hasExtension(path, ".bup")) {
+				images.push_back(hashEntry(archive, handle, path));
+			}
+		}
+		auto rows = hashRows(rowInput);
+		if (results.empty()) {
+			referenceImages = images;
+			referenceRows = rows;
+		}
+		result.images = images.size();
+		result.rows = rows.size();
+		for (size_t i = 0; i < images.size(); ++i) {
+			result.mismatches += images[i] != referenceImages[i];
+		}
+		for (size_t i = 0; i < rows.size(); ++i) {
+			result.mismatches += rows[i] != referenceRows[i];
+		}
+
+		size_t rowSize = FrameWidth * 4;
+		result.dpcmMilliseconds = medianMilliseconds(repetitions, [&] {
+			for (uint32_t y = 0; y < FrameHeight; ++y) {
+				PixelOps::dpcmRow(output.data() + y * rowSize, frame.data() + y * rowSize, y ? output.data() + (y - 1) * rowSize : nullptr, rowSize);
+			}
+		});
+		result.swapMilliseconds = medianMilliseconds(repetitions, [&] {
+			PixelOps::swapRedBlue(output.data(), frame.data(), size_t(FrameWidth) * FrameHeight);
+		});
+		results.push_back(result);
+	}
+	PixelOps::setTarget(selected);
+	return results;
+}
+
+void PixelOpsCheck::print(std::ostream &output, const std::vector<PixelOpsCheckResult> &results) {
+	output << std::left << std::setw(8) << "target" << std::right << std::setw(8) << "images" << std::setw(7) << "rows"
+		<< std::setw(12) << "mismatches" << std::setw(10) << "dpcm ms" << std::setw(10) << "swap ms" << '\n';
+	output << std::fixed << std::setprecision(2);
+	for (const auto &row : results) {
+		output << std::left << std::setw(8) << PixelOps::name(row.target) << std::right << std::setw(8) << row.images << std::setw(7) << row.rows
+			<< std::setw(12) << row.mismatches << std::setw(10) << row.dpcmMilliseconds << std::setw(10) << row.swapMilliseconds << '\n';
+	}
+	output << std::defaultfloat;
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../data/pixelops.h"
+
+struct PixelOpsCheckResult {
+	PixelOps::Target target;
+	// PIC and BUP files decoded and generated rows run, and how many of them came out differently than with the
+	// scalar code.
+	size_t images = 0;
+	size_t rows = 0;
+	size_t mismatches = 0;
+	// Median time to rebuild a 1920x1080 image from its row deltas and to swap its red and blue channels.
+	double dpcmMilliseconds = 0;
+	double swapMilliseconds = 0;
+};
+
+// Runs every PixelOps target the machine supports over the ROM's pictures and sprites and checks each gives the same
+// pixels as the scalar code. Rows of every length up to a few vectors, at unaligned addresses, are run as well, since
+// the ROM's images may not reach every tail case. The images are also converted as for a PNG export.
+class PixelOpsCheck {
+public:
+	explicit PixelOpsCheck(const std::string &romPath) : romPath_(romPath) {}
+
+	// One result per target, scalar first. The selected target is restored afterwards.
+	std::vector<PixelOpsCheckResult> run(size_t repetitions) const;
+
+	static void print(std::ostream &output, const std::vector<PixelOpsCheckResult> &results);
+private:
+	std::string romPath_;
+};
\ No newline at end of file
@@ -0,0 +1,300 @@
+#include "readerbench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <string_view>
+#include <type_traits>
+
+#include "legacybinaryreader.h"
+#include "../data/archive.h"
+#include "../util/binaryreader.h"
+
+namespace {
+
+bool hasExtension(std::string_view path, const char *extension) {
+	auto length = strlen(extension);
+	return path.size() >= length && path.compare(path.size() - length, length, extension) == 0;
+}
+
+bool isImage(std::string_view path) {
+	return hasExtension(path, ".pic") || hasExtension(path, ".bup") || hasExtension(path, ".txa") || hasExtension(path, ".msk");
+}
+
+template <typename Call>
+double medianMilliseconds(size_t repetitions, Call call) {
+	std::vector<double> times;
+	for (size_t i = 0; i < std::max<size_t>(repetitions, 1); ++i) {
+		auto start = std::chrono::steady_clock::now();
+		call();
+		times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	std::sort(times.begin(), times.end());
+	return times[times.size() / 2];
+}
+
+struct Sample {
+	std::string path;
+	std::vector<char> data;
+};
+
+// Caps the fields workload so a full ROM's audio and movies do not dominate it.
+const uint64_t MaxFieldBytes = 64 * 1024 * 1024;
+// Fewest values a timed run reads; passes are repeated until they get there.
+const uint64_t MinTimedReads = 10 * 1000 * 1000;
+
+std::vector<Sample> loadSamples(const std::string &romPath, bool images) {
+	Archive archive;
+	archive.open(romPath);
+	std::vector<Sample> samples;
+	uint64_t total = 0;
+	for (uint32_t i = 0; i < archive.index().count(); ++i) {
+		ArchiveHandle handle { i };
+		auto path = archive.index().path(handle);
+		if (isImage(path) != images || (!images && total >= MaxFieldBytes)) {
+			continue;
+		}
+		auto file = archive.fetch(handle);
+		samples.push_back({ std::string(path), std::vector<char>(file.data(), file.data() + file.size()) });
+		total += file.size();
+	}
+	return samples;
+}
+
+// Each reader the way its callers use it: the current one hands out views, the legacy one could only copy.
+std::string_view readText(BinaryReader &br) {
+	return br.readStringView();
+}
+
+std::string readText(LegacyBinaryReader &br) {
+	return br.readString();
+}
+
+std::string_view readText(BinaryReader &br, size_t length) {
+	return br.readStringView(length);
+}
+
+std::string readText(LegacyBinaryReader &br, size_t length) {
+	return br.readString(length);
+}
+
+size_t position(BinaryReader &br) {
+	return br.tellg();
+}
+
+size_t position(LegacyBinaryReader &br) {
+	return static_cast<size_t>(static_cast<std::streamoff>(br.tellg()));
+}
+
+class Digest {
+public:
+	void add(uint64_t value) {
+		hash_ = (hash_ ^ value) * 0x100000001b3ull;
+		++reads_;
+	}
+
+	void add(std::string_view text) {
+		for (auto c : text) {
+			hash_ = (hash_ ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+		}
+		++reads_;
+	}
+
+	uint64_t hash() const {
+		return hash_;
+	}
+
+	uint64_t reads() const {
+		return reads_;
+	}
+private:
+	uint64_t hash_ = 0xcbf29ce484222325ull;
+	uint64_t reads_ = 0;
+};
+
+// Field by field rather than whole structs, as most parsers in the engine read. Only the layouts matter here, so the
+// offsets follow the structs in archive.cc without naming every field.
+template <typename Reader>
+void parseHeader(const Sample &sample, Digest &digest) {
+	Reader br(sample.data.data(), sample.data.size());
+	auto magic = br.template read<uint32_t>();
+	digest.add(magic);
+	if (hasExtension(sample.path, ".msk")) {
+		digest.add(br.template read<uint32_t>());
+		digest.add(br.template read<uint16_t>());
+		digest.add(br.template read<uint16_t>());
+	} else if (hasExtension(sample.path, ".pic")) {
+		br.skip(-4);
+		br.skip(16);
+		br.template read<uint32_t>();
+		auto chunks = br.template read<uint32_t>();
+		digest.add(chunks);
+		if (((magic >> 24) & 0xff) == '4') {
+			std::vector<std::pair<uint32_t, uint32_t>> entries;
+			for (uint32_t i = 0; i < chunks; ++i) {
+				br.template read<uint16_t>();
+				br.template read<uint16_t>();
+				entries.push_back({ i, br.template read<uint32_t>() });
+			}
+			for (const auto &entry : entries) {
+				br.seekg(entry.second);
+				br.skip(12);
+				digest.add(br.template read<uint16_t>());
+				digest.add(br.template read<uint16_t>());
+				digest.add(br.template read<uint32_t>());
+			}
+		} else {
+			for (uint32_t i = 0; i < chunks; ++i) {
+				digest.add(br.template read<uint32_t>());
+				for (int field = 0; field < 4; ++field) {
+					digest.add(br.template read<uint16_t>());
+				}
+				digest.add(br.template read<uint32_t>());
+				digest.add(br.template read<uint32_t>());
+			}
+		}
+	} else if (hasExtension(sample.path, ".bup")) {
+		br.skip(8);
+		for (int field = 0; field < 4; ++field) {
+			digest.add(br.template read<uint16_t>());
+		}
+		digest.add(br.template read<uint32_t>());
+		digest.add(br.template read<uint32_t>());
+		auto chunks = br.template read<uint32_t>();
+		for (uint32_t i = 0; i < chunks; ++i) {
+			digest.add(readText(br, 16));
+			br.skip(4);
+			for (int picture = 0; picture < 2; ++picture) {
+				for (int field = 0; field < 4; ++field) {
+					digest.add(br.template read<uint16_t>());
+				}
+				digest.add(br.template read<uint32_t>());
+				digest.add(br.template read<uint32_t>());
+			}
+			br.skip(16);
+		}
+	} else if (hasExtension(sample.path, ".txa")) {
+		bool txa4 = ((magic >> 24) & 0xff) == '4';
+		br.skip(txa4 ? 8 : 16);
+		auto chunks = br.template read<uint32_t>();
+		digest.add(chunks);
+		br.skip(txa4 ? 16 : 8);
+		for (uint32_t i = 0; i < chunks; ++i) {
+			auto start = position(br);
+			auto length = br.template read<uint16_t>();
+			for (int field = 0; field < (txa4 ? 3 : 5); ++field) {
+				digest.add(br.template read<uint16_t>());
+			}
+			digest.add(br.template read<uint32_t>());
+			if (txa4) {
+				digest.add(br.template read<uint32_t>());
+			}
+			digest.add(readText(br));
+			br.seekg(start + length);
+		}
+	}
+}
+
+// An opcode byte picks the next operand: a short, a word, a big-endian short or a short string.
+template <typename Reader>
+void walkFields(const Sample &sample, Digest &digest) {
+	Reader br(sample.data.data(), sample.data.size());
+	// Far enough from the end that no operand runs past it, as the legacy reader would not notice.
+	while (sample.data.size() - position(br) >= 16) {
+		auto op = br.template read<uint8_t>();
+		digest.add(op);
+		switch (op & 3) {
+		case 0:
+			digest.add(br.template read<uint16_t>());
+			break;
+		case 1:
+			digest.add(br.template read<uint32_t>());
+			break;
+		case 2:
+			digest.add(br.template readBE<uint16_t>());
+			break;
+		default:
+			digest.add(readText(br, br.template read<uint8_t>() & 7));
+			break;
+		}
+	}
+}
+
+template <typename Parse>
+ReaderBenchResult compare(const std::string &workload, const std::vector<Sample> &samples, size_t repetitions, Parse parse) {
+	ReaderBenchResult result;
+	result.workload = workload;
+	result.files = samples.size();
+	for (const auto &sample : samples) {
+		result.bytes += sample.data.size();
+	}
+
+	Digest legacy, current;
+	size_t passes = 1;
+	auto runLegacy = [&]() {
+		for (size_t pass = 0; pass < passes; ++pass) {
+			Digest digest;
+			for (const auto &sample : samples) {
+				parse(sample, digest, static_cast<LegacyBinaryReader *>(nullptr));
+			}
+			legacy = digest;
+		}
+	};
+	auto runCurrent = [&]() {
+		for (size_t pass = 0; pass < passes; ++pass) {
+			Digest digest;
+			for (const auto &sample : samples) {
+				parse(sample, digest, static_cast<BinaryReader *>(nullptr));
+			}
+			current = digest;
+		}
+	};
+	// Headers alone are read in microseconds, so each timing repeats the pass until it covers enough reads to measure.
+	runCurrent();
+	passes = static_cast<size_t>(std::max<uint64_t>(1, MinTimedReads / std::max<uint64_t>(current.reads(), 1)));
+	result.legacyMilliseconds = medianMilliseconds(repetitions, runLegacy) / passes;
+	result.currentMilliseconds = medianMilliseconds(repetitions, runCurrent) / passes;
+	result.reads = current.reads();
+	result.identical = legacy.hash() == current.hash() && legacy.reads() == current.reads();
+	return result;
+}
+
+}
+
+ReaderBenchResult ReaderBench::headers(size_t repetitions) const {
+	// Entries the bounds-checked reader rejects are dropped first; the legacy reader would read past their end.
+	auto samples = loadSamples(romPath_, true);
+	samples.erase(std::remove_if(samples.begin(), samples.end(), [](const Sample &sample) {
+		try {
+			Digest digest;
+			parseHeader<BinaryReader>(sample, digest);
+			return false;
+		} catch (const std::exception &) {
+			return true;
+		}
+	}), samples.end());
+	return compare("headers", samples, repetitions, [](const Sample &sample, Digest &digest, auto *reader) {
+		parseHeader<std::remove_pointer_t<decltype(reader)>>(sample, digest);
+	});
+}
+
+ReaderBenchResult ReaderBench::fields(size_t repetitions) const {
+	return compare("fields", loadSamples(romPath_, false), repetitions, [](const Sample &sample, Digest &digest, auto *reader) {
+		walkFields<std::remove_pointer_t<decltype(reader)>>(sample, digest);
+	});
+}
+
+void ReaderBench::print(std::ostream &output, const std::vector<ReaderBenchResult> &results) {
+	output << std::left << std::setw(10) << "workload" << std::right << std::setw(7) << "files" << std::setw(9) << "MB" << std::setw(11) << "reads"
+		<< std::setw(13) << "legacy us" << std::setw(13) << "current us" << std::setw(10) << "speedup" << std::setw(11) << "identical" << '\n';
+	output << std::fixed;
+	for (const auto &row : results) {
+		output << std::left << std::setw(10) << row.workload << std::right << std::setw(7) << row.files << std::setprecision(1)
+			<< std::setw(9) << row.bytes / (1024.0 * 1024.0) << std::setw(11) << row.reads
+			<< std::setw(13) << row.legacyMilliseconds * 1000 << std::setw(13) << row.currentMilliseconds * 1000 << std::setprecision(2)
+			<< std::setw(9) << (row.currentMilliseconds > 0 ? row.legacyMilliseconds / row.currentMilliseconds : 0.0) << 'x'
+			<< std::setw(11) << (row.identical ? "yes" : "NO") << '\n';
+	}
+	output << std::defaultfloat;
+}
\ No newline at end of file
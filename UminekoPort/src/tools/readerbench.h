@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct ReaderBenchResult {
+	std::string workload;
+	size_t files = 0;
+	uint64_t bytes = 0;
+	// Values read in one pass, each read<T>, readBE<T> or readString counting once.
+	uint64_t reads = 0;
+	// Median time of one pass over every file.
+	double legacyMilliseconds = 0;
+	double currentMilliseconds = 0;
+	// Whether both readers saw the same values, compared through a hash of everything read.
+	bool identical = false;
+};
+
+// Times BinaryReader against the istream-based reader it replaced, kept as LegacyBinaryReader, on the ROM's own data.
+// Files are read into memory first, so only parsing is timed.
+class ReaderBench {
+public:
+	explicit ReaderBench(const std::string &romPath) : romPath_(romPath) {}
+
+	// Parses the header and chunk table of every PIC, BUP, TXA and MSK the way Archive does, one reader per file.
+	ReaderBenchResult headers(size_t repetitions) const;
+	// Walks every other entry, scripts included, as a stream of mixed-width fields and short strings, the way the
+	// script loader and decompiler read operands.
+	ReaderBenchResult fields(size_t repetitions) const;
+
+	static void print(std::ostream &output, const std::vector<ReaderBenchResult> &results);
+private:
+	std::string romPath_;
+};
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include "repacker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "../math/clock.h"
+
+namespace {
+
+struct DirectoryChunk {
+	uint32_t nameOffset;
+	uint32_t offset;
+	uint32_t size;
+};
+
+const uint32_t FolderBit = 0x80000000;
+const uint64_t FileAlignment = 1 << 11;
+const uint64_t FolderAlignment = 1 << 4;
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+}
+
+Repacker::Repacker(const std::string &romPath) {
+	rom_.open(romPath);
+	rom_.readAt(0, header_, sizeof(header_));
+	if (memcmp(header_, "ROM ", 4) != 0) {
+		throw std::runtime_error("Archive signature does not match the expected 'ROM '.");
+	}
+	walk(0x10, "");
+	index_.build();
+}
+
+void Repacker::walk(uint64_t offset, const std::string &folder) {
+	for (const auto &directory : directories_) {
+		if (directory.offset == offset) {
+			throw std::runtime_error("Directory tables form a cycle.");
+		}
+	}
+
+	uint32_t count;
+	DirectoryChunk self;
+	rom_.readAt(offset, &count, sizeof(count));
+	rom_.readAt(offset + sizeof(count), &self, sizeof(self));
+	// The "." entry comes first and its size is that of the whole table, names included.
+	if (count == 0 || self.size < sizeof(count) + count * sizeof(DirectoryChunk)) {
+		throw std::runtime_error("Corrupt directory table.");
+	}
+
+	directories_.push_back({ offset, std::vector<unsigned char>(self.size) });
+	auto directoryIndex = directories_.size() - 1;
+	rom_.readAt(offset, directories_[directoryIndex].table.data(), self.size);
+
+	// Copy what the loop needs; recursing grows directories_ and would move the table.
+	auto table = directories_[directoryIndex].table;
+	auto *chunks = reinterpret_cast<const DirectoryChunk *>(table.data() + sizeof(count));
+	for (uint32_t i = 0; i < count; ++i) {
+		DirectoryChunk chunk;
+		memcpy(&chunk, chunks + i, sizeof(chunk));
+		auto nameOffset = chunk.nameOffset & ~FolderBit;
+		if (nameOffset >= table.size() || !memchr(table.data() + nameOffset, 0, table.size() - nameOffset)) {
+			throw std::runtime_error("Corrupt directory table.");
+		}
+		std::string name(reinterpret_cast<const char *>(table.data() + nameOffset));
+		if (name == "." || name == "..") {
+			continue;
+		}
+
+		if (chunk.nameOffset & FolderBit) {
+			walk(uint64_t(chunk.offset) << 4, folder + name + "/");
+		} else {
+			index_.add(folder + name, uint64_t(chunk.offset) << 11, chunk.size);
+		}
+	}
+}
+
+size_t Repacker::repack(const std::vector<std::string> &accessOrder, const std::string &outputPath) {
+	Clock clock;
+
+	// Files in first-use order, then the untraced ones where they were.
+	std::vector<std::pair<uint64_t, uint32_t>> order;
+	std::unordered_set<uint64_t> placed;
+	for (const auto &path : accessOrder) {
+		auto handle = index_.find(path);
+		if (handle.valid() && placed.insert(index_.offset(handle)).second) {
+			order.push_back({ index_.offset(handle), index_.size(handle) });
+		}
+	}
+	auto traced = order.size();
+	std::vector<std::pair<uint64_t, uint32_t>> rest;
+	for (uint32_t i = 0; i < index_.count(); ++i) {
+		ArchiveHandle handle { i };
+		if (placed.insert(index_.offset(handle)).second) {
+			rest.push_back({ index_.offset(handle), index_.size(handle) });
+		}
+	}
+	std::sort(rest.begin(), rest.end());
+	order.insert(order.end(), rest.begin(), rest.end());
+
+	// The root table has to stay at 0x10, where Archive starts scanning.
+	uint64_t position = sizeof(header_);
+	for (auto &directory : directories_) {
+		position = alignUp(position, FolderAlignment);
+		directory.newOffset = position;
+		position += directory.table.size();
+	}
+	fileOffsets_.clear();
+	for (const auto &file : order) {
+		position = alignUp(position, FileAlignment);
+		fileOffsets_[file.first] = position;
+		position += file.second;
+	}
+
+	std::unordered_map<uint64_t, uint64_t> directoryOffsets;
+	for (const auto &directory : directories_) {
+		directoryOffsets[directory.offset] = directory.newOffset;
+	}
+
+	std::ofstream ofs(outputPath, std::ios_base::binary | std::ios_base::trunc);
+	if (!ofs) {
+		throw std::runtime_error("Unable to open '" + outputPath + "' for writing.");
+	}
+	uint64_t written = 0;
+	auto padTo = [&](uint64_t offset) {
+		static const char zeros[FileAlignment] = {};
+		while (written < offset) {
+			auto count = std::min<uint64_t>(offset - written, sizeof(zeros));
+			ofs.write(zeros, count);
+			written += count;
+		}
+	};
+
+	ofs.write(reinterpret_cast<const char *>(header_), sizeof(header_));
+	written = sizeof(header_);
+	for (const auto &directory : directories_) {
+		auto table = directory.table;
+		uint32_t count;
+		memcpy(&count, table.data(), sizeof(count));
+		for (uint32_t i = 0; i < count; ++i) {
+			DirectoryChunk chunk;
+			auto *chunkPtr = table.data() + sizeof(count) + i * sizeof(DirectoryChunk);
+			memcpy(&chunk, chunkPtr, sizeof(chunk));
+			if (chunk.nameOffset & FolderBit) {
+				// ".." of the root points outside the tree and is left alone.
+				auto iter = directoryOffsets.find(uint64_t(chunk.offset) << 4);
+				if (iter != directoryOffsets.end()) {
+					chunk.offset = static_cast<uint32_t>(iter->second >> 4);
+				}
+			} else {
+				chunk.offset = static_cast<uint32_t>(fileOffsets_.at(uint64_t(chunk.offset) << 11) >> 11);
+			}
+			memcpy(chunkPtr, &chunk, sizeof(chunk));
+		}
+		padTo(directory.newOffset);
+		ofs.write(reinterpret_cast<const char *>(table.data()), table.size());
+		written += table.size();
+	}
+
+	std::vector<char> buffer(1 << 20);
+	for (const auto &file : order) {
+		padTo(fileOffsets_[file.first]);
+		for (uint64_t done = 0; done < file.second;) {
+			auto count = static_cast<size_t>(std::min<uint64_t>(file.second - done, buffer.size()));
+			rom_.readAt(file.first + done, buffer.data(), count);
+			ofs.write(buffer.data(), count);
+			done += count;
+		}
+		written += file.second;
+	}
+	ofs.close();
+	if (!ofs) {
+		throw std::runtime_error("Unable to write '" + outputPath + "'.");
+	}
+
+	std::cout << "Repacked " << order.size() << " files (" << traced << " in trace order) into '" << outputPath << "', "
+		<< written << " bytes in " << clock.reset() << " s.\n";
+	return traced;
+}
+
+RepackSeekStats Repacker::seekStats(const std::vector<std::string> &accessOrder, bool repacked) const {
+	RepackSeekStats stats;
+	uint64_t end = 0;
+	for (const auto &path : accessOrder) {
+		auto handle = index_.find(path);
+		if (!handle.valid()) {
+			continue;
+		}
+		auto offset = index_.offset(handle);
+		if (repacked) {
+			offset = fileOffsets_.at(offset);
+		}
+		++stats.reads;
+		if (stats.reads > 1 && (offset < end || offset > alignUp(end, FileAlignment))) {
+			++stats.seeks;
+			stats.seekDistance += offset > end ? offset - end : end - offset;
+		}
+		end = offset + index_.size(handle);
+	}
+	return stats;
+}
\ No newline at end of file
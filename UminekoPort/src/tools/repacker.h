@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../data/archiveindex.h"
+#include "../util/file.h"
+
+// How much a sequence of reads jumps around a ROM. A read is a seek when it does not start in the alignment gap right
+// after the previous one.
+struct RepackSeekStats {
+	size_t reads = 0;
+	size_t seeks = 0;
+	uint64_t seekDistance = 0;
+};
+
+// Rewrites a ROM so the files a play session touches lie back to back in the order they were first read. The result
+// has the same format and directory tree, so Archive opens it like the original. Directory tables go first, then the
+// traced files, then everything else in its original order.
+class Repacker {
+public:
+	explicit Repacker(const std::string &romPath);
+
+	// accessOrder lists archive paths in the order they were read; repeats and unknown paths are fine. Returns the
+	// number of files that were placed by the trace.
+	size_t repack(const std::vector<std::string> &accessOrder, const std::string &outputPath);
+
+	// Replays accessOrder against the layout before and after the last repack.
+	RepackSeekStats seekStats(const std::vector<std::string> &accessOrder, bool repacked) const;
+private:
+	struct Directory {
+		uint64_t offset;
+		std::vector<unsigned char> table;
+		uint64_t newOffset = 0;
+	};
+
+	void walk(uint64_t offset, const std::string &folder);
+
+	File rom_;
+	unsigned char header_[0x10];
+	std::vector<Directory> directories_;
+	ArchiveIndex index_;
+	// Old file offset to new one. Entries sharing data keep sharing it.
+	std::unordered_map<uint64_t, uint64_t> fileOffsets_;
+};
\ No newline at end of file
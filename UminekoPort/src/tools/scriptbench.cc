@@ -0,0 +1,209 @@
+#include "scriptbench.h"
+
+#include <chrono>
+#include <iomanip>
+#include <stdexcept>
+
+namespace {
+
+const uint8_t SetVariableOpcode = 0x41;
+const uint8_t JumpIfOpcode = 0x46;
+const uint8_t JumpOpcode = 0x47;
+// Iterations of each sequence's loop per repetition.
+const uint16_t LoopCount = 1000;
+
+enum Operation : uint8_t {
+	Set = 0,
+	Add = 2,
+	Subtract = 3,
+	Multiply = 4,
+	Divide = 5
+};
+
+enum Comparison : uint8_t {
+	Equal = 0,
+	GreaterOrEqual = 2,
+	Greater = 3,
+	Less = 5
+};
+
+// Lays instructions out at made-up offsets, a fixed stride apart, so targets can be computed before they are emitted.
+class ProgramBuilder {
+public:
+	static const uint32_t Stride = 8;
+
+	explicit ProgramBuilder(ScriptProgram &program) : program_(program) {
+		program_.clear();
+	}
+
+	// Offset of the instruction count instructions after the next one.
+	uint32_t ahead(uint32_t count) const {
+		return offset_ + count * Stride;
+	}
+
+	void set(uint8_t operation, uint16_t variable, uint16_t value) {
+		begin(SetVariableOpcode, ScriptOp::SetVariable);
+		program_.operand(operation);
+		program_.operand(variable);
+		program_.operand(value);
+	}
+
+	void binary(uint8_t operation, uint16_t variable, uint16_t left, uint16_t right) {
+		begin(SetVariableOpcode, ScriptOp::SetVariableBinary);
+		program_.operand(operation);
+		program_.operand(variable);
+		program_.operand(left);
+		program_.operand(right);
+	}
+
+	void jumpIf(uint8_t comparison, uint16_t value, uint16_t compareTo, uint32_t target) {
+		begin(JumpIfOpcode, ScriptOp::JumpIf);
+		program_.operand(comparison);
+		program_.operand(value);
+		program_.operand(compareTo);
+		program_.target(target);
+	}
+
+	void jump(uint32_t target) {
+		begin(JumpOpcode, ScriptOp::Jump);
+		program_.target(target);
+	}
+
+	void end() {
+		program_.unreachable(offset_);
+		program_.finish();
+	}
+private:
+	void begin(uint8_t opcode, ScriptOp op) {
+		program_.begin(opcode, offset_);
+		program_.setOp(op);
+		offset_ += Stride;
+	}
+
+	ScriptProgram &program_;
+	uint32_t offset_ = 0;
+};
+
+uint16_t variable(uint16_t index) {
+	return 0x8000 | index;
+}
+
+}
+
+std::vector<ScriptBenchResult> ScriptBench::run(uint32_t repetitions) const {
+	struct Sequence {
+		const char *name;
+		void (*build)(ScriptProgram &);
+	};
+	const Sequence sequences[] = {
+		{ "arithmetic", [](ScriptProgram &program) { arithmetic(program, false); } },
+		{ "scattered", [](ScriptProgram &program) { arithmetic(program, true); } },
+		{ "branches", branches },
+	};
+
+	std::vector<ScriptBenchResult> results;
+	for (const auto &sequence : sequences) {
+		ScriptProgram program;
+		sequence.build(program);
+		ScriptVariables variables;
+		ScriptBenchResult result;
+		result.name = sequence.name;
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < repetitions; ++i) {
+			result.instructions += execute(program, variables);
+		}
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		result.modified = variables.modified().size();
+		results.push_back(result);
+	}
+	return results;
+}
+
+void ScriptBench::print(std::ostream &output, const std::vector<ScriptBenchResult> &results) {
+	output << std::left << std::setw(14) << "sequence" << std::right << std::setw(14) << "instructions" << std::setw(12) << "M instr/s"
+		<< std::setw(12) << "ns/instr" << std::setw(10) << "modified" << '\n';
+	output << std::fixed;
+	for (const auto &result : results) {
+		output << std::left << std::setw(14) << result.name << std::right << std::setw(14) << result.instructions
+			<< std::setw(12) << std::setprecision(1) << result.instructions / result.seconds / 1e6
+			<< std::setw(12) << std::setprecision(2) << result.seconds * 1e9 / result.instructions
+			<< std::setw(10) << result.modified << '\n';
+	}
+	output << std::defaultfloat;
+}
+
+uint64_t ScriptBench::execute(const ScriptProgram &program, ScriptVariables &variables) {
+	uint64_t executed = 0;
+	uint32_t pc = 0;
+	while (true) {
+		const auto &instruction = program[pc++];
+		auto *operands = program.operands(instruction);
+		switch (instruction.op) {
+		case ScriptOp::SetVariable:
+			variables.apply(static_cast<uint8_t>(operands[0]), static_cast<uint16_t>(operands[1]), static_cast<uint16_t>(operands[2]));
+			break;
+		case ScriptOp::SetVariableBinary:
+			variables.apply(static_cast<uint8_t>(operands[0]), static_cast<uint16_t>(operands[1]), static_cast<uint16_t>(operands[2]), static_cast<uint16_t>(operands[3]));
+			break;
+		case ScriptOp::JumpIf:
+			if (ScriptVariables::compare(operands[0], variables.resolve(operands[1]), variables.resolve(operands[2]))) {
+				pc = operands[3];
+			}
+			break;
+		case ScriptOp::Jump:
+			pc = operands[0];
+			break;
+		case ScriptOp::Unreachable:
+			return executed;
+		default:
+			throw std::runtime_error("The script benchmark cannot run this instruction.");
+		}
+		++executed;
+	}
+}
+
+void ScriptBench::arithmetic(ScriptProgram &program, bool scattered) {
+	// The scattered variant spreads the same variables over the whole store.
+	uint16_t v[8];
+	for (uint16_t i = 0; i < 8; ++i) {
+		v[i] = variable(scattered ? (i * 0x1f3 + 0x11) % ScriptVariables::Count : i);
+	}
+
+	ProgramBuilder builder(program);
+	builder.set(Set, v[0], 0);
+	builder.set(Set, v[5], 0);
+	auto loop = builder.ahead(0);
+	builder.binary(Add, v[1], v[0], 3);
+	builder.binary(Multiply, v[2], v[1], 7);
+	builder.binary(Subtract, v[3], v[2], v[0]);
+	builder.binary(Divide, v[4], v[3], 5);
+	builder.set(Add, v[5], v[4]);
+	builder.set(Subtract, v[6], 1);
+	builder.set(Set, v[7], v[5]);
+	builder.set(Multiply, v[7], 3);
+	builder.set(Add, v[0], 1);
+	builder.jumpIf(Less, v[0], LoopCount, loop);
+	builder.end();
+}
+
+void ScriptBench::branches(ScriptProgram &program) {
+	auto counter = variable(0), flip = variable(1), firstHalf = variable(2);
+
+	ProgramBuilder builder(program);
+	builder.set(Set, counter, 0);
+	builder.set(Set, flip, 0);
+	auto loop = builder.ahead(0);
+	// Alternates between the two arms on every iteration.
+	builder.jumpIf(Equal, flip, 0, builder.ahead(3));
+	builder.set(Set, flip, 0);
+	builder.jump(builder.ahead(2));
+	builder.set(Set, flip, 1);
+	// Taken for the second half of the loop.
+	builder.jumpIf(GreaterOrEqual, counter, LoopCount / 2, builder.ahead(2));
+	builder.set(Add, firstHalf, 1);
+	// Never taken.
+	builder.jumpIf(Greater, counter, LoopCount * 2, builder.ahead(3));
+	builder.set(Add, counter, 1);
+	builder.jumpIf(Less, counter, LoopCount, loop);
+	builder.end();
+}
\ No newline at end of file
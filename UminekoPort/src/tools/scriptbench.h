@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../script/scriptprogram.h"
+#include "../script/scriptvariables.h"
+
+struct ScriptBenchResult {
+	std::string name;
+	uint64_t instructions = 0;
+	double seconds = 0;
+	// Slots on the store's modified list afterwards, which is what a snapshot or diff would visit.
+	size_t modified = 0;
+};
+
+// Microbenchmark of the interpreter's variable operations. Each sequence is built as a ScriptProgram and run against
+// ScriptVariables by a loop that handles only the arithmetic and branch ops, so the numbers show operand resolution,
+// arithmetic and the store without any graphics or audio behind the script.
+class ScriptBench {
+public:
+	// Runs every sequence from the top repetitions times.
+	std::vector<ScriptBenchResult> run(uint32_t repetitions) const;
+
+	static void print(std::ostream &output, const std::vector<ScriptBenchResult> &results);
+private:
+	// Returns the number of instructions executed before reaching the end of the program.
+	static uint64_t execute(const ScriptProgram &program, ScriptVariables &variables);
+
+	static void arithmetic(ScriptProgram &program, bool scattered);
+	static void branches(ScriptProgram &program);
+};
\ No newline at end of file
@@ -0,0 +1,564 @@
+#include "syntheticrom.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <thread>
+
+#include "../util/binarywriter.h"
+
+namespace {
+
+const uint32_t FolderBit = 0x80000000;
+const uint64_t FileAlignment = 1 << 11;
+const uint64_t FolderAlignment = 1 << 4;
+// Chunk size the session streams music in, as audio decoding does.
+const size_t StreamChunkSize = 32 * 1024;
+
+struct Spec {
+	SyntheticFile file;
+	std::function<std::vector<char>(uint32_t seed)> make;
+};
+
+struct Folder {
+	std::map<std::string, Folder> folders;
+	std::map<std::string, const Spec *> files;
+};
+
+std::string number(uint32_t value, int digits) {
+	auto text = std::to_string(value);
+	return std::string(std::max<int>(0, digits - static_cast<int>(text.size())), '0') + text;
+}
+
+uint32_t seedOf(const std::string &path) {
+	uint32_t hash = 0x811c9dc5;
+	for (auto c : path) {
+		hash = (hash ^ static_cast<unsigned char>(c)) * 0x01000193;
+	}
+	return hash;
+}
+
+// Rows of encoded pictures are padded to a multiple of 4 pixels.
+size_t pictureStride(uint32_t width) {
+	return 4 * ((size_t(width) + 3) & ~size_t(3));
+}
+
+// Gradients and a checkerboard, so rows differ from each other and from other files.
+std::vector<unsigned char> image(uint32_t width, uint32_t height, size_t stride, uint32_t seed) {
+	std::vector<unsigned char> pixels(stride * height);
+	for (uint32_t y = 0; y < height; ++y) {
+		auto *row = pixels.data() + y * stride;
+		for (uint32_t x = 0; x < width; ++x) {
+			row[x * 4 + 0] = static_cast<unsigned char>(x + seed);
+			row[x * 4 + 1] = static_cast<unsigned char>(y * 2 + (seed >> 8));
+			row[x * 4 + 2] = static_cast<unsigned char>(((x / 16) ^ (y / 16)) * 37 + (seed >> 16));
+			row[x * 4 + 3] = 0xff;
+		}
+	}
+	return pixels;
+}
+
+// The inverse of the decoders' DPCM pass: every row becomes its difference from the row above.
+void deltaCode(std::vector<unsigned char> &pixels, size_t stride, uint32_t height) {
+	for (size_t y = height; y-- > 1;) {
+		auto *row = pixels.data() + y * stride;
+		for (size_t x = 0; x < stride; ++x) {
+			row[x] -= row[x - stride];
+		}
+	}
+}
+
+// Picture LZ with a zero flag byte before every 8 bytes, which marks them all as literals.
+std::vector<char> literals(const std::vector<unsigned char> &data) {
+	std::vector<char> encoded;
+	encoded.reserve(data.size() + data.size() / 8 + 1);
+	for (size_t i = 0; i < data.size(); i += 8) {
+		encoded.push_back(0);
+		encoded.insert(encoded.end(), data.begin() + i, data.begin() + std::min(i + 8, data.size()));
+	}
+	return encoded;
+}
+
+std::vector<char> pic3(uint32_t width, uint32_t height, uint32_t chunkWidth, uint32_t chunkHeight, uint32_t seed) {
+	struct Chunk {
+		uint32_t left, top, width, height;
+		std::vector<char> encoded;
+	};
+	std::vector<Chunk> chunks;
+	for (uint32_t top = 0; top < height; top += chunkHeight) {
+		for (uint32_t left = 0; left < width; left += chunkWidth) {
+			auto clippedWidth = std::min(chunkWidth, width - left), clippedHeight = std::min(chunkHeight, height - top);
+			auto stride = pictureStride(clippedWidth);
+			auto pixels = image(clippedWidth, clippedHeight, stride, seed + left * 31 + top);
+			deltaCode(pixels, stride, clippedHeight);
+			Chunk chunk { left, top, clippedWidth, clippedHeight, literals(pixels) };
+			chunks.push_back(std::move(chunk));
+		}
+	}
+
+	BinaryWriter writer;
+	writer.write("PIC3", 4);
+	writer.write<uint32_t>(0);
+	writer.write(static_cast<uint16_t>(width));
+	writer.write(static_cast<uint16_t>(height));
+	writer.write(static_cast<uint16_t>(width));
+	writer.write(static_cast<uint16_t>(height));
+	writer.write<uint32_t>(0);
+	writer.write(static_cast<uint32_t>(chunks.size()));
+	auto offset = static_cast<uint32_t>(writer.tellp() + chunks.size() * 20);
+	for (const auto &chunk : chunks) {
+		writer.write<uint32_t>(0);
+		writer.write(static_cast<uint16_t>(chunk.left));
+		writer.write(static_cast<uint16_t>(chunk.top));
+		writer.write(static_cast<uint16_t>(chunk.width));
+		writer.write(static_cast<uint16_t>(chunk.height));
+		writer.write(offset);
+		writer.write(static_cast<uint32_t>(chunk.encoded.size()));
+		offset += static_cast<uint32_t>(chunk.encoded.size());
+	}
+	for (const auto &chunk : chunks) {
+		writer.write(chunk.encoded.data(), chunk.encoded.size());
+	}
+	return writer.release();
+}
+
+// PIC4 chunks are stored uncompressed, only delta coded.
+std::vector<char> pic4(uint32_t width, uint32_t height, uint32_t chunkWidth, uint32_t chunkHeight, uint32_t seed) {
+	struct Chunk {
+		uint32_t left, top, width, height;
+		std::vector<unsigned char> pixels;
+	};
+	std::vector<Chunk> chunks;
+	for (uint32_t top = 0; top < height; top += chunkHeight) {
+		for (uint32_t left = 0; left < width; left += chunkWidth) {
+			auto clippedWidth = std::min(chunkWidth, width - left), clippedHeight = std::min(chunkHeight, height - top);
+			Chunk chunk { left, top, clippedWidth, clippedHeight, image(clippedWidth, clippedHeight, clippedWidth * 4, seed + left + top * 7) };
+			deltaCode(chunk.pixels, chunk.width * 4, chunk.height);
+			chunks.push_back(std::move(chunk));
+		}
+	}
+
+	BinaryWriter writer;
+	writer.write("PIC4", 4);
+	writer.write<uint32_t>(0);
+	writer.write(static_cast<uint16_t>(width));
+	writer.write(static_cast<uint16_t>(height));
+	writer.write(static_cast<uint16_t>(width));
+	writer.write(static_cast<uint16_t>(height));
+	writer.write<uint32_t>(0);
+	writer.write(static_cast<uint32_t>(chunks.size()));
+	auto offset = static_cast<uint32_t>(writer.tellp() + chunks.size() * 8);
+	for (const auto &chunk : chunks) {
+		writer.write(static_cast<uint16_t>(chunk.left));
+		writer.write(static_cast<uint16_t>(chunk.top));
+		writer.write(offset);
+		offset += static_cast<uint32_t>(32 + chunk.pixels.size());
+	}
+	for (const auto &chunk : chunks) {
+		for (int i = 0; i < 4; ++i) {
+			writer.write<uint16_t>(0);
+		}
+		writer.write<uint32_t>(0);
+		writer.write(static_cast<uint16_t>(chunk.width + 2));
+		writer.write(static_cast<uint16_t>(chunk.height + 2));
+		writer.write(static_cast<uint32_t>(chunk.pixels.size()));
+		writer.write<uint32_t>(0);
+		writer.write(static_cast<uint16_t>(chunk.width));
+		writer.write(static_cast<uint16_t>(chunk.height));
+		writer.write<uint32_t>(0);
+		writer.write(reinterpret_cast<const char *>(chunk.pixels.data()), chunk.pixels.size());
+	}
+	return writer.release();
+}
+
+std::vector<char> bup(uint32_t width, uint32_t height, uint32_t poseWidth, uint32_t poseHeight, uint32_t seed) {
+	const auto &poses = SyntheticRom::poses();
+	auto stride = pictureStride(width);
+	auto base = image(width, height, stride, seed);
+	deltaCode(base, stride, height);
+	std::vector<std::vector<char>> encoded { literals(base) };
+	auto poseStride = pictureStride(poseWidth);
+	for (size_t i = 0; i < poses.size(); ++i) {
+		auto pixels = image(poseWidth, poseHeight, poseStride, seed + 100 + static_cast<uint32_t>(i));
+		deltaCode(pixels, poseStride, poseHeight);
+		encoded.push_back(literals(pixels));
+	}
+
+	BinaryWriter writer;
+	auto headerSize = static_cast<uint32_t>(32 + 68 * poses.size());
+	writer.write("BUP3", 4);
+	writer.write<uint32_t>(0);
+	writer.write<uint32_t>(0);
+	writer.write<uint16_t>(0);
+	writer.write<uint16_t>(0);
+	writer.write(static_cast<uint16_t>(width));
+	writer.write(static_cast<uint16_t>(height));
+	writer.write(headerSize);
+	writer.write(static_cast<uint32_t>(encoded[0].size()));
+	writer.write(static_cast<uint32_t>(poses.size()));
+	auto offset = headerSize + static_cast<uint32_t>(encoded[0].size());
+	for (size_t i = 0; i < poses.size(); ++i) {
+		char title[16] = {};
+		memcpy(title, poses[i].data(), std::min<size_t>(poses[i].size(), sizeof(title) - 1));
+		writer.write(title, sizeof(title));
+		writer.write<uint32_t>(0);
+		// The expression goes somewhere in the upper half, like a face.
+		writer.write(static_cast<uint16_t>((width - poseWidth) / 2));
+		writer.write(static_cast<uint16_t>(height / 8));
+		writer.write(static_cast<uint16_t>(poseWidth));
+		writer.write(static_cast<uint16_t>(poseHeight));
+		writer.write(offset);
+		writer.write(static_cast<uint32_t>(encoded[i + 1].size()));
+		offset += static_cast<uint32_t>(encoded[i + 1].size());
+		const char zeros[32] = {};
+		writer.write(zeros, sizeof(zeros));
+	}
+	for (const auto &data : encoded) {
+		writer.write(data.data(), data.size());
+	}
+	return writer.release();
+}
+
+struct AtlasImage {
+	std::string name;
+	uint32_t width, height;
+};
+
+// A dialogue window, buttons and icons of assorted sizes.
+std::vector<AtlasImage> atlasImages(uint32_t count) {
+	std::vector<AtlasImage> images;
+	for (uint32_t i = 0; i < count; ++i) {
+		static const uint32_t sizes[][2] = { { 1024, 256 }, { 256, 64 }, { 128, 128 }, { 64, 64 }, { 512, 96 }, { 32, 32 } };
+		const auto &size = sizes[i % 6];
+		images.push_back({ "part" + number(i, 2), size[0], size[1] });
+	}
+	return images;
+}
+
+void writeAtlasName(BinaryWriter &writer, const std::string &name, size_t length, size_t fixedSize) {
+	writer.write(name.c_str(), name.size() + 1);
+	for (auto i = fixedSize + name.size() + 1; i < length; ++i) {
+		writer.write<uint8_t>(0);
+	}
+}
+
+size_t atlasEntryLength(const std::string &name) {
+	return (16 + name.size() + 1 + 3) & ~size_t(3);
+}
+
+// All images in one compressed block.
+std::vector<char> txa3(uint32_t count, uint32_t seed) {
+	auto images = atlasImages(count);
+	std::vector<unsigned char> data;
+	std::vector<uint32_t> offsets;
+	for (const auto &image : images) {
+		offsets.push_back(static_cast<uint32_t>(data.size()));
+		auto pixels = ::image(image.width, image.height, image.width * 4, seed + static_cast<uint32_t>(offsets.size()));
+		data.insert(data.end(), pixels.begin(), pixels.end());
+	}
+	auto encoded = literals(data);
+
+	size_t metadataSize = 0;
+	for (const auto &image : images) {
+		metadataSize += atlasEntryLength(image.name);
+	}
+	BinaryWriter writer;
+	writer.write("TXA3", 4);
+	writer.write<uint32_t>(0);
+	writer.write(static_cast<uint32_t>(32 + metadataSize));
+	writer.write(static_cast<uint32_t>(encoded.size()));
+	writer.write(static_cast<uint32_t>(data.size()));
+	writer.write(static_cast<uint32_t>(images.size()));
+	writer.write<uint32_t>(0);
+	writer.write<uint32_t>(0);
+	for (size_t i = 0; i < images.size(); ++i) {
+		auto length = atlasEntryLength(images[i].name);
+		writer.write(static_cast<uint16_t>(length));
+		writer.write(static_cast<uint16_t>(i));
+		writer.write(static_cast<uint16_t>(images[i].width));
+		writer.write(static_cast<uint16_t>(images[i].height));
+		writer.write(static_cast<uint16_t>(images[i].width * 4));
+		writer.write<uint16_t>(0);
+		writer.write(offsets[i]);
+		writeAtlasName(writer, images[i].name, length, 16);
+	}
+	writer.write(encoded.data(), encoded.size());
+	return writer.release();
+}
+
+// Every image compressed on its own.
+std::vector<char> txa4(uint32_t count, uint32_t seed) {
+	auto images = atlasImages(count);
+	std::vector<std::vector<char>> encoded;
+	size_t metadataSize = 0, decodedSize = 0;
+	for (const auto &image : images) {
+		encoded.push_back(literals(::image(image.width, image.height, image.width * 4, seed + static_cast<uint32_t>(encoded.size()))));
+		metadataSize += atlasEntryLength(image.name);
+		decodedSize += size_t(image.width) * image.height * 4;
+	}
+
+	BinaryWriter writer;
+	writer.write("TXA4", 4);
+	writer.write<uint32_t>(0);
+	writer.write<uint32_t>(0);
+	writer.write(static_cast<uint32_t>(images.size()));
+	writer.write(static_cast<uint32_t>(decodedSize));
+	for (int i = 0; i < 3; ++i) {
+		writer.write<uint32_t>(0);
+	}
+	auto offset = static_cast<uint32_t>(32 + metadataSize);
+	for (size_t i = 0; i < images.size(); ++i) {
+		auto length = atlasEntryLength(images[i].name);
+		writer.write(static_cast<uint16_t>(length));
+		writer.write(static_cast<uint16_t>(i));
+		writer.write(static_cast<uint16_t>(images[i].width));
+		writer.write(static_cast<uint16_t>(images[i].height));
+		writer.write(offset);
+		writer.write(static_cast<uint32_t>(encoded[i].size()));
+		offset += static_cast<uint32_t>(encoded[i].size());
+		writeAtlasName(writer, images[i].name, length, 16);
+	}
+	for (const auto &data : encoded) {
+		writer.write(data.data(), data.size());
+	}
+	return writer.release();
+}
+
+std::vector<char> raw(size_t size, uint32_t seed) {
+	std::vector<char> data(size);
+	for (size_t i = 0; i < size; ++i) {
+		seed = seed * 1664525 + 1013904223;
+		data[i] = static_cast<char>(seed >> 24);
+	}
+	return data;
+}
+
+const std::vector<Spec> &specs() {
+	static const std::vector<Spec> specs = []() {
+		std::vector<Spec> specs;
+		for (uint32_t i = 0; i < 6; ++i) {
+			specs.push_back({ { "bmp/background/cg" + number(i, 2) + ".pic", ArchiveAssetKind::Pic }, [](uint32_t seed) {
+				return pic3(1920, 1080, 480, 540, seed);
+			} });
+		}
+		for (uint32_t i = 0; i < 2; ++i) {
+			specs.push_back({ { "bmp/background/cg4_" + number(i, 2) + ".pic", ArchiveAssetKind::Pic }, [](uint32_t seed) {
+				return pic4(1920, 1080, 480, 270, seed);
+			} });
+		}
+		for (uint32_t i = 0; i < 6; ++i) {
+			specs.push_back({ { "bustup/chara" + number(i, 2) + ".bup", ArchiveAssetKind::Bup }, [](uint32_t seed) {
+				return bup(640, 960, 200, 120, seed);
+			} });
+		}
+		for (uint32_t i = 0; i < 2; ++i) {
+			specs.push_back({ { "sys/atlas" + number(i, 2) + ".txa", ArchiveAssetKind::Txa }, [](uint32_t seed) {
+				return txa4(24, seed);
+			} });
+			specs.push_back({ { "sys/atlas3_" + number(i, 2) + ".txa", ArchiveAssetKind::Txa }, [](uint32_t seed) {
+				return txa3(12, seed);
+			} });
+		}
+		for (uint32_t i = 0; i < 4; ++i) {
+			specs.push_back({ { "bgm/track" + number(i, 2) + ".at3", ArchiveAssetKind::Raw }, [](uint32_t seed) {
+				return raw(2 * 1024 * 1024, seed);
+			} });
+		}
+		for (uint32_t i = 0; i < 64; ++i) {
+			specs.push_back({ { "misc/data" + number(i, 3) + ".bin", ArchiveAssetKind::Raw }, [](uint32_t seed) {
+				return raw(64 * 1024, seed);
+			} });
+		}
+		return specs;
+	}();
+	return specs;
+}
+
+class RomWriter {
+public:
+	explicit RomWriter(const std::string &path) : ofs_(path, std::ios_base::binary | std::ios_base::trunc) {
+		if (!ofs_) {
+			throw std::runtime_error("Unable to open '" + path + "' for writing.");
+		}
+	}
+
+	// The root table has to be at 0x10, where Archive starts scanning.
+	uint64_t write(const Folder &root) {
+		const char header[16] = { 'R', 'O', 'M', ' ' };
+		ofs_.write(header, sizeof(header));
+		position_ = sizeof(header);
+		writeFolder(root, position_);
+		ofs_.close();
+		if (!ofs_) {
+			throw std::runtime_error("Unable to write the ROM.");
+		}
+		return position_;
+	}
+private:
+	static std::vector<std::string> names(const Folder &folder) {
+		std::vector<std::string> names { ".", ".." };
+		for (const auto &child : folder.folders) {
+			names.push_back(child.first);
+		}
+		for (const auto &file : folder.files) {
+			names.push_back(file.first);
+		}
+		return names;
+	}
+
+	static uint32_t tableSize(const Folder &folder) {
+		uint32_t size = sizeof(uint32_t);
+		for (const auto &name : names(folder)) {
+			size += 12 + static_cast<uint32_t>(name.size()) + 1;
+		}
+		return size;
+	}
+
+	void pad(uint64_t alignment) {
+		static const char zeros[FileAlignment] = {};
+		auto padding = (alignment - position_ % alignment) % alignment;
+		ofs_.write(zeros, padding);
+		position_ += padding;
+	}
+
+	void append(const char *data, size_t size) {
+		ofs_.write(data, size);
+		position_ += size;
+	}
+
+	// The table is reserved first and filled in once the offsets of everything in the folder are known.
+	uint64_t writeFolder(const Folder &folder, uint64_t parent) {
+		pad(FolderAlignment);
+		auto offset = position_;
+		auto size = tableSize(folder);
+		std::vector<char> table(size);
+		append(table.data(), table.size());
+
+		struct Entry {
+			uint32_t offset;
+			uint32_t size;
+		};
+		std::vector<Entry> entries;
+		for (const auto &child : folder.folders) {
+			auto childOffset = writeFolder(child.second, offset);
+			entries.push_back({ static_cast<uint32_t>(childOffset >> 4), tableSize(child.second) });
+		}
+		for (const auto &file : folder.files) {
+			auto data = file.second->make(seedOf(file.second->file.path));
+			pad(FileAlignment);
+			entries.push_back({ static_cast<uint32_t>(position_ >> 11), static_cast<uint32_t>(data.size()) });
+			append(data.data(), data.size());
+		}
+
+		auto tableNames = names(folder);
+		BinaryWriter writer;
+		writer.write(static_cast<uint32_t>(tableNames.size()));
+		auto nameOffset = static_cast<uint32_t>(sizeof(uint32_t) + 12 * tableNames.size());
+		for (size_t i = 0; i < tableNames.size(); ++i) {
+			bool isFolder = i < 2 + folder.folders.size();
+			writer.write(nameOffset | (isFolder ? FolderBit : 0));
+			if (i == 0) {
+				writer.write(static_cast<uint32_t>(offset >> 4));
+				writer.write(size);
+			} else if (i == 1) {
+				writer.write(static_cast<uint32_t>(parent >> 4));
+				writer.write<uint32_t>(0);
+			} else {
+				writer.write(entries[i - 2].offset);
+				writer.write(entries[i - 2].size);
+			}
+			nameOffset += static_cast<uint32_t>(tableNames[i].size()) + 1;
+		}
+		for (const auto &name : tableNames) {
+			writer.write(name.c_str(), name.size() + 1);
+		}
+		ofs_.seekp(offset);
+		ofs_.write(writer.buffer().data(), writer.buffer().size());
+		ofs_.seekp(position_);
+		return offset;
+	}
+
+	std::ofstream ofs_;
+	uint64_t position_ = 0;
+};
+
+}
+
+const std::vector<SyntheticFile> &SyntheticRom::files() {
+	static const std::vector<SyntheticFile> files = []() {
+		std::vector<SyntheticFile> files;
+		for (const auto &spec : specs()) {
+			files.push_back(spec.file);
+		}
+		return files;
+	}();
+	return files;
+}
+
+const std::vector<std::string> &SyntheticRom::poses() {
+	static const std::vector<std::string> poses { "normal", "smile", "angry", "sad" };
+	return poses;
+}
+
+uint64_t SyntheticRom::write(const std::string &path) {
+	Folder root;
+	for (const auto &spec : specs()) {
+		auto *folder = &root;
+		size_t start = 0;
+		for (auto slash = spec.file.path.find('/'); slash != std::string::npos; slash = spec.file.path.find('/', start)) {
+			folder = &folder->folders[spec.file.path.substr(start, slash - start)];
+			start = slash + 1;
+		}
+		folder->files[spec.file.path.substr(start)] = &spec;
+	}
+	RomWriter writer(path);
+	return writer.write(root);
+}
+
+size_t SyntheticRom::recordSession(const std::string &romPath, const std::string &tracePath) {
+	Archive archive;
+	archive.open(romPath);
+	archive.startTrace();
+
+	std::thread audio([&]() {
+		std::vector<unsigned char> chunk(StreamChunkSize);
+		for (const auto &file : files()) {
+			if (file.kind != ArchiveAssetKind::Raw) {
+				continue;
+			}
+			if (file.path.compare(file.path.size() - 4, 4, ".at3") == 0) {
+				auto stream = archive.openStream(file.path);
+				while (!stream.eof()) {
+					stream.read(chunk.data(), chunk.size());
+				}
+			} else {
+				archive.read(file.path);
+				archive.fetch(file.path);
+			}
+		}
+	});
+
+	for (const auto &file : files()) {
+		switch (file.kind) {
+		case ArchiveAssetKind::Pic:
+			archive.getPic(file.path);
+			break;
+		case ArchiveAssetKind::Bup:
+			archive.getBup(file.path);
+			for (const auto &pose : poses()) {
+				archive.getBupPose(file.path, pose);
+			}
+			break;
+		case ArchiveAssetKind::Txa:
+			archive.getTxa(file.path);
+			break;
+		default:
+			break;
+		}
+	}
+	audio.join();
+	return archive.stopTrace(tracePath);
+}
\ No newline at end of file
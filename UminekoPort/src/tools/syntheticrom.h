@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../data/archive.h"
+
+struct SyntheticFile {
+	std::string path;
+	// How the session and the benchmarks load it. Raw .at3 files are streamed, like music.
+	ArchiveAssetKind kind;
+};
+
+// Writes a ROM of made-up assets in the formats Archive decodes, so the archive can be benchmarked and stress tested on
+// machines without the game data. There is no encoder in the tree, so compressed streams only hold literals. That makes
+// them larger than real data but they still decode through the same code. Contents depend only on each file's path, so
+// every run writes the same ROM.
+class SyntheticRom {
+public:
+	// Full HD CGs in both PIC versions, bust-ups with poses, TXA3 and multi-chunk TXA4 atlases, music and small files.
+	static const std::vector<SyntheticFile> &files();
+	// The poses every generated BUP has.
+	static const std::vector<std::string> &poses();
+
+	// Returns the number of bytes written.
+	static uint64_t write(const std::string &path);
+	// Opens the ROM and records what a game session does with it into an ArchiveTrace at tracePath. One thread streams
+	// the music and reads small files while another decodes every image, as the audio and script threads do. Returns the
+	// number of events saved.
+	static size_t recordSession(const std::string &romPath, const std::string &tracePath);
+};
\ No newline at end of file
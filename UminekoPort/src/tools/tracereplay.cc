@@ -0,0 +1,157 @@
+#include "tracereplay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <thread>
+
+namespace {
+
+// Matches the chunk size audio decoding reads streams in.
+const size_t StreamChunkSize = 32 * 1024;
+
+// Nearest-rank percentile of sorted values, in microseconds.
+double percentile(const std::vector<uint64_t> &sorted, double fraction) {
+	auto rank = static_cast<size_t>(fraction * sorted.size() + 0.999999);
+	rank = std::clamp<size_t>(rank, 1, sorted.size());
+	return sorted[rank - 1] / 1000.0;
+}
+
+}
+
+std::vector<TraceReplayStats> TraceReplay::run(const std::string &romPath, ArchiveBackend backend, const std::string &overlayDirectory) const {
+	Archive archive;
+	archive.open(romPath, backend);
+	if (!overlayDirectory.empty()) {
+		archive.addOverlay(overlayDirectory);
+	}
+
+	std::vector<std::vector<const ArchiveTraceEvent *>> threadEvents(trace_.threadCount());
+	for (const auto &event : trace_.events()) {
+		threadEvents[event.thread].push_back(&event);
+	}
+
+	std::vector<std::vector<Sample>> threadSamples(threadEvents.size());
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < threadEvents.size(); ++i) {
+		threads.emplace_back([&, i]() {
+			replay(archive, trace_, threadEvents[i], threadSamples[i]);
+		});
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	std::vector<Sample> samples;
+	for (auto &threadSample : threadSamples) {
+		samples.insert(samples.end(), threadSample.begin(), threadSample.end());
+	}
+	return summarize(samples);
+}
+
+std::vector<TraceReplayStats> TraceReplay::recorded() const {
+	std::vector<Sample> samples;
+	samples.reserve(trace_.events().size());
+	for (const auto &event : trace_.events()) {
+		samples.push_back({ event.op, event.size, event.duration, false });
+	}
+	return summarize(samples);
+}
+
+void TraceReplay::replay(Archive &archive, const ArchiveTrace &trace, const std::vector<const ArchiveTraceEvent *> &events, std::vector<Sample> &samples) {
+	std::vector<unsigned char> chunk(StreamChunkSize);
+	samples.reserve(events.size());
+	for (auto *event : events) {
+		std::string path(trace.string(event->path));
+		auto start = std::chrono::steady_clock::now();
+		bool failed = false;
+		try {
+			auto handle = archive.resolve(path);
+			switch (event->op) {
+			case ArchiveTraceOp::Read:
+				archive.read(handle);
+				break;
+			case ArchiveTraceOp::Fetch:
+				archive.fetch(handle);
+				break;
+			case ArchiveTraceOp::Stream: {
+				// Only the open was timed when recording; here the whole entry is read through, as playback would.
+				auto stream = archive.openStream(handle);
+				while (!stream.eof()) {
+					stream.read(chunk.data(), chunk.size());
+				}
+				break;
+			}
+			case ArchiveTraceOp::Txa:
+				archive.getTxa(handle);
+				break;
+			case ArchiveTraceOp::Bup:
+				archive.getBup(handle);
+				break;
+			case ArchiveTraceOp::BupPose:
+				archive.getBupPose(handle, event->variant == ArchiveTraceEvent::NoVariant ? std::string() : std::string(trace.string(event->variant)));
+				break;
+			case ArchiveTraceOp::Pic:
+				archive.getPic(handle);
+				break;
+			case ArchiveTraceOp::Msk:
+				archive.getMsk(handle);
+				break;
+			case ArchiveTraceOp::Png:
+				archive.getPng(handle);
+				break;
+			}
+		} catch (const std::exception &) {
+			// A path missing from this ROM, or an entry that no longer decodes; counted, not fatal.
+			failed = true;
+		}
+		auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		samples.push_back({ event->op, event->size, static_cast<uint64_t>(duration), failed });
+	}
+}
+
+std::vector<TraceReplayStats> TraceReplay::summarize(std::vector<Sample> &samples) {
+	std::vector<TraceReplayStats> stats;
+	for (auto op = ArchiveTraceOp::Read; op <= ArchiveTraceOp::Png; op = static_cast<ArchiveTraceOp>(static_cast<int>(op) + 1)) {
+		TraceReplayStats row;
+		row.op = op;
+		std::vector<uint64_t> durations;
+		for (const auto &sample : samples) {
+			if (sample.op != op) {
+				continue;
+			}
+			if (sample.failed) {
+				++row.failures;
+				continue;
+			}
+			durations.push_back(sample.nanoseconds);
+			row.bytes += sample.size;
+		}
+		if (durations.empty() && row.failures == 0) {
+			continue;
+		}
+		row.count = durations.size();
+		if (!durations.empty()) {
+			std::sort(durations.begin(), durations.end());
+			row.p50 = percentile(durations, 0.5);
+			row.p90 = percentile(durations, 0.9);
+			row.p99 = percentile(durations, 0.99);
+			row.max = durations.back() / 1000.0;
+		}
+		stats.push_back(row);
+	}
+	return stats;
+}
+
+void TraceReplay::print(std::ostream &output, const std::string &title, const std::vector<TraceReplayStats> &stats) {
+	output << title << ":\n";
+	output << std::left << std::setw(10) << "  call" << std::right << std::setw(8) << "count" << std::setw(8) << "failed" << std::setw(10) << "MB"
+		<< std::setw(12) << "p50 us" << std::setw(12) << "p90 us" << std::setw(12) << "p99 us" << std::setw(12) << "max us" << '\n';
+	output << std::fixed;
+	for (const auto &row : stats) {
+		output << "  " << std::left << std::setw(8) << ArchiveTrace::opName(row.op) << std::right << std::setw(8) << row.count << std::setw(8) << row.failures
+			<< std::setw(10) << std::setprecision(1) << row.bytes / (1024.0 * 1024.0) << std::setprecision(1)
+			<< std::setw(12) << row.p50 << std::setw(12) << row.p90 << std::setw(12) << row.p99 << std::setw(12) << row.max << '\n';
+	}
+	output << std::defaultfloat;
+}
\ No newline at end of file
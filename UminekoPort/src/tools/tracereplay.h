@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "../data/archive.h"
+#include "../data/archivetrace.h"
+
+// Latency distribution of one kind of call, in microseconds.
+struct TraceReplayStats {
+	ArchiveTraceOp op;
+	size_t count = 0;
+	size_t failures = 0;
+	uint64_t bytes = 0;
+	double p50 = 0, p90 = 0, p99 = 0, max = 0;
+};
+
+// Re-issues the calls of a recorded ArchiveTrace against a freshly opened archive and times them again. Each recorded
+// thread is replayed on a thread of its own, in its recorded order, so the mix and concurrency match the session;
+// calls run back to back rather than at their recorded times. Caches are off, so every call reads and decodes.
+class TraceReplay {
+public:
+	explicit TraceReplay(const ArchiveTrace &trace) : trace_(trace) {}
+
+	// overlayDirectory may be empty. Returns a row per kind of call in the trace.
+	std::vector<TraceReplayStats> run(const std::string &romPath, ArchiveBackend backend, const std::string &overlayDirectory) const;
+	// The latencies as they were recorded.
+	std::vector<TraceReplayStats> recorded() const;
+
+	static void print(std::ostream &output, const std::string &title, const std::vector<TraceReplayStats> &stats);
+private:
+	struct Sample {
+		ArchiveTraceOp op;
+		uint32_t size;
+		uint64_t nanoseconds;
+		bool failed;
+	};
+
+	static void replay(Archive &archive, const ArchiveTrace &trace, const std::vector<const ArchiveTraceEvent *> &events, std::vector<Sample> &samples);
+	static std::vector<TraceReplayStats> summarize(std::vector<Sample> &samples);
+
+	const ArchiveTrace &trace_;
+};
\ No newline at end of file
@@ -1,74 +1,134 @@
 #pragma once
 
 #include <cstdint>
-#include <fstream>
-#include <memory>
-#include <sstream>
+#include <cstring>
+#include <ios>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 
 #include "endian.h"
+#include "span.h"
 
-namespace detail {
-
-struct MemoryBuffer : public std::basic_streambuf<char> {
-	MemoryBuffer(const char *begin, size_t size);
-protected:
-	std::streampos seekpos(std::streampos pos, std::ios_base::openmode which = std::ios_base::in) override;
-	std::streampos seekoff(std::streamoff off, std::ios_base::seekdir way, std::ios_base::openmode which = std::ios_base::in) override;
-};
-
-}
-
+// Cursor over a contiguous buffer. Every read is bounds-checked and throws std::out_of_range instead of running past
+// the end; the buffer must outlive the reader and any string_view taken from it.
 class BinaryReader {
 public:
-	BinaryReader();
-	explicit BinaryReader(std::istream &is);
-	BinaryReader(const char *data, size_t size);
-	~BinaryReader();
-	BinaryReader(BinaryReader &&other);
-	BinaryReader &operator=(BinaryReader &&other);
+	BinaryReader() = default;
+	BinaryReader(const char *data, size_t size) : data_(data), size_(size) {}
+	explicit BinaryReader(Span<const unsigned char> data) : data_(reinterpret_cast<const char *>(data.data())), size_(data.size()) {}
+
+	void wrap(const char *data, size_t size) {
+		data_ = data;
+		size_ = size;
+		position_ = 0;
+	}
 
-	void wrap(const char *data, size_t size);
+	void seekg(size_t pos) {
+		if (pos > size_) {
+			throw std::out_of_range("BinaryReader seek out of range.");
+		}
+		position_ = pos;
+	}
 
-	// Stream redirect functions
-	std::istream &seekg(std::streampos pos);
-	std::istream &seekg(std::streamoff off, std::ios_base::seekdir way);
+	void seekg(std::streamoff off, std::ios_base::seekdir way) {
+		std::streamoff base = 0;
+		if (way == std::ios_base::cur) {
+			base = static_cast<std::streamoff>(position_);
+		} else if (way == std::ios_base::end) {
+			base = static_cast<std::streamoff>(size_);
+		}
+		if (base + off < 0) {
+			throw std::out_of_range("BinaryReader seek out of range.");
+		}
+		seekg(static_cast<size_t>(base + off));
+	}
 
-	std::streampos tellg();
+	size_t tellg() const {
+		return position_;
+	}
+
+	void skip(std::streamoff off) {
+		seekg(off, std::ios_base::cur);
+	}
 
-	std::istream &skip(std::streamoff off);
+	size_t size() const {
+		return size_;
+	}
+
+	size_t remaining() const {
+		return size_ - position_;
+	}
 
-	void read(char *buffer, size_t size);
+	void read(char *buffer, size_t size) {
+		memcpy(buffer, take(size), size);
+	}
 
 	template <typename T>
 	T read() {
 		T val;
-		is_->read(reinterpret_cast<char *>(&val), sizeof(T));
+		memcpy(&val, take(sizeof(T)), sizeof(T));
 		return val;
 	}
 
 	template <typename T>
 	T readBE() {
-		T val;
-		is_->read(reinterpret_cast<char *>(&val), sizeof(T));
+		T val = read<T>();
 		swapEndian(val);
 		return val;
 	}
 
-	std::string readString();
-	std::string readString(size_t length);
+	// Reads up to the next NUL, or to the end of the buffer if there is none. The NUL is consumed but not returned.
+	std::string_view readStringView() {
+		if (position_ == size_) {
+			return std::string_view();
+		}
+		auto *start = data_ + position_;
+		auto *end = static_cast<const char *>(memchr(start, 0, size_ - position_));
+		auto length = end ? static_cast<size_t>(end - start) : size_ - position_;
+		position_ += end ? length + 1 : length;
+		return std::string_view(start, length);
+	}
+
+	std::string_view readStringView(size_t length) {
+		return std::string_view(take(length), length);
+	}
+
+	std::string readString() {
+		return std::string(readStringView());
+	}
+
+	std::string readString(size_t length) {
+		return std::string(readStringView(length));
+	}
 private:
-	bool ownsStream_;
-	std::unique_ptr<detail::MemoryBuffer> memoryBuffer_;
-	std::istream *is_;
+	const char *take(size_t size) {
+		if (size > size_ - position_) {
+			throw std::out_of_range("BinaryReader read out of range.");
+		}
+		auto *ptr = data_ + position_;
+		position_ += size;
+		return ptr;
+	}
+
+	const char *data_ = nullptr;
+	size_t size_ = 0;
+	size_t position_ = 0;
 };
 
 class Bitstream {
 public:
-	Bitstream();
+	Bitstream() : bitOffset_(0) {}
 
-	void wrap(const char *data, size_t size);
+	void wrap(const char *data, size_t size) {
+		data_ = data;
+		size_ = size;
+		bitOffset_ = 0;
+	}
 
-	void seek(size_t bitOffset);
+	void seek(size_t bitOffset) {
+		bitOffset_ = bitOffset;
+	}
 
 	template <typename T>
 	T read(size_t bits) {
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Growable buffer that values are appended to in native byte order; the counterpart of BinaryReader.
+class BinaryWriter {
+public:
+	void reserve(size_t size) {
+		buffer_.reserve(size);
+	}
+
+	void write(const char *data, size_t size) {
+		if (size == 0) {
+			return;
+		}
+		auto offset = buffer_.size();
+		buffer_.resize(offset + size);
+		memcpy(buffer_.data() + offset, data, size);
+	}
+
+	template <typename T>
+	void write(const T &value) {
+		static_assert(std::is_trivially_copyable<T>::value, "BinaryWriter can only write trivially copyable values.");
+		write(reinterpret_cast<const char *>(&value), sizeof(T));
+	}
+
+	// Overwrites a value written earlier, such as a size that was not known yet.
+	template <typename T>
+	void writeAt(size_t offset, const T &value) {
+		memcpy(buffer_.data() + offset, &value, sizeof(T));
+	}
+
+	// A uint32_t length followed by the characters; br.readString(br.read<uint32_t>()) reads it back.
+	void writeString(std::string_view value) {
+		write(static_cast<uint32_t>(value.size()));
+		write(value.data(), value.size());
+	}
+
+	size_t tellp() const {
+		return buffer_.size();
+	}
+
+	const std::vector<char> &buffer() const {
+		return buffer_;
+	}
+
+	std::vector<char> release() {
+		return std::move(buffer_);
+	}
+private:
+	std::vector<char> buffer_;
+};
\ No newline at end of file
@@ -0,0 +1,260 @@
+#include "file.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+File::~File() {
+	close();
+}
+
+File::File(File &&other) {
+	*this = std::move(other);
+}
+
+File &File::operator=(File &&other) {
+	if (this == &other) {
+		return *this;
+	}
+	close();
+#ifdef _WIN32
+	file_ = other.file_;
+	other.file_ = nullptr;
+#else
+	fd_ = other.fd_;
+	other.fd_ = -1;
+#endif
+	size_ = other.size_;
+	other.size_ = 0;
+	return *this;
+}
+
+void File::readAt(uint64_t offset, void *buffer, size_t size) const {
+	if (offset > size_ || size > size_ - offset) {
+		throw std::out_of_range("File read out of range.");
+	}
+	auto *output = static_cast<char *>(buffer);
+	while (size > 0) {
+#ifdef _WIN32
+		// Positional ReadFile on a synchronous handle; the offset comes from the OVERLAPPED, not the file pointer.
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = static_cast<DWORD>(offset & 0xffffffff);
+		overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+		DWORD chunk = size > 0x40000000 ? 0x40000000 : static_cast<DWORD>(size);
+		DWORD bytesRead = 0;
+		if (!ReadFile(file_, output, chunk, &bytesRead, &overlapped) || bytesRead == 0) {
+			throw std::runtime_error("File read failed.");
+		}
+#else
+		ssize_t bytesRead = pread(fd_, output, size, static_cast<off_t>(offset));
+		if (bytesRead < 0 && errno == EINTR) {
+			continue;
+		}
+		if (bytesRead <= 0) {
+			throw std::runtime_error("File read failed.");
+		}
+#endif
+		output += bytesRead;
+		offset += bytesRead;
+		size -= bytesRead;
+	}
+}
+
+#ifdef _WIN32
+uint64_t fileModifiedTime(const std::string &path) {
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes)) {
+		return 0;
+	}
+	return (uint64_t(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+}
+
+void File::open(const std::string &path) {
+	close();
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Unable to open '" + path + "'.");
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		throw std::runtime_error("Unable to query size of '" + path + "'.");
+	}
+	file_ = file;
+	size_ = static_cast<uint64_t>(fileSize.QuadPart);
+}
+
+void File::close() {
+	if (file_) {
+		CloseHandle(file_);
+	}
+	file_ = nullptr;
+	size_ = 0;
+}
+
+bool File::isOpen() const {
+	return file_ != nullptr;
+}
+#else
+uint64_t fileModifiedTime(const std::string &path) {
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0) {
+		return 0;
+	}
+#ifdef __APPLE__
+	return uint64_t(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+	return uint64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+}
+
+void File::open(const std::string &path) {
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Unable to open '" + path + "'.");
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		::close(fd);
+		throw std::runtime_error("Unable to query size of '" + path + "'.");
+	}
+	fd_ = fd;
+	size_ = static_cast<uint64_t>(st.st_size);
+}
+
+void File::close() {
+	if (fd_ >= 0) {
+		::close(fd_);
+	}
+	fd_ = -1;
+	size_ = 0;
+}
+
+bool File::isOpen() const {
+	return fd_ >= 0;
+}
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+MappedFile::MappedFile(MappedFile &&other) {
+	*this = std::move(other);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) {
+	if (this == &other) {
+		return *this;
+	}
+	close();
+#ifdef _WIN32
+	file_ = other.file_;
+	mapping_ = other.mapping_;
+	other.file_ = nullptr;
+	other.mapping_ = nullptr;
+#else
+	fd_ = other.fd_;
+	other.fd_ = -1;
+#endif
+	data_ = other.data_;
+	size_ = other.size_;
+	other.data_ = nullptr;
+	other.size_ = 0;
+	return *this;
+}
+
+#ifdef _WIN32
+void MappedFile::open(const std::string &path) {
+	close();
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Unable to open '" + path + "' for mapping.");
+	}
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(file);
+		throw std::runtime_error("Unable to map empty file '" + path + "'.");
+	}
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping) {
+		CloseHandle(file);
+		throw std::runtime_error("Unable to create file mapping for '" + path + "'.");
+	}
+	void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		throw std::runtime_error("Unable to map view of '" + path + "'.");
+	}
+	file_ = file;
+	mapping_ = mapping;
+	data_ = static_cast<const unsigned char *>(data);
+	size_ = static_cast<size_t>(fileSize.QuadPart);
+}
+
+void MappedFile::close() {
+	if (data_) {
+		UnmapViewOfFile(data_);
+	}
+	if (mapping_) {
+		CloseHandle(mapping_);
+	}
+	if (file_) {
+		CloseHandle(file_);
+	}
+	file_ = nullptr;
+	mapping_ = nullptr;
+	data_ = nullptr;
+	size_ = 0;
+}
+#else
+void MappedFile::open(const std::string &path) {
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Unable to open '" + path + "' for mapping.");
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		::close(fd);
+		throw std::runtime_error("Unable to map empty file '" + path + "'.");
+	}
+	void *data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		::close(fd);
+		throw std::runtime_error("Unable to map '" + path + "'.");
+	}
+	fd_ = fd;
+	data_ = static_cast<const unsigned char *>(data);
+	size_ = static_cast<size_t>(st.st_size);
+}
+
+void MappedFile::close() {
+	if (data_) {
+		munmap(const_cast<unsigned char *>(data_), size_);
+	}
+	if (fd_ >= 0) {
+		::close(fd_);
+	}
+	fd_ = -1;
+	data_ = nullptr;
+	size_ = 0;
+}
+#endif
+
+Span<const unsigned char> MappedFile::view(uint64_t offset, size_t size) const {
+	if (offset > size_ || size > size_ - offset) {
+		throw std::out_of_range("Mapped file view out of range.");
+	}
+	return Span<const unsigned char>(data_ + offset, size);
+}
\ No newline at end of file
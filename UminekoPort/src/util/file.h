@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "span.h"
+
+// Last modification time of a file in platform ticks, or 0 if it cannot be queried. Only meant for comparing
+// against an earlier value from the same machine.
+uint64_t fileModifiedTime(const std::string &path);
+
+// Read-only file handle supporting positional reads. readAt does not touch a shared file position, so any number
+// of threads can read through the same File at once.
+class File {
+public:
+	File() = default;
+	~File();
+	File(const File &other) = delete;
+	File(File &&other);
+	File &operator=(const File &other) = delete;
+	File &operator=(File &&other);
+
+	void open(const std::string &path);
+	void close();
+
+	bool isOpen() const;
+
+	uint64_t size() const {
+		return size_;
+	}
+
+	void readAt(uint64_t offset, void *buffer, size_t size) const;
+private:
+#ifdef _WIN32
+	void *file_ = nullptr;
+#else
+	int fd_ = -1;
+#endif
+	uint64_t size_ = 0;
+};
+
+// Read-only memory mapping of a whole file. Several processes mapping the same file share one page cache copy.
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile &other) = delete;
+	MappedFile(MappedFile &&other);
+	MappedFile &operator=(const MappedFile &other) = delete;
+	MappedFile &operator=(MappedFile &&other);
+
+	void open(const std::string &path);
+	void close();
+
+	bool isOpen() const {
+		return data_ != nullptr;
+	}
+
+	const unsigned char *data() const {
+		return data_;
+	}
+
+	size_t size() const {
+		return size_;
+	}
+
+	Span<const unsigned char> view(uint64_t offset, size_t size) const;
+private:
+#ifdef _WIN32
+	void *file_ = nullptr;
+	void *mapping_ = nullptr;
+#else
+	int fd_ = -1;
+#endif
+	const unsigned char *data_ = nullptr;
+	size_t size_ = 0;
+};
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+// Non-owning view over a contiguous range, std::span-style.
+template <typename T>
+class Span {
+public:
+	Span() : data_(nullptr), size_(0) {}
+	Span(T *data, size_t size) : data_(data), size_(size) {}
+
+	template <typename U>
+	Span(const std::vector<U> &v) : data_(v.data()), size_(v.size()) {}
+
+	template <typename U>
+	Span(std::vector<U> &v) : data_(v.data()), size_(v.size()) {}
+
+	T *data() const {
+		return data_;
+	}
+
+	size_t size() const {
+		return size_;
+	}
+
+	bool empty() const {
+		return size_ == 0;
+	}
+
+	T *begin() const {
+		return data_;
+	}
+
+	T *end() const {
+		return data_ + size_;
+	}
+
+	T &operator[](size_t index) const {
+		return data_[index];
+	}
+
+	Span subspan(size_t offset, size_t count) const {
+		if (offset > size_ || count > size_ - offset) {
+			throw std::out_of_range("Span::subspan out of range.");
+		}
+		return Span(data_ + offset, count);
+	}
+private:
+	T *data_;
+	size_t size_;
+};
\ No newline at end of file
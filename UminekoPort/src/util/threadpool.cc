@@ -0,0 +1,138 @@
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+
+ThreadPool::ThreadPool(size_t threads, size_t capacity) : capacity_(capacity ? capacity : 1) {
+	if (threads == 0) {
+		auto hardware = std::thread::hardware_concurrency();
+		threads = hardware > 1 ? hardware - 1 : 1;
+	}
+	threads_.reserve(threads);
+	for (size_t i = 0; i < threads; ++i) {
+		threads_.emplace_back(&ThreadPool::run, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	available_.notify_all();
+	space_.notify_all();
+	for (auto &thread : threads_) {
+		thread.join();
+	}
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		space_.wait(lock, [this]() {
+			return queue_.size() < capacity_ || stopping_;
+		});
+		if (stopping_) {
+			throw std::runtime_error("Cannot submit to a stopping thread pool.");
+		}
+		queue_.push_back(std::move(job));
+	}
+	available_.notify_one();
+}
+
+bool ThreadPool::trySubmit(std::function<void()> job) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (queue_.size() >= capacity_ || stopping_) {
+			return false;
+		}
+		queue_.push_back(std::move(job));
+	}
+	available_.notify_one();
+	return true;
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)> &fn) {
+	if (count == 0) {
+		return;
+	}
+	if (count == 1) {
+		fn(0);
+		return;
+	}
+
+	// Helpers may start after the loop is finished, so the shared state outlives this call.
+	struct State {
+		std::function<void(size_t)> fn;
+		size_t count;
+		std::atomic<size_t> next { 0 };
+		std::atomic<size_t> done { 0 };
+		std::exception_ptr error;
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+	auto state = std::make_shared<State>();
+	state->fn = fn;
+	state->count = count;
+
+	auto work = [state]() {
+		for (;;) {
+			auto index = state->next++;
+			if (index >= state->count) {
+				return;
+			}
+			try {
+				state->fn(index);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(state->mutex);
+				if (!state->error) {
+					state->error = std::current_exception();
+				}
+			}
+			if (++state->done == state->count) {
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->finished.notify_all();
+			}
+		}
+	};
+
+	auto helpers = std::min(count - 1, threads_.size());
+	for (size_t i = 0; i < helpers; ++i) {
+		if (!trySubmit(work)) {
+			break;
+		}
+	}
+	work();
+
+	// Every index has been claimed by now, and each claimed one is running on some thread, so this cannot wait on a
+	// job stuck in the queue.
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->finished.wait(lock, [&]() {
+		return state->done == state->count;
+	});
+	if (state->error) {
+		std::rethrow_exception(state->error);
+	}
+}
+
+void ThreadPool::run() {
+	for (;;) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			available_.wait(lock, [this]() {
+				return !queue_.empty() || stopping_;
+			});
+			if (queue_.empty()) {
+				return;
+			}
+			job = std::move(queue_.front());
+			queue_.pop_front();
+		}
+		space_.notify_one();
+		job();
+	}
+}
\ No newline at end of file
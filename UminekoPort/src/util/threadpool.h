@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads fed from a bounded queue.
+class ThreadPool {
+public:
+	// A thread count of 0 picks one less than the number of hardware threads, but at least one.
+	explicit ThreadPool(size_t threads = 0, size_t capacity = 256);
+	~ThreadPool();
+	ThreadPool(const ThreadPool &other) = delete;
+	ThreadPool &operator=(const ThreadPool &other) = delete;
+
+	size_t size() const {
+		return threads_.size();
+	}
+
+	// Blocks while the queue is full.
+	void submit(std::function<void()> job);
+	// Returns false instead of blocking when the queue is full.
+	bool trySubmit(std::function<void()> job);
+
+	// Runs fn(0) .. fn(count - 1) across the pool and returns once all calls are done, rethrowing the first exception.
+	// The calling thread takes part and helpers are only queued if there is room, so this is safe to call from inside
+	// a pool job.
+	void parallelFor(size_t count, const std::function<void(size_t)> &fn);
+private:
+	void run();
+
+	std::vector<std::thread> threads_;
+	std::deque<std::function<void()>> queue_;
+	size_t capacity_;
+	bool stopping_ = false;
+
+	std::mutex mutex_;
+	std::condition_variable available_;
+	std::condition_variable space_;
+};
\ No newline at end of file